@@ -24,6 +24,8 @@ QT       += core gui network xml svg
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+CONFIG += c++11
+
 TARGET = UdpMidiTest
 TEMPLATE = app
 
@@ -42,6 +44,39 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
         src/main.cpp \
         src/mainwindow.cpp \
+        src/clockanalyzer.cpp \
+        src/clockgenerator.cpp \
+        src/cuescript.cpp \
+        src/logwriter.cpp \
+        src/messagelogmodel.cpp \
+        src/messagelogview.cpp \
+        src/metrics.cpp \
+        src/metricsserver.cpp \
+        src/midibridge.cpp \
+        src/midifile.cpp \
+        src/midifilewriter.cpp \
+        src/midiinput.cpp \
+        src/midioutput.cpp \
+        src/midistatus.cpp \
+        src/miditransform.cpp \
+        src/mscbuilder.cpp \
+        src/mscmessage.cpp \
+        src/mtcgenerator.cpp \
+        src/nativesocket.cpp \
+        src/outputdispatcher.cpp \
+        src/realtime.cpp \
+        src/rxfilter.cpp \
+        src/session.cpp \
+        src/sessionmanager.cpp \
+        src/smfplayer.cpp \
+        src/smfrecorder.cpp \
+        src/timecodeengine.cpp \
+        src/txscheduler.cpp \
+        src/txsocket.cpp \
+        src/udpmidi.cpp \
+        src/udpreceiver.cpp \
+        src/uiupdatescheduler.cpp \
+        src/workstealingpool.cpp \
     vkey/keylabel.cpp \
     vkey/pianokey.cpp \
     vkey/pianokeybd.cpp \
@@ -49,6 +84,45 @@ SOURCES += \
 
 HEADERS += \
         src/mainwindow.h \
+        src/clockanalyzer.h \
+        src/clockgenerator.h \
+        src/cuescript.h \
+        src/logwriter.h \
+        src/messagelogmodel.h \
+        src/messagelogview.h \
+        src/messagerecord.h \
+        src/metrics.h \
+        src/metricsserver.h \
+        src/midibridge.h \
+        src/midifile.h \
+        src/midifilewriter.h \
+        src/midiinput.h \
+        src/midioutput.h \
+        src/midistatus.h \
+        src/midistreamparser.h \
+        src/miditransform.h \
+        src/mscbuilder.h \
+        src/mscmessage.h \
+        src/mtcgenerator.h \
+        src/nativesocket.h \
+        src/outputdispatcher.h \
+        src/preciseclock.h \
+        src/realtime.h \
+        src/rxfilter.h \
+        src/seqlock.h \
+        src/session.h \
+        src/sessionmanager.h \
+        src/smfplayer.h \
+        src/smfrecorder.h \
+        src/spscqueue.h \
+        src/timecode.h \
+        src/timecodeengine.h \
+        src/txscheduler.h \
+        src/txsocket.h \
+        src/udpmidi.h \
+        src/udpreceiver.h \
+        src/uiupdatescheduler.h \
+        src/workstealingpool.h \
     src/mididata.h \
     vkey/keyboardmap.h \
     vkey/keylabel.h \
@@ -60,7 +134,17 @@ HEADERS += \
 FORMS += \
         src/mainwindow.ui
 
-LIBS += -lwinmm
+win32 {
+    SOURCES += src/midiinputwinmm.cpp src/midioutputwinmm.cpp
+    HEADERS += src/midiinputwinmm.h src/midioutputwinmm.h
+    LIBS += -lwinmm -lws2_32
+}
+
+linux {
+    SOURCES += src/midiinputalsa.cpp src/midioutputalsa.cpp
+    HEADERS += src/midiinputalsa.h src/midioutputalsa.h
+    LIBS += -lasound
+}
 
 RESOURCES += vkey/pianokeybd.qrc
 
@@ -0,0 +1,119 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "clockanalyzer.h"
+#include "metrics.h"
+
+// One beat of ticks in the running averages
+static const double AVERAGE_WEIGHT = 1.0 / ClockAnalyzer::PPQN;
+
+// Spacing is not judged until the average has settled
+static const int SETTLE_INTERVALS = ClockAnalyzer::PPQN;
+
+ClockAnalyzer::ClockAnalyzer(Metrics *metrics) :
+    m_metrics(metrics)
+{
+    m_state.playing = false;
+    m_state.lastTickTime = 0;
+    m_state.bpm = 0;
+    m_state.jitterMeanNs = 0;
+    m_state.jitterMaxNs = 0;
+    m_state.ticks = 0;
+    m_state.songPosition = 0;
+    m_state.starts = 0;
+    m_state.stops = 0;
+    m_published.store(m_state);
+}
+
+bool ClockAnalyzer::process(const quint8 *msg, int length, qint64 timestamp)
+{
+    if(length < 1)
+        return false;
+
+    switch(msg[0])
+    {
+    case 0xF8:
+        tick(timestamp);
+        break;
+    case 0xFA:
+        m_state.playing = true;
+        m_state.songPosition = 0;
+        m_state.starts++;
+        break;
+    case 0xFB:
+        m_state.playing = true;
+        break;
+    case 0xFC:
+        m_state.playing = false;
+        m_state.stops++;
+        break;
+    case 0xF2:
+        // Song position is counted in sixteenth notes
+        if(length < 3)
+            return false;
+        m_state.songPosition = ((msg[2] & 0x7F) << 7 | (msg[1] & 0x7F)) * (PPQN / 4);
+        break;
+    default:
+        return false;
+    }
+
+    m_published.store(m_state);
+    return true;
+}
+
+void ClockAnalyzer::tick(qint64 timestamp)
+{
+    if(m_metrics)
+        m_metrics->add(Metrics::CLOCK_TICKS);
+
+    const qint64 interval = timestamp - m_state.lastTickTime;
+    if(m_state.ticks == 0 || interval >= TIMEOUT_NS)
+    {
+        // Starting up, or restarting after a pause
+        m_intervals = 0;
+        m_intervalAverageNs = 0;
+        m_jitterAverageNs = 0;
+        m_state.jitterMeanNs = 0;
+        m_state.jitterMaxNs = 0;
+    }
+    else
+    {
+        if(m_intervals >= SETTLE_INTERVALS)
+        {
+            qint64 jitter = qAbs(interval - static_cast<qint64>(m_intervalAverageNs));
+            m_jitterAverageNs += (jitter - m_jitterAverageNs) * AVERAGE_WEIGHT;
+            m_state.jitterMeanNs = static_cast<qint64>(m_jitterAverageNs);
+            m_state.jitterMaxNs = qMax(m_state.jitterMaxNs, jitter);
+            if(m_metrics)
+                m_metrics->record(Metrics::CLOCK_TICK_JITTER, jitter);
+        }
+
+        m_intervals++;
+        m_intervalAverageNs = m_intervals == 1 ? interval
+                : m_intervalAverageNs + (interval - m_intervalAverageNs) * AVERAGE_WEIGHT;
+        if(m_intervalAverageNs > 0)
+            m_state.bpm = 60e9 / (PPQN * m_intervalAverageNs);
+    }
+
+    m_state.ticks++;
+    if(m_state.playing)
+        m_state.songPosition++;
+    m_state.lastTickTime = timestamp;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CLOCKANALYZER_H
+#define CLOCKANALYZER_H
+
+#include <QtGlobal>
+#include "seqlock.h"
+
+class Metrics;
+
+// Estimates tempo and tick spacing jitter from received MIDI beat clock
+// Clock ticks (F8) are timed against the local monotonic clock; Start,
+// Continue, Stop and Song Position Pointer track the transport. process()
+// runs on the receive thread, state() can be sampled from any thread.
+class ClockAnalyzer
+{
+public:
+    struct State
+    {
+        bool playing;               // Between Start/Continue and Stop
+        qint64 lastTickTime;        // PreciseClock time of the last tick
+        double bpm;                 // From averaged tick spacing
+        qint64 jitterMeanNs;        // Mean absolute deviation from the averaged spacing
+        qint64 jitterMaxNs;
+        quint64 ticks;
+        qint64 songPosition;        // Ticks since the start of the song
+        quint64 starts;
+        quint64 stops;
+    };
+
+    static const int PPQN = 24;
+
+    // A longer gap between ticks restarts the estimate
+    static const qint64 TIMEOUT_NS = Q_INT64_C(500000000);
+
+    explicit ClockAnalyzer(Metrics *metrics = Q_NULLPTR);
+
+    // Returns true if the message was clock or transport
+    bool process(const quint8 *msg, int length, qint64 timestamp);
+
+    State state(quint32 *version = Q_NULLPTR) const { return m_published.load(version); }
+
+    static bool isReceiving(const State &state, qint64 now)
+    {
+        return state.ticks > 0 && now - state.lastTickTime < TIMEOUT_NS;
+    }
+
+private:
+    void tick(qint64 timestamp);
+
+    Metrics *m_metrics;
+
+    // Receive thread only
+    State m_state;
+    double m_intervalAverageNs = 0;
+    double m_jitterAverageNs = 0;
+    int m_intervals = 0;
+
+    SeqLock<State> m_published;
+};
+
+#endif // CLOCKANALYZER_H
@@ -0,0 +1,153 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "clockgenerator.h"
+#include "metrics.h"
+#include "preciseclock.h"
+#include "txsocket.h"
+#include "realtime.h"
+
+static const double AVERAGE_WEIGHT = 1.0 / 32;
+
+static const quint8 MIDI_CLOCK = 0xF8;
+static const quint8 MIDI_START = 0xFA;
+static const quint8 MIDI_STOP = 0xFC;
+
+// Tempo in thousandths of a beat per minute, limits of the BPM control
+static const qint64 MIN_MILLI_BPM = 1000;
+static const qint64 MAX_MILLI_BPM = 999000;
+
+// Nanoseconds in a minute, times 1000 for milli BPM
+static const qint64 MINUTE_MILLI_NS = Q_INT64_C(60000000000000);
+
+ClockGenerator::ClockGenerator(Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_metrics(metrics),
+    m_stop(false),
+    m_failed(false),
+    m_milliBpm(120000)
+{
+    State state;
+    state.running = false;
+    state.bpm = 120;
+    state.ticks = 0;
+    state.jitterMeanNs = 0;
+    state.jitterMaxNs = 0;
+    m_published.store(state);
+}
+
+ClockGenerator::~ClockGenerator()
+{
+    stop();
+    wait();
+}
+
+void ClockGenerator::setDestination(const QHostAddress &localAddress, const QHostAddress &address, quint16 port)
+{
+    m_localAddress = localAddress;
+    m_address = address;
+    m_port = port;
+}
+
+void ClockGenerator::setBpm(double bpm)
+{
+    qint64 milliBpm = qBound(MIN_MILLI_BPM, qRound64(bpm * 1000), MAX_MILLI_BPM);
+    m_milliBpm.store(milliBpm, std::memory_order_relaxed);
+}
+
+void ClockGenerator::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+}
+
+qint64 ClockGenerator::tickOffsetNs(qint64 ticks, qint64 milliBpm)
+{
+    // PPQN * milliBpm ticks take exactly MINUTE_MILLI_NS; split the division
+    // so the products stay in range for runs of any length
+    const qint64 perPeriod = PPQN * milliBpm;
+    const qint64 whole = ticks / perPeriod;
+    const qint64 rest = ticks % perPeriod;
+    return whole * MINUTE_MILLI_NS + rest * (MINUTE_MILLI_NS / perPeriod)
+            + rest * (MINUTE_MILLI_NS % perPeriod) / perPeriod;
+}
+
+void ClockGenerator::run()
+{
+    QString refused;
+    if(!Realtime::apply(Realtime::ROLE_SCHEDULER, &refused))
+        emit error(refused);
+
+    TxSocket socket(m_metrics);
+    if(!socket.bind(m_localAddress))
+    {
+        m_failed.store(true, std::memory_order_relaxed);
+        emit error(tr("Error binding clock socket : %1").arg(socket.errorString()));
+        return;
+    }
+    socket.setDestination(m_address, m_port);
+
+    State state = m_published.load();
+    state.running = true;
+    double jitterAverage = 0;
+
+    qint64 milliBpm = m_milliBpm.load(std::memory_order_relaxed);
+    socket.send(&MIDI_START, 1);
+
+    // The first tick follows Start by one tick interval
+    qint64 origin = PreciseClock::nowNs();
+    qint64 originTick = -1;
+    qint64 lastDeadline = origin;
+    for(qint64 tick = 0; !m_stop.load(std::memory_order_relaxed); tick++)
+    {
+        const qint64 requested = m_milliBpm.load(std::memory_order_relaxed);
+        if(requested != milliBpm)
+        {
+            // Re-anchor on the previous tick so the new interval starts from there
+            origin = lastDeadline;
+            originTick = tick - 1;
+            milliBpm = requested;
+        }
+
+        qint64 deadline = origin + tickOffsetNs(tick - originTick, milliBpm);
+        const qint64 now = PreciseClock::waitUntilNs(deadline, SPIN_NS);
+        if(now - deadline > RESYNC_NS)
+        {
+            origin = now;
+            originTick = tick;
+            deadline = now;
+        }
+        lastDeadline = deadline;
+
+        const qint64 late = PreciseClock::nowNs() - deadline;
+        socket.send(&MIDI_CLOCK, 1);
+
+        m_metrics->record(Metrics::CLOCK_SEND_JITTER, late);
+        jitterAverage += (late - jitterAverage) * AVERAGE_WEIGHT;
+        state.jitterMeanNs = static_cast<qint64>(jitterAverage);
+        state.jitterMaxNs = qMax(state.jitterMaxNs, late);
+        state.bpm = milliBpm / 1000.0;
+        state.ticks++;
+        m_published.store(state);
+    }
+
+    socket.send(&MIDI_STOP, 1);
+    state.running = false;
+    m_published.store(state);
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CLOCKGENERATOR_H
+#define CLOCKGENERATOR_H
+
+#include <QThread>
+#include <QHostAddress>
+#include <atomic>
+#include "seqlock.h"
+
+class Metrics;
+
+// Transmits 24 PPQN MIDI beat clock
+// Sends Start, then a clock tick on every absolute deadline of the tempo
+// grid, then Stop. The tempo can be changed while running; the grid is
+// re-anchored at the last tick so the change takes effect without a gap.
+class ClockGenerator : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct State
+    {
+        bool running;
+        double bpm;
+        quint64 ticks;
+        qint64 jitterMeanNs;        // Mean lateness of ticks against their deadline
+        qint64 jitterMaxNs;
+    };
+
+    static const int PPQN = 24;
+    static const qint64 SPIN_NS = Q_INT64_C(200000);
+    static const qint64 RESYNC_NS = Q_INT64_C(100000000);
+
+    ClockGenerator(Metrics *metrics, QObject *parent = Q_NULLPTR);
+    ~ClockGenerator();
+
+    // Set before start()
+    void setDestination(const QHostAddress &localAddress, const QHostAddress &address, quint16 port);
+
+    // Thread safe, takes effect from the next tick
+    void setBpm(double bpm);
+
+    void stop();
+
+    State state(quint32 *version = Q_NULLPTR) const { return m_published.load(version); }
+    // Set when run() gives up, before error() is emitted; other errors are only reports
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+signals:
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    static qint64 tickOffsetNs(qint64 ticks, qint64 milliBpm);
+
+    Metrics *m_metrics;
+    QHostAddress m_localAddress;
+    QHostAddress m_address;
+    quint16 m_port = 0;
+
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_failed;
+    std::atomic<qint64> m_milliBpm;
+    SeqLock<State> m_published;
+};
+
+#endif // CLOCKGENERATOR_H
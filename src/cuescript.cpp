@@ -0,0 +1,190 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "cuescript.h"
+#include "mscbuilder.h"
+#include <QFile>
+
+static const qint64 NS_PER_US = Q_INT64_C(1000);
+static const qint64 NS_PER_MS = Q_INT64_C(1000000);
+static const qint64 NS_PER_S = Q_INT64_C(1000000000);
+
+// A wait longer than a day is taken as a typo
+static const qint64 MAX_WAIT_NS = 24 * 3600 * NS_PER_S;
+
+namespace
+{
+    // Digits with at most one decimal point
+    bool isDecimal(const QString &text)
+    {
+        if(text.isEmpty() || text.startsWith(QChar('.')) || text.endsWith(QChar('.')))
+            return false;
+        int points = 0;
+        for(int i=0; i<text.length(); i++)
+        {
+            if(text[i] == QChar('.'))
+                points++;
+            else if(text[i] < QChar('0') || text[i] > QChar('9'))
+                return false;
+        }
+        return points <= 1;
+    }
+
+    // Decimal number and unit, milliseconds if none, converted without floating point
+    bool parseDuration(QString text, qint64 &ns)
+    {
+        qint64 unit = NS_PER_MS;
+        if(text.endsWith(QLatin1String("us")))
+        {
+            unit = NS_PER_US;
+            text.chop(2);
+        }
+        else if(text.endsWith(QLatin1String("ms")))
+            text.chop(2);
+        else if(text.endsWith(QLatin1String("s")))
+        {
+            unit = NS_PER_S;
+            text.chop(1);
+        }
+        if(!isDecimal(text))
+            return false;
+
+        int point = text.indexOf(QChar('.'));
+        QString whole = point < 0 ? text : text.left(point);
+        QString fraction = point < 0 ? QString() : text.mid(point + 1);
+        if(whole.length() > 6)
+            return false;
+
+        ns = whole.toLongLong() * unit;
+        qint64 scale = unit;
+        for(int i=0; i<fraction.length() && scale >= 10; i++)
+        {
+            scale /= 10;
+            ns += fraction[i].digitValue() * scale;
+        }
+        return ns <= MAX_WAIT_NS;
+    }
+}
+
+CueScript::CueScript()
+{
+}
+
+void CueScript::setDefaults(quint8 deviceId, quint8 commandFormat)
+{
+    m_defaultDeviceId = deviceId;
+    m_defaultFormat = commandFormat;
+}
+
+bool CueScript::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    return parse(QString::fromUtf8(file.readAll()), error);
+}
+
+bool CueScript::parse(const QString &text, QString *error)
+{
+    m_steps.clear();
+    m_data.clear();
+    m_lines = text.split(QChar('\n'));
+
+    quint8 deviceId = m_defaultDeviceId;
+    quint8 format = m_defaultFormat;
+    qint64 time = 0;
+
+    for(int n=0; n<m_lines.count(); n++)
+    {
+        QString line = m_lines[n];
+        int comment = line.indexOf(QChar('#'));
+        if(comment >= 0)
+            line.truncate(comment);
+        QStringList tokens = line.simplified().split(QChar(' '), QString::SkipEmptyParts);
+        if(tokens.isEmpty())
+            continue;
+
+        const QString keyword = tokens[0].toLower();
+        bool ok = true;
+        if(keyword == QLatin1String("wait"))
+        {
+            qint64 wait = 0;
+            ok = tokens.count() > 1 && parseDuration(tokens.mid(1).join(QString()), wait);
+            time += wait;
+        }
+        else if(keyword == QLatin1String("device"))
+        {
+            uint value = tokens.value(1).toUInt(&ok);
+            ok = ok && tokens.count() == 2 && value <= 0x7F;
+            deviceId = static_cast<quint8>(value);
+        }
+        else if(keyword == QLatin1String("format"))
+        {
+            int value = MscBuilder::formatFromName(tokens.value(1));
+            if(value < 0)
+            {
+                uint hex = tokens.value(1).toUInt(&ok, 16);
+                value = ok && hex <= 0x7F ? int(hex) : -1;
+            }
+            ok = tokens.count() == 2 && value >= 0;
+            format = static_cast<quint8>(value);
+        }
+        else
+        {
+            const bool hex = tokens.count() > 1 && tokens[1].toLower() == QLatin1String("hex");
+            int command = MscBuilder::commandFromName(tokens[0]);
+            MscBuilder builder(deviceId, format, static_cast<quint8>(qMax(command, 0)));
+            if(hex)
+                builder.addHex(tokens.mid(2).join(QString()));
+            else if(tokens.count() == 2)
+                builder.addEosCue(tokens[1]);
+            ok = builder.finish() && command > 0 && (hex || tokens.count() <= 2);
+
+            Step step;
+            step.time = time;
+            step.offset = m_data.length();
+            step.length = builder.length();
+            step.line = n + 1;
+            m_data.append(reinterpret_cast<const char *>(builder.data()), builder.length());
+            m_steps.append(step);
+        }
+
+        if(!ok)
+        {
+            if(error)
+                *error = tr("Line %1 : cannot read \"%2\"").arg(n + 1).arg(line.trimmed());
+            m_steps.clear();
+            m_data.clear();
+            return false;
+        }
+    }
+
+    if(m_steps.isEmpty())
+    {
+        if(error)
+            *error = tr("The script has no commands");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CUESCRIPT_H
+#define CUESCRIPT_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QCoreApplication>
+
+// MIDI Show Control cue script
+// A script is compiled once into complete MSC messages in one buffer and a
+// table of send times, so running it only hands bytes to the scheduler.
+//
+//   # Comments run to the end of the line
+//   device 1            Device ID for the commands that follow, 127 calls all
+//   format lighting     Command format, by name or as a hex byte
+//   GO 1/1              Command with Eos style list/cue, list/ or cue
+//   wait 50 ms          Delay before the next command, in us, ms or s
+//   SET hex 01 00 7F 00 Command with raw data bytes
+class CueScript
+{
+    Q_DECLARE_TR_FUNCTIONS(CueScript)
+
+public:
+    struct Step
+    {
+        qint64 time;        // Nanoseconds from the start of the script
+        int offset;         // Into the message buffer
+        int length;
+        int line;           // In the script, from 1
+    };
+
+    CueScript();
+
+    // Used until the script sets its own
+    void setDefaults(quint8 deviceId, quint8 commandFormat);
+
+    bool load(const QString &fileName, QString *error = Q_NULLPTR);
+    bool parse(const QString &text, QString *error = Q_NULLPTR);
+
+    const QVector<Step> &steps() const { return m_steps; }
+    const quint8 *message(const Step &step) const
+    {
+        return reinterpret_cast<const quint8 *>(m_data.constData()) + step.offset;
+    }
+    QString lineText(const Step &step) const { return m_lines.value(step.line - 1).trimmed(); }
+
+    qint64 duration() const { return m_steps.isEmpty() ? 0 : m_steps.last().time; }
+
+private:
+    QVector<Step> m_steps;
+    QByteArray m_data;
+    QStringList m_lines;
+    quint8 m_defaultDeviceId = 0x7F;
+    quint8 m_defaultFormat = 0x01;
+};
+
+#endif // CUESCRIPT_H
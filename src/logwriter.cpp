@@ -0,0 +1,304 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "logwriter.h"
+#include "metrics.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+// Producers are never blocked by a stalled disk, beyond this the newest data is dropped
+static const int MAX_PENDING_BYTES = 64 * 1024 * 1024;
+static const int BUFFER_RESERVE = 64 * 1024;
+
+LogWriter::LogWriter(const QString &baseName, const LogRotationPolicy &policy, Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_baseName(baseName),
+    m_policy(policy),
+    m_metrics(metrics)
+{
+    // Reserved capacity survives the buffer swaps, so steady state appends don't allocate
+    m_pending.reserve(BUFFER_RESERVE);
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+    wait();
+}
+
+void LogWriter::append(const char *data, int length)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if(m_pending.size() + length > MAX_PENDING_BYTES)
+        {
+            if(m_metrics)
+                m_metrics->add(Metrics::LOG_DROPPED_BYTES, length);
+            return;
+        }
+        m_pending.append(data, length);
+        if(m_metrics)
+            m_metrics->setGauge(Metrics::LOG_QUEUE_BYTES, m_pending.size());
+    }
+    m_wake.wakeOne();
+}
+
+void LogWriter::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stop = true;
+    }
+    m_wake.wakeOne();
+}
+
+QString LogWriter::currentFileName() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_currentFileName;
+}
+
+qint64 LogWriter::bytesWritten() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_bytesWritten;
+}
+
+void LogWriter::run()
+{
+    if(!openSegment(QDateTime::currentDateTime()))
+        return;
+
+    QByteArray batch;
+    batch.reserve(BUFFER_RESERVE);
+
+    forever
+    {
+        bool stopping = false;
+        {
+            QMutexLocker lock(&m_mutex);
+            while(m_pending.isEmpty() && !m_stop)
+            {
+                if(!m_boundary.isValid())
+                {
+                    m_wake.wait(&m_mutex);
+                    continue;
+                }
+                qint64 msecs = QDateTime::currentDateTime().msecsTo(m_boundary);
+                if(msecs <= 0)
+                    break;
+                m_wake.wait(&m_mutex, (unsigned long)msecs);
+            }
+            batch.swap(m_pending);
+            stopping = m_stop;
+            if(m_metrics)
+                m_metrics->setGauge(Metrics::LOG_QUEUE_BYTES, 0);
+        }
+
+        // Time based rotation
+        QDateTime now = QDateTime::currentDateTime();
+        if(m_boundary.isValid() && now >= m_boundary)
+        {
+            closeSegment();
+            if(!openSegment(now))
+                return;
+        }
+
+        if(!batch.isEmpty())
+        {
+            writeChunk(batch.constData(), batch.size());
+            m_file.flush();
+            {
+                QMutexLocker lock(&m_mutex);
+                m_bytesWritten += batch.size();
+            }
+            if(m_metrics)
+                m_metrics->add(Metrics::LOG_BYTES, batch.size());
+            batch.resize(0);
+        }
+
+        if(stopping)
+            break;
+    }
+
+    closeSegment();
+}
+
+void LogWriter::writeChunk(const char *data, qint64 length)
+{
+    while(length > 0)
+    {
+        qint64 take = length;
+        if(m_policy.maxFileSize > 0 && m_segmentSize + length > m_policy.maxFileSize)
+        {
+            // Split on the last complete line that still fits
+            qint64 room = qMin(m_policy.maxFileSize - m_segmentSize, length);
+            take = 0;
+            for(qint64 i=room-1; i>=0; i--)
+            {
+                if(data[i] == '\n')
+                {
+                    take = i + 1;
+                    break;
+                }
+            }
+
+            if(take == 0)
+            {
+                if(m_segmentSize > 0)
+                {
+                    closeSegment();
+                    if(!openSegment(QDateTime::currentDateTime()))
+                        return;
+                    continue;
+                }
+
+                // A single line longer than the limit still goes in whole
+                const char *lineEnd = static_cast<const char *>(memchr(data, '\n', length));
+                take = lineEnd ? (lineEnd - data) + 1 : length;
+            }
+        }
+
+        m_file.write(data, take);
+        m_segmentSize += take;
+        data += take;
+        length -= take;
+    }
+}
+
+bool LogWriter::openSegment(const QDateTime &now)
+{
+    QString stamp = segmentStamp(now);
+    if(stamp != m_stamp)
+    {
+        m_stamp = stamp;
+        m_segmentIndex = 0;
+    }
+
+    QString fileName;
+    do
+    {
+        fileName = m_baseName + m_stamp;
+        if(m_segmentIndex > 0)
+            fileName.append(QString("_%1").arg(m_segmentIndex));
+        fileName.append(QStringLiteral(".log"));
+        m_segmentIndex++;
+    } while(QFile::exists(fileName));
+
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::WriteOnly))
+    {
+        emit error(tr("Unable to open log file %1 : %2").arg(fileName).arg(m_file.errorString()));
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    // Reserve the blocks now so appends don't pay for allocation, the file size stays at zero
+    if(m_policy.preallocateSize > 0)
+        fallocate(m_file.handle(), FALLOC_FL_KEEP_SIZE, 0, m_policy.preallocateSize);
+#endif
+
+    m_segmentSize = 0;
+    m_boundary = nextBoundary(now);
+    {
+        QMutexLocker lock(&m_mutex);
+        m_currentFileName = fileName;
+    }
+
+    enforceRetention();
+    emit fileRotated(fileName);
+    return true;
+}
+
+void LogWriter::closeSegment()
+{
+    if(!m_file.isOpen())
+        return;
+
+    m_file.flush();
+
+#ifdef Q_OS_LINUX
+    // Give back whatever part of the preallocation was not used
+    if(m_policy.preallocateSize > m_segmentSize)
+        fallocate(m_file.handle(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  m_segmentSize, m_policy.preallocateSize - m_segmentSize);
+#endif
+
+    m_file.close();
+}
+
+void LogWriter::enforceRetention()
+{
+    if(m_policy.retentionCount <= 0)
+        return;
+
+    QFileInfo base(m_baseName);
+    QDir dir = base.absoluteDir();
+    QFileInfoList candidates = dir.entryInfoList(QStringList() << base.fileName() + QStringLiteral("*.log"),
+                                                 QDir::Files, QDir::Time);
+
+    // Only names openSegment() makes, so other files sharing the prefix are left alone
+    QRegExp segmentName(QRegExp::escape(base.fileName()) + QStringLiteral("\\d{2}_\\d{2}_\\d{2}(_\\d{2})?(_\\d+)?\\.log"));
+    QFileInfoList segments;
+    foreach(const QFileInfo &candidate, candidates)
+    {
+        if(segmentName.exactMatch(candidate.fileName()))
+            segments.append(candidate);
+    }
+
+    // Newest first, the segment just opened counts towards the total
+    for(int i=m_policy.retentionCount; i<segments.count(); i++)
+    {
+        if(segments[i].absoluteFilePath() == QFileInfo(m_file).absoluteFilePath())
+            continue;
+        QFile::remove(segments[i].absoluteFilePath());
+    }
+}
+
+QString LogWriter::segmentStamp(const QDateTime &when) const
+{
+    if(m_policy.interval == LogRotationPolicy::INTERVAL_HOURLY)
+        return when.toString("yy_MM_dd_hh");
+    return when.date().toString("yy_MM_dd");
+}
+
+QDateTime LogWriter::nextBoundary(const QDateTime &from) const
+{
+    QDate date = from.date();
+    switch(m_policy.interval)
+    {
+    case LogRotationPolicy::INTERVAL_HOURLY:
+        return QDateTime(date, QTime(from.time().hour(), 0)).addSecs(60 * 60);
+    case LogRotationPolicy::INTERVAL_DAILY:
+        return QDateTime(date.addDays(1), QTime(0, 0));
+    case LogRotationPolicy::INTERVAL_WEEKLY:
+        return QDateTime(date.addDays(8 - date.dayOfWeek()), QTime(0, 0));
+    case LogRotationPolicy::INTERVAL_NONE:
+    default:
+        return QDateTime();
+    }
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+
+class Metrics;
+
+// Rotation policy for the receive log
+// A new segment is started when the interval boundary passes or when the
+// current segment would grow beyond maxFileSize. Only the newest
+// retentionCount segments named by the writer are kept.
+struct LogRotationPolicy
+{
+    enum Interval {
+        INTERVAL_NONE,
+        INTERVAL_HOURLY,
+        INTERVAL_DAILY,
+        INTERVAL_WEEKLY
+    };
+
+    Interval interval = INTERVAL_DAILY;
+    qint64 maxFileSize = 0;         // Bytes, 0 for no limit
+    int retentionCount = 0;         // Segments to keep, 0 to keep all
+    qint64 preallocateSize = 0;     // Bytes reserved up front for each segment
+};
+
+// Writes log lines on a dedicated thread
+// Producers only append to an in-memory buffer, so file IO, segment rotation
+// and preallocation never happen on the receiving thread.
+class LogWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit LogWriter(const QString &baseName, const LogRotationPolicy &policy,
+                       Metrics *metrics = Q_NULLPTR, QObject *parent = Q_NULLPTR);
+    ~LogWriter();
+
+    // Thread safe, never blocks on file IO
+    void append(const char *data, int length);
+    void append(const QByteArray &data) { append(data.constData(), data.length()); }
+
+    void stop();
+
+    QString currentFileName() const;
+    qint64 bytesWritten() const;
+
+signals:
+    void fileRotated(const QString &fileName);
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    bool openSegment(const QDateTime &now);
+    void closeSegment();
+    void enforceRetention();
+    void writeChunk(const char *data, qint64 length);
+    QString segmentStamp(const QDateTime &when) const;
+    QDateTime nextBoundary(const QDateTime &from) const;
+
+    const QString m_baseName;
+    const LogRotationPolicy m_policy;
+    Metrics *m_metrics;
+
+    // Shared with producers
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    QByteArray m_pending;
+    bool m_stop = false;
+    QString m_currentFileName;
+    qint64 m_bytesWritten = 0;
+
+    // Writer thread only
+    QFile m_file;
+    qint64 m_segmentSize = 0;
+    QDateTime m_boundary;
+    QString m_stamp;
+    int m_segmentIndex = 0;
+};
+
+#endif // LOGWRITER_H
@@ -19,12 +19,85 @@
 // THE SOFTWARE.
 
 #include "mainwindow.h"
+#include "realtime.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption metricsPort("metrics-port",
+                                   QApplication::translate("main", "Serve Prometheus metrics on this localhost port."),
+                                   QApplication::translate("main", "port"));
+    QCommandLineOption metricsSocket("metrics-socket",
+                                     QApplication::translate("main", "Serve Prometheus metrics on this local socket."),
+                                     QApplication::translate("main", "path"));
+    QCommandLineOption rtPriority("rt-priority",
+                                  QApplication::translate("main", "Run the receive, scheduler and output threads SCHED_FIFO at this priority (1-99)."),
+                                  QApplication::translate("main", "priority"));
+    QCommandLineOption rtCpus("rt-cpus",
+                              QApplication::translate("main", "Pin the receive, scheduler and output threads to these cores, e.g. 2,3,1 (-1 for any)."),
+                              QApplication::translate("main", "cores"));
+    QCommandLineOption rtLockMemory("rt-lock-memory",
+                                    QApplication::translate("main", "Lock all process memory into RAM."));
+    parser.addOption(metricsPort);
+    parser.addOption(metricsSocket);
+    parser.addOption(rtPriority);
+    parser.addOption(rtCpus);
+    parser.addOption(rtLockMemory);
+    parser.process(a);
+
+    // Settled before the first thread starts, which is in the window's constructor
+    Realtime::Settings realtime;
+    if(parser.isSet(rtPriority))
+    {
+        bool ok;
+        realtime.priority = parser.value(rtPriority).toInt(&ok);
+        if(!ok || realtime.priority < 1 || realtime.priority > Realtime::MAX_PRIORITY)
+        {
+            qCritical().noquote() << QApplication::translate("main", "--rt-priority must be between 1 and %1").arg(Realtime::MAX_PRIORITY);
+            return 1;
+        }
+    }
+    QString error;
+    if(parser.isSet(rtCpus) && !Realtime::parseCpus(parser.value(rtCpus), &realtime, &error))
+    {
+        qCritical().noquote() << QString("--rt-cpus: %1").arg(error);
+        return 1;
+    }
+    realtime.lockMemory = parser.isSet(rtLockMemory);
+
+    quint16 metricsPortNumber = 0;
+    if(parser.isSet(metricsPort))
+    {
+        bool ok;
+        const uint port = parser.value(metricsPort).toUInt(&ok);
+        if(!ok || port < 1 || port > 65535)
+        {
+            qCritical().noquote() << QApplication::translate("main", "--metrics-port must be between 1 and 65535");
+            return 1;
+        }
+        metricsPortNumber = static_cast<quint16>(port);
+    }
+    Realtime::configure(realtime);
+
+    QString realtimeReport;
+    bool realtimeGranted = true;
+    if(!realtime.isDefault())
+    {
+        realtimeReport = Realtime::selfCheck(&realtimeGranted);
+        qDebug().noquote() << realtimeReport;
+    }
+
     MainWindow w;
+    if(parser.isSet(metricsPort) || parser.isSet(metricsSocket))
+        w.startMetricsExport(metricsPortNumber, parser.value(metricsSocket));
+    if(!realtimeReport.isEmpty())
+        w.showRealtimeReport(realtimeReport, realtimeGranted);
     w.show();
 
     return a.exec();
@@ -21,36 +21,24 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "mididata.h"
+#include "preciseclock.h"
+#include "udpreceiver.h"
+#include "mtcgenerator.h"
+#include "clockgenerator.h"
+#include "txscheduler.h"
+#include "smfplayer.h"
+#include "smfrecorder.h"
+#include "mscbuilder.h"
+#include "outputdispatcher.h"
+#include "midibridge.h"
+#include "sessionmanager.h"
 #include <QMessageBox>
 #include <QNetworkInterface>
-#include <QNetworkDatagram>
-#include <QMetaEnum>
 #include <QDebug>
 #include <QFileDialog>
-#include <QDate>
+#include <QFileInfo>
+#include <QDir>
 #include <QDateTime>
-#include <QAbstractEventDispatcher>
-#include <QTimer>
-
-QByteArray eosEncode(float value)
-{
-    /* There are four simple rules for formatting:
-    1. Specify the cue number first, and then the cue list
-    2. Place a "3" in front of every digit of the number
-    3. Place a "2E" wherever there is a decimal
-    4. Place a "00" when separating a cue number from the cue list */
-
-    QString asAscii = QString::number(value);
-    QByteArray result;
-    for(int i=0; i<asAscii.length(); i++)
-    {
-        if(asAscii[i]==QChar('.'))
-            result.append((char)0x2e);
-        else
-            result.append((char)0x30 | asAscii[i].digitValue());
-    }
-    return result;
-}
 
 QString stringToHex(quint8 value)
 {
@@ -58,24 +46,49 @@ QString stringToHex(quint8 value)
     return result.toUpper();
 }
 
+// Unbounded logs still get a reserved segment, trimmed back when it is closed
+static const qint64 LOG_PREALLOCATE_DEFAULT = 16 * 1024 * 1024;
+static const qint64 LOG_PREALLOCATE_MAX = 256 * 1024 * 1024;
 
-static int msecsTo(const QTime & at) {
-  const int msecsPerDay = 24 * 60 * 60 * 1000;
-  int msecs = QTime::currentTime().msecsTo(at);
-  if (msecs < 0) msecs += msecsPerDay;
-  return msecs;
-}
+// Time for the scheduler to take in a whole cue script before the first command
+static const qint64 CUE_SCRIPT_START_DELAY_NS = Q_INT64_C(50000000);
+
+// Each extra session keeps a shorter message history than the main receiver
+static const int SESSION_LOG_CAPACITY = 20000;
 
 
 
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    m_timecodeEngine(&m_metrics),
+    m_clockAnalyzer(&m_metrics)
 {
     ui->setupUi(this);
-    m_txSocket = Q_NULLPTR;
-    m_rxSocket = Q_NULLPTR;
+    ui->lbRxFilterError->setVisible(false);
+    ui->lbRealtimeReport->setVisible(false);
+
+    m_rxLog = new MessageLogModel(MessageLogModel::DIRECTION_RX, MessageLogModel::DEFAULT_CAPACITY, this);
+    m_txLog = new MessageLogModel(MessageLogModel::DIRECTION_TX, MessageLogModel::DEFAULT_CAPACITY, this);
+    ui->lvRxMessages->setModel(m_rxLog);
+    ui->lvTxMessages->setModel(m_txLog);
+
+    m_uiScheduler = new UiUpdateScheduler(UiUpdateScheduler::DEFAULT_REFRESH_RATE, this);
+    connect(m_uiScheduler, SIGNAL(frame(quint32,int)), this, SLOT(applyFrame(quint32,int)));
+
+    m_lbMidiIn = new QLabel(this);
+    m_lbMidiIn->setVisible(false);
+    ui->statusBar->addPermanentWidget(m_lbMidiIn);
+    m_lbFrameMessages = new QLabel(this);
+    ui->statusBar->addPermanentWidget(m_lbFrameMessages);
+    m_cbRefreshRate = new QComboBox(this);
+    m_cbRefreshRate->addItem(tr("UI 30 Hz"), QVariant(30));
+    m_cbRefreshRate->addItem(tr("UI 60 Hz"), QVariant(60));
+    ui->statusBar->addPermanentWidget(m_cbRefreshRate);
+    connect(m_cbRefreshRate, SIGNAL(currentIndexChanged(int)), this, SLOT(refreshRateChanged(int)));
+
+    setupStatistics();
 
     QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
     foreach(QNetworkInterface i, interfaces)
@@ -94,48 +107,46 @@ MainWindow::MainWindow(QWidget *parent) :
     }
 
 
+    // Local playback runs on its own thread, fed by the receive and GUI threads
+    m_outputDispatcher = new OutputDispatcher(&m_metrics, this);
+    m_outputDispatcher->setPlayReceived(ui->cbPlayRx->isChecked());
+    m_outputDispatcher->setPlayTransmitted(ui->cbPlayTx->isChecked());
+    connect(m_outputDispatcher, SIGNAL(error(QString)), this, SLOT(receiverError(QString)));
+    m_outputDispatcher->start(QThread::TimeCriticalPriority);
+
     ui->cbMidiOut->addItem(tr("Don't Play Locally"));
-    UINT nDevs = midiOutGetNumDevs();
-    for(UINT i=0; i<nDevs; i++)
-    {
-        MIDIOUTCAPS capabilities;
-        midiOutGetDevCaps(i,
-           &capabilities,
-           sizeof(MIDIOUTCAPS)
-        );
-        ui->cbMidiOut->addItem( QString::fromWCharArray(capabilities.szPname) );
-    }
+    m_outputDestinations = MidiOutput::destinations();
+    foreach(const MidiOutput::Destination &d, m_outputDestinations)
+        ui->cbMidiOut->addItem(d.name);
+
+    ui->cbMidiIn->addItem(tr("No MIDI Input"));
+    m_inputSources = MidiInput::sources();
+    foreach(const MidiInput::Source &source, m_inputSources)
+        ui->cbMidiIn->addItem(source.name);
 
     connect(ui->keyboardWidget, SIGNAL(noteOn(int)), this, SLOT(kbNoteOn(int)));
     connect(ui->keyboardWidget, SIGNAL(noteOff(int)), this, SLOT(kbNoteOff(int)));
 
-    QMetaEnum midiCommandFormats = QMetaEnum::fromType<MidiData::MidiCommandFormats>();
-    for(int i=0; i<midiCommandFormats.keyCount(); i++)
+    // Names come from the builder's compile time tables
+    for(int i=0; i<MscBuilder::formatCount(); i++)
     {
-        int value = midiCommandFormats.value(i);
-        const char *key = midiCommandFormats.key(i);
-        QString hex = QString("%1").arg(value, 2, 16, QChar('0'));
-        hex = hex.toUpper();
-        QString desc = QString("%1 (%2)").arg(key).arg(hex);
-        ui->cbMSCCommandFormat->addItem(desc, QVariant(value));
+        quint8 value = MscBuilder::format(i);
+        QString desc = QString("%1 (%2)").arg(QLatin1String(MscBuilder::formatName(value))).arg(stringToHex(value));
+        ui->cbMSCCommandFormat->addItem(desc, QVariant(int(value)));
     }
 
-
-    QMetaEnum midiCommands = QMetaEnum::fromType<MidiData::MidiMscCommands>();
-    for(int i=0; i<midiCommands.keyCount(); i++)
+    for(int i=0; i<MscBuilder::commandCount(); i++)
     {
-        int value = midiCommands.value(i);
-        const char *key = midiCommands.key(i);
-        QString hex = QString("%1").arg(value, 2, 16, QChar('0'));
-        hex = hex.toUpper();
-        QString desc = QString("%1 (%2)").arg(key).arg(hex);
-        ui->cbMSCCommand->addItem(desc, QVariant(value));
+        quint8 value = MscBuilder::command(i);
+        QString desc = QString("%1 (%2)").arg(QLatin1String(MscBuilder::commandName(value))).arg(stringToHex(value));
+        ui->cbMSCCommand->addItem(desc, QVariant(int(value)));
     }
 
     connect(ui->sbMSCDevId, SIGNAL(valueChanged(int)), this, SLOT(updateMscCommand()));
     connect(ui->cbMSCCommand, SIGNAL(currentIndexChanged(int)), this, SLOT(updateMscCommand()));
     connect(ui->cbMSCCommandFormat, SIGNAL(currentIndexChanged(int)), this, SLOT(updateMscCommand()));
     connect(ui->leMSCData, SIGNAL(textChanged(QString)), this, SLOT(updateMscCommand()));
+    connect(ui->cbMscDataType, SIGNAL(currentIndexChanged(int)), this, SLOT(updateMscCommand()));
 
     updateLogFileDisplay();
 
@@ -143,11 +154,22 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    // Detach the log writer and recorder while the receiver is still alive
+    stopLogging();
+    stopRecording();
+    delete m_smfPlayer;
+    delete m_midiBridge;
+    delete m_mtcGenerator;
+    delete m_clockGenerator;
+    delete m_txScheduler;
+    delete m_receiver;
+    delete m_outputDispatcher;
+    delete m_sessionManager;
     delete ui;
 }
 
 
-void MainWindow::on_btnStart_pressed()
+QNetworkInterface MainWindow::selectedNic() const
 {
     QNetworkInterface selected;
     QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
@@ -158,94 +180,288 @@ void MainWindow::on_btnStart_pressed()
            selected = i;
        }
     }
+    return selected;
+}
 
-    m_txSocket = new QUdpSocket(this);
-    m_rxSocket = new QUdpSocket(this);
+// First IPv4 address on the NIC
+QHostAddress MainWindow::nicAddress(const QNetworkInterface &nic)
+{
+    foreach (QNetworkAddressEntry ifaceAddr, nic.addressEntries())
+    {
+        if (ifaceAddr.ip().protocol() == QAbstractSocket::IPv4Protocol)
+            return ifaceAddr.ip();
+    }
+    return QHostAddress();
+}
 
-    // Bind TX socket
-    bool ok = false;
+void MainWindow::on_btnStart_pressed()
+{
+    QNetworkInterface selected = selectedNic();
 
     // Bind to first IPv4 address on selected NIC
-    QHostAddress localHostAddress;
+    QHostAddress localHostAddress = nicAddress(selected);
+
+    // Everything sent goes through the scheduler thread
+    m_txScheduler = new TxScheduler(&m_metrics, this);
+    m_txScheduler->setDestination(localHostAddress, selected, QHostAddress(ui->leTargetIp->text()),
+                                  static_cast<quint16>(ui->sbTargetPort->value()));
+    m_txScheduler->setExpectedRate(ui->sbExpectedRate->value());
+    connect(m_txScheduler, SIGNAL(error(QString)), this, SLOT(receiverError(QString)));
+    m_txScheduler->start(QThread::TimeCriticalPriority);
+
+    // Receive on its own thread, bound to the same address
+    m_receiver = new UdpReceiver(localHostAddress, static_cast<quint16>(ui->sbTargetPort->value()), &m_metrics, this);
+    m_receiver->setFilter(m_rxFilter);
+    m_receiver->setLogWriter(m_logWriter);
+    m_receiver->setRecorder(m_recorder);
+    m_receiver->setRelay(m_relayTargets, ui->cbRelayFiltered->isChecked());
+    applyTransform();
+    m_receiver->setDisplayEnabled(ui->cbLogAllInput->isChecked());
+    m_receiver->setTimecodeEngine(&m_timecodeEngine);
+    m_receiver->setClockAnalyzer(&m_clockAnalyzer);
+    m_receiver->setOutputDispatcher(m_outputDispatcher);
+    m_receiver->setBusyPoll(ui->cbBusyPoll->isChecked(), ui->sbBusyPollIdle->value(), ui->sbKernelBusyPoll->value());
+    m_receiver->setBufferPolicy(ui->sbExpectedRate->value(), ui->sbBufferGrowLimit->value() * 1024 * 1024);
+    connect(m_receiver, SIGNAL(eventsAvailable()), this, SLOT(drainReceiver()), Qt::QueuedConnection);
+    connect(m_receiver, SIGNAL(error(QString)), this, SLOT(receiverError(QString)));
+    m_receiver->start(QThread::TimeCriticalPriority);
+
+    ui->btnStart->setEnabled(false);
+    ui->sbTargetPort->setEnabled(false);
+    ui->leTargetIp->setEnabled(false);
+    ui->cbNic->setEnabled(false);
+    ui->cbBusyPoll->setEnabled(false);
+    ui->sbBusyPollIdle->setEnabled(false);
+    ui->sbKernelBusyPoll->setEnabled(false);
+    ui->sbExpectedRate->setEnabled(false);
+    ui->sbBufferGrowLimit->setEnabled(false);
+
+    m_localAddress = localHostAddress;
+    ui->cbMidiIn->setEnabled(true);
+    ui->btnMtcGenerate->setEnabled(true);
+    ui->lbMtcStatus->setText(tr("Stopped"));
+    ui->btnClockGenerate->setEnabled(true);
+    ui->lbClockStatus->setText(tr("Stopped"));
+    updateSmfPlayEnabled();
+    ui->btnCueScriptRun->setEnabled(!m_cueScript.steps().isEmpty());
+}
+
 
-    foreach (QNetworkAddressEntry ifaceAddr, selected.addressEntries())
+void MainWindow::drainReceiver()
+{
+    m_receiver->beginDrain();
+
+    int count = 0;
+    UdpReceiver::Event event;
+    while(m_receiver->takeEvent(event))
     {
-        if (ifaceAddr.ip().protocol() == QAbstractSocket::IPv4Protocol)
-        {
-            localHostAddress = ifaceAddr.ip();
-            ok = m_txSocket->bind(ifaceAddr.ip());
-            m_txSocket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, QVariant(1));
-            m_txSocket->setMulticastInterface(selected);
-            if(ok) qDebug() << "TX Socket : Bound to IP:" << ifaceAddr.ip().toString();
-            break;
-        }
+        count++;
+        const MessageRecord &record = event.record;
+        if(record.flags & MessageRecord::FLAG_DISPLAY)
+            m_rxLog->append(record);
     }
 
-    // Bind RX socket
-    ok = false;
+    m_msgCounter += count;
+    m_uiScheduler->countMessages(count);
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_RX_MESSAGES | UiUpdateScheduler::UPDATE_LOG_INFO);
+}
 
-    // Bind to mutlicast address
-    ok = m_rxSocket->bind(localHostAddress,
-                   ui->sbTargetPort->value(),
-                   QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint);
+void MainWindow::receiverError(const QString &message)
+{
+    qDebug() << message;
+    ui->statusBar->showMessage(message);
+}
 
-    if(!ok) qDebug() << "Error binding RX socket";
+void MainWindow::on_cbLogAllInput_toggled(bool checked)
+{
+    if(m_receiver)
+        m_receiver->setDisplayEnabled(checked);
+}
 
-    // Join multicast on selected NIC
-    /*if (ok)
+void MainWindow::on_leRxFilter_textChanged(const QString &text)
+{
+    QString error;
+    RxFilter filter;
+    if(!filter.compile(text, &error))
     {
-        m_rxSocket->setMulticastInterface(selected);
-        ok |= m_rxSocket->joinMulticastGroup(QHostAddress(MIDI_MULTICAST_ADDR), selected);
-    } */
+        ui->lbRxFilterError->setText(error);
+        ui->lbRxFilterError->setVisible(true);
+        return;
+    }
 
-    if(!ok) qDebug() << "Error joining RX socket to mcast group";
+    ui->lbRxFilterError->setVisible(false);
+    m_rxFilter = filter;
+    if(m_receiver)
+        m_receiver->setFilter(m_rxFilter);
+}
 
-    connect(m_rxSocket, SIGNAL(readyRead()), this, SLOT(readData()));
+void MainWindow::on_leRelayTargets_editingFinished()
+{
+    QString error;
+    QVector<UdpReceiver::RelayTarget> targets;
+    if(!UdpReceiver::parseRelayTargets(ui->leRelayTargets->text(), &targets, &error))
+    {
+        ui->lbRelayStatus->setStyleSheet("color: rgb(255, 0, 0);");
+        ui->lbRelayStatus->setText(error);
+        return;
+    }
 
-    ui->btnStart->setEnabled(false);
-    ui->sbTargetPort->setEnabled(false);
-    ui->leTargetIp->setEnabled(false);
-    ui->cbNic->setEnabled(false);
+    ui->lbRelayStatus->setStyleSheet(QString());
+    ui->lbRelayStatus->clear();
+    m_relayTargets = targets;
+    if(m_receiver)
+        m_receiver->setRelay(m_relayTargets, ui->cbRelayFiltered->isChecked());
+}
+
+void MainWindow::on_cbRelayFiltered_toggled(bool checked)
+{
+    if(m_receiver)
+        m_receiver->setRelay(m_relayTargets, checked);
+}
 
+void MainWindow::updateRelayStatus()
+{
+    Metrics::HistogramSnapshot latency = m_metrics.histogram(Metrics::RELAY_LATENCY);
+    ui->lbRelayStatus->setText(tr("%1 relayed, %2 failed : added p50 %3 us, p99 %4 us")
+                               .arg(m_metrics.counter(Metrics::RELAY_DATAGRAMS))
+                               .arg(m_metrics.counter(Metrics::RELAY_ERRORS))
+                               .arg(latency.percentile(0.5) / 1e3, 0, 'f', 1)
+                               .arg(latency.percentile(0.99) / 1e3, 0, 'f', 1));
 }
 
+void MainWindow::updateSocketBufferStatus()
+{
+    const quint64 drops = m_metrics.counter(Metrics::RX_KERNEL_DROPS);
+    ui->lbSocketBuffer->setStyleSheet(drops ? "color: rgb(255, 0, 0);" : QString());
+    ui->lbSocketBuffer->setText(tr("RX buffer %1 KB, %2 kernel drops")
+                                .arg(m_receiver->receiveBufferSize() / 1024)
+                                .arg(drops));
+}
 
-void MainWindow::readData()
+void MainWindow::on_cbMidiOut_currentIndexChanged(int index)
 {
-    while (m_rxSocket->hasPendingDatagrams())
+    if(index < 1 || index > m_outputDestinations.count())
     {
-        m_msgCounter++;
-        QNetworkDatagram datagram = m_rxSocket->receiveDatagram();
+        m_outputDispatcher->setOutput(QSharedPointer<MidiOutput>());
+        return;
+    }
 
-        if(ui->cbLogAllInput->isChecked())
-        {
-            ui->lvRxMessages->addItem(QString("%1:%2 - %3")
-                                  .arg(datagram.senderAddress().toString())
-                                  .arg(datagram.senderPort())
-                                  .arg(QString(datagram.data()))
-                                  );
-        }
-        if(m_logFile)
-        {
-            QString logMsg = QString("%1,%2,%3\r\n")
-                    .arg(QTime::currentTime().toString("hh:mm:ss:zzz"))
-                    .arg(datagram.senderAddress().toString())
-                    .arg(QString::fromLatin1(datagram.data()));
-            m_logFile->write(logMsg.toUtf8());
-            m_logFile->flush();
-            updateLogFileDisplay();
-        }
+    QString error;
+    QSharedPointer<MidiOutput> output(MidiOutput::open(m_outputDestinations.at(index - 1), &error));
+    m_outputDispatcher->setOutput(output);
+    if(!output)
+    {
+        ui->statusBar->showMessage(error);
+        return;
+    }
 
+    switch(output->dispatchCost())
+    {
+    case MidiOutput::COST_NONE:
+        ui->statusBar->showMessage(tr("Local playback discarded, no dispatch cost"));
+        break;
+    case MidiOutput::COST_SYSCALL:
+        ui->statusBar->showMessage(tr("Local playback costs one system call per message"));
+        break;
+    case MidiOutput::COST_DRIVER:
+        ui->statusBar->showMessage(tr("Local playback calls the device driver per message"));
+        break;
+    }
+}
 
-        midiMessageRecieve(datagram.data());
+void MainWindow::on_cbPlayRx_toggled(bool checked)
+{
+    m_outputDispatcher->setPlayReceived(checked);
+}
+
+void MainWindow::on_cbPlayTx_toggled(bool checked)
+{
+    m_outputDispatcher->setPlayTransmitted(checked);
+}
+
+void MainWindow::on_cbMidiIn_currentIndexChanged(int index)
+{
+    stopMidiBridge();
+    if(!m_txScheduler || index < 1 || index > m_inputSources.count())
+        return;
+
+    QString error;
+    MidiInput *input = MidiInput::open(m_inputSources.at(index - 1), &error);
+    if(!input)
+    {
+        ui->statusBar->showMessage(error);
+        return;
     }
 
+    m_midiBridge = new MidiBridge(input, m_txScheduler, &m_metrics, this);
+    connect(m_midiBridge, SIGNAL(error(QString)), this, SLOT(receiverError(QString)));
+    m_midiBridge->start(QThread::TimeCriticalPriority);
+    m_midiInSent = 0;
+    m_lbMidiIn->setText(tr("MIDI in : waiting"));
+    m_lbMidiIn->setVisible(true);
 }
 
-void MainWindow::on_cbMidiOut_currentIndexChanged(int index)
+void MainWindow::updateMidiInStatus()
+{
+    // Nothing else marks frames while only the bridge is busy
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+
+    TxScheduler::SourceReport report = m_txScheduler->sourceReport(m_midiBridge->source());
+    if(report.sent == m_midiInSent)
+        return;
+    m_midiInSent = report.sent;
+
+    m_lbMidiIn->setText(tr("MIDI in : %1 sent, input to wire p50 %2 us, p99 %3 us, max %4 us")
+                        .arg(report.sent)
+                        .arg(report.lateness.percentile(0.5) / 1e3, 0, 'f', 1)
+                        .arg(report.lateness.percentile(0.99) / 1e3, 0, 'f', 1)
+                        .arg(report.latenessMaxNs / 1e3, 0, 'f', 1));
+}
+
+void MainWindow::stopMidiBridge()
+{
+    delete m_midiBridge;
+    m_midiBridge = Q_NULLPTR;
+    m_lbMidiIn->setVisible(false);
+}
+
+void MainWindow::on_btnTransformOpen_pressed()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Mapping File"), QString(), tr("Mapping Files (*.txt *.map);;All Files (*)"));
+    if(fileName.isEmpty())
+        return;
+
+    QSharedPointer<MidiTransform> transform(new MidiTransform);
+    QString error;
+    if(!transform->load(fileName, &error))
+    {
+        ui->statusBar->showMessage(tr("%1 : %2").arg(QFileInfo(fileName).fileName()).arg(error));
+        return;
+    }
+
+    m_transform = transform;
+    ui->cbTransform->setToolTip(QDir::toNativeSeparators(fileName));
+    ui->cbTransform->setEnabled(true);
+    if(ui->cbTransform->isChecked())
+        applyTransform();
+    else
+        ui->cbTransform->setChecked(true);
+}
+
+void MainWindow::on_cbTransform_toggled(bool)
+{
+    applyTransform();
+}
+
+void MainWindow::applyTransform()
 {
-    midiOutClose(m_midiOut);
-    midiOutOpen(&m_midiOut, index-1, NULL, NULL, CALLBACK_NULL );
+    QSharedPointer<const MidiTransform> transform;
+    if(ui->cbTransform->isChecked() && m_transform && !m_transform->isIdentity())
+        transform = m_transform;
+    if(m_txScheduler)
+        m_txScheduler->setTransform(transform);
+    if(m_receiver)
+        m_receiver->setRelayTransform(transform);
 }
 
 void MainWindow::kbNoteOn(int note)
@@ -253,7 +469,7 @@ void MainWindow::kbNoteOn(int note)
     quint8 midiMsg[3];
     midiMsg[0] = MidiData::MIDI_NOTE_ON;
     midiMsg[1] = note;
-    midiMsg[2] = 64; // velocity
+    midiMsg[2] = static_cast<quint8>(ui->sbNoteVelocity->value());
 
     midiMessageSend(midiMsg, 3);
 }
@@ -263,276 +479,911 @@ void MainWindow::kbNoteOff(int note)
     quint8 midiMsg[3];
     midiMsg[0] = MidiData::MIDI_NOTE_OFF;
     midiMsg[1] = note;
-    midiMsg[2] = 64; // velocity
+    // The keyboard has no release sensing, so note off always carries the
+    // MIDI default release velocity rather than the note on velocity
+    midiMsg[2] = 64;
 
     midiMessageSend(midiMsg, 3);
 }
 
 void MainWindow::midiMessageSend(quint8 *msg, int length)
 {
-    if(length==3)
+    m_outputDispatcher->playTransmitted(msg, length, PreciseClock::nowNs());
+
+    m_txLog->appendMidi(msg, length);
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_TX_MESSAGES);
+
+    if(m_txScheduler)
+        m_txScheduler->sendNow(msg, length);
+}
+
+void MainWindow::updateMscCommand()
+{
+    MscBuilder builder(0xFF & ui->sbMSCDevId->value(),
+                       0xFF & ui->cbMSCCommandFormat->currentData().toInt(),
+                       0xFF & ui->cbMSCCommand->currentData().toInt());
+    if(ui->cbMscDataType->currentIndex() == 0)
+        builder.addHex(ui->leMSCData->text());
+    else
+        builder.addEosCue(ui->leMSCData->text());
+    bool valid = builder.finish();
+    m_mscCommand = QByteArray(reinterpret_cast<const char *>(builder.data()), builder.length());
+
+    QString composedCommand;
+    for(int i=0; i<m_mscCommand.length(); i++)
+    {
+        composedCommand.append(stringToHex(m_mscCommand.at(i)));
+        composedCommand.append(" ");
+    }
+
+    ui->leMSCComposedData->setText(composedCommand);
+    ui->lbInvalidData->setVisible(!valid);
+    ui->btnMSCSend->setEnabled(valid);
+}
+
+void MainWindow::on_btnMSCSend_pressed()
+{
+    midiMessageSend((quint8*)m_mscCommand.data(), m_mscCommand.length());
+}
+
+void MainWindow::on_cbLogToFile_pressed()
+{
+    m_msgCounter = 0;
+    if(!ui->cbLogToFile->isChecked())
     {
-        if(ui->cbMidiOut->currentIndex()!=0 && ui->cbPlayTx->isChecked())
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save Log File"), QString(), tr("Log Files (*.log)"));
+        if(fileName.isEmpty())
         {
-            quint32 packedMsg;
-            packedMsg = msg[0];
-            packedMsg |= msg[1] << 8;
-            packedMsg |= msg[2] << 16;
-            midiOutShortMsg(m_midiOut, packedMsg);
+            ui->cbLogToFile->setChecked(false);
+            return;
         }
+        fileName.chop(3); // Remove the .log postfix
+
+        // The receive thread may hold the last reference, so deletion goes back through the event loop
+        m_logWriter = QSharedPointer<LogWriter>(new LogWriter(fileName, logRotationPolicy(), &m_metrics), &QObject::deleteLater);
+        connect(m_logWriter.data(), SIGNAL(fileRotated(QString)), this, SLOT(updateLogFileDisplay()));
+        connect(m_logWriter.data(), SIGNAL(error(QString)), this, SLOT(logWriterError(QString)));
+        m_logWriter->start(QThread::LowPriority);
+        if(m_receiver)
+            m_receiver->setLogWriter(m_logWriter);
+
+        ui->cbLogToFile->setChecked(true);
+        ui->cbLogRotation->setEnabled(false);
+        ui->sbLogMaxSize->setEnabled(false);
+        ui->sbLogRetention->setEnabled(false);
     }
+    else {
+        stopLogging();
+    }
+}
 
-    QString message("MIDI");
-    for(int i=0; i<length; i++)
-        message.append(QString(" %1").arg(msg[i],2, 16, QChar('0')).toUpper());
+LogRotationPolicy MainWindow::logRotationPolicy() const
+{
+    LogRotationPolicy policy;
+    policy.interval = static_cast<LogRotationPolicy::Interval>(ui->cbLogRotation->currentIndex());
+    policy.maxFileSize = qint64(ui->sbLogMaxSize->value()) * 1024 * 1024;
+    policy.retentionCount = ui->sbLogRetention->value();
+    policy.preallocateSize = policy.maxFileSize > 0 ? qMin(policy.maxFileSize, LOG_PREALLOCATE_MAX)
+                                                    : LOG_PREALLOCATE_DEFAULT;
+    return policy;
+}
 
-    ui->teBuffer->appendPlainText(message);
+void MainWindow::logWriterError(const QString &message)
+{
+    stopLogging();
+    ui->cbLogToFile->setChecked(false);
+    QMessageBox::warning(this, tr("Logging Stopped"), message);
+}
+
+void MainWindow::stopLogging()
+{
+    if(m_logWriter)
+    {
+        if(m_receiver)
+            m_receiver->setLogWriter(QSharedPointer<LogWriter>());
+
+        // Drains anything still queued before the segment is closed
+        m_logWriter->stop();
+        m_logWriter->wait();
+        m_logWriter.reset();
+    }
 
-    if(m_txSocket)
-        m_txSocket->writeDatagram(message.toLatin1(), QHostAddress(ui->leTargetIp->text()), ui->sbTargetPort->value());
+    ui->cbLogRotation->setEnabled(true);
+    ui->sbLogMaxSize->setEnabled(true);
+    ui->sbLogRetention->setEnabled(true);
+    updateLogFileDisplay();
+}
+
+void MainWindow::updateLogFileDisplay()
+{
+    if(!m_logWriter)
+        ui->lbLogInfo->clear();
+    else {
+       QString logInfo = tr("Logging to %1 : %2 messages")
+               .arg(m_logWriter->currentFileName())
+               .arg(m_msgCounter);
+       ui->lbLogInfo->setText(logInfo);
+    }
 }
 
-void MainWindow::midiMessageRecieve(const QByteArray &data)
+void MainWindow::on_cbRecordSmf_pressed()
 {
-    // Check it's MIDI
-    if(!(data[0]=='M' && data[1]=='I' && data[2]=='D' && data[3]=='I'))
+    if(ui->cbRecordSmf->isChecked())
+    {
+        stopRecording();
         return;
+    }
 
-    QString s(data.mid(4));
-    QStringList chunks = s.split(QChar(' '), QString::SkipEmptyParts);
-    QByteArray theMidi;
-    for(int i=0; i<chunks.count(); i++)
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Record MIDI File"), QString(), tr("MIDI Files (*.mid)"));
+    if(fileName.isEmpty())
     {
-        bool ok = false;
-        quint8 value = chunks[i].toInt(&ok, 16);
-        if(ok)
-            theMidi.append(1, value);
+        ui->cbRecordSmf->setChecked(false);
+        return;
     }
 
-    if(theMidi.size()==3)
+    // The receive thread may hold the last reference, so deletion goes back through the event loop
+    m_recorder = QSharedPointer<SmfRecorder>(new SmfRecorder(fileName, &m_metrics), &QObject::deleteLater);
+    connect(m_recorder.data(), SIGNAL(error(QString)), this, SLOT(recorderError(QString)));
+    m_recorder->start(QThread::LowPriority);
+    if(m_receiver)
+        m_receiver->setRecorder(m_recorder);
+
+    ui->cbRecordSmf->setChecked(true);
+    updateRecordDisplay();
+}
+
+void MainWindow::recorderError(const QString &message)
+{
+    stopRecording();
+    ui->cbRecordSmf->setChecked(false);
+    QMessageBox::warning(this, tr("Recording Stopped"), message);
+}
+
+void MainWindow::stopRecording()
+{
+    if(m_recorder)
     {
-        if(ui->cbMidiOut->currentIndex()!=0 && ui->cbPlayRx->isChecked())
-        {
-            quint32 packedMsg;
-            packedMsg = (quint8)theMidi[0];
-            packedMsg |= (quint8)theMidi[1] << 8;
-            packedMsg |= (quint8)theMidi[2] << 16;
-            midiOutShortMsg(m_midiOut, packedMsg);
-        }
+        if(m_receiver)
+            m_receiver->setRecorder(QSharedPointer<SmfRecorder>());
+
+        // Writes what is still queued and patches the track length
+        m_recorder->stop();
+        m_recorder->wait();
+        m_recorder.reset();
     }
 
-    if(memcmp(theMidi.data(), &MidiData::TIMECODE_START, sizeof(MidiData::TIMECODE_START)) == 0)
+    updateRecordDisplay();
+}
+
+void MainWindow::updateRecordDisplay()
+{
+    if(!m_recorder)
+        ui->lbRecordInfo->clear();
+    else
     {
-        int index = sizeof(MidiData::TIMECODE_START);
-        quint8 hours = theMidi.at(index);
-        index++;
-        quint8 minutes = theMidi.at(index);
-        index++;
-        quint8 seconds = theMidi.at(index);
-        index++;
-        quint8 frames = theMidi.at(index);
+        ui->lbRecordInfo->setText(tr("Recording to %1 : %2 messages")
+                                  .arg(m_recorder->fileName())
+                                  .arg(m_recorder->messagesRecorded()));
+    }
+}
 
-        QString value = QString("%1:%2:%3:%4")
-                .arg(hours, 2, 10, QLatin1Char('0'))
-                .arg(minutes, 2, 10, QLatin1Char('0'))
-                .arg(seconds, 2, 10, QLatin1Char('0'))
-                .arg(frames, 2, 10, QLatin1Char('0'));
+void MainWindow::applyFrame(quint32 flags, int messagesSinceLastFrame)
+{
+    if(flags & UiUpdateScheduler::UPDATE_RX_MESSAGES)
+        m_rxLog->commit();
+    if(flags & UiUpdateScheduler::UPDATE_TX_MESSAGES)
+        m_txLog->commit();
+    if(flags & UiUpdateScheduler::UPDATE_LOG_INFO)
+    {
+        updateLogFileDisplay();
+        updateRecordDisplay();
+    }
+    updateTimecodeDisplay();
+    if(m_mtcGenerator)
+        updateMtcStatus();
+    updateClockDisplay();
+    if(m_clockGenerator)
+        updateClockStatus();
+    if(m_smfPlayer)
+        updateSmfStatus();
+    if(m_cueRunning)
+        updateCueScriptStatus();
+    if(m_midiBridge)
+        updateMidiInStatus();
+    if(m_receiver && !m_relayTargets.isEmpty() && (flags & UiUpdateScheduler::UPDATE_RX_MESSAGES))
+        updateRelayStatus();
+    if(m_receiver && (flags & UiUpdateScheduler::UPDATE_RX_MESSAGES))
+        updateSocketBufferStatus();
+    if(!m_sessions.isEmpty())
+        updateSessions();
+
+    m_lbFrameMessages->setText(tr("%1 messages since last frame").arg(messagesSinceLastFrame));
+}
+
+void MainWindow::updateTimecodeDisplay()
+{
+    quint32 version;
+    TimecodeEngine::State state = m_timecodeEngine.state(&version);
+    bool running = TimecodeEngine::isRunning(state, PreciseClock::nowNs());
+
+    // Keep frames coming while timecode runs, so a stop is noticed without new messages
+    if(running)
+        m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_TIMECODE);
 
-        ui->nTimecode->display(value);
+    if(version == m_timecodeVersion && running == m_timecodeRunning)
+        return;
+    m_timecodeVersion = version;
+    m_timecodeRunning = running;
+
+    ui->nTimecode->display(state.position.toString().replace(QChar(';'), QChar(':')));
+
+    if(state.quarterFrames == 0)
+    {
+        ui->lbTimecodeInfo->setText(tr("Full frame, %1 fps").arg(Timecode::rateName(state.position.rate)));
+        return;
     }
 
+    QString direction = !running ? tr("Stopped")
+            : state.direction == TimecodeEngine::DIRECTION_REVERSE ? tr("Reverse") : tr("Forward");
+    QString info = tr("%1 fps (measured %2)\n%3%4\nJitter %5 ms mean, %6 ms max\nDrift %7 ms (%8 ppm)\n%9 discontinuities")
+            .arg(Timecode::rateName(state.position.rate))
+            .arg(state.measuredFps, 0, 'f', 2)
+            .arg(direction)
+            .arg(state.locked ? QString() : tr(", not locked"))
+            .arg(state.jitterMeanNs / 1e6, 0, 'f', 3)
+            .arg(state.jitterMaxNs / 1e6, 0, 'f', 3)
+            .arg(state.driftNs / 1e6, 0, 'f', 2)
+            .arg(state.driftPpm, 0, 'f', 1)
+            .arg(state.discontinuities);
+    ui->lbTimecodeInfo->setText(info);
 }
 
+void MainWindow::on_btnMtcGenerate_toggled(bool checked)
+{
+    if(!checked)
+    {
+        stopMtcGenerator();
+        return;
+    }
 
-void MainWindow::updateMscCommand()
+    Timecode start;
+    start.rate = static_cast<Timecode::Rate>(ui->cbMtcRate->currentIndex());
+    QStringList fields = ui->leMtcStart->text().split(QChar(':'));
+    int values[4] = {0, 0, 0, 0};
+    for(int i=0; i<fields.count() && i<4; i++)
+        values[i] = fields[i].toInt();
+    if(values[0] > 23 || values[1] > 59 || values[2] > 59 || values[3] >= Timecode::nominalFps(start.rate))
+    {
+        ui->lbMtcStatus->setText(tr("Invalid start time"));
+        ui->btnMtcGenerate->setChecked(false);
+        return;
+    }
+    start.hours = static_cast<quint8>(values[0]);
+    start.minutes = static_cast<quint8>(values[1]);
+    start.seconds = static_cast<quint8>(values[2]);
+    start.frames = static_cast<quint8>(values[3]);
+    // Moves a dropped drop frame label on to the next real frame
+    start = Timecode::fromFrameNumber(start.toFrameNumber(), start.rate);
+
+    m_mtcGenerator = new MtcGenerator(&m_metrics, this);
+    m_mtcGenerator->setDestination(m_localAddress, QHostAddress(ui->leTargetIp->text()), static_cast<quint16>(ui->sbTargetPort->value()));
+    m_mtcGenerator->setStartPosition(start);
+    m_mtcGenerator->setFullFrameInterval(ui->sbMtcFullFrameInterval->value());
+    connect(m_mtcGenerator, SIGNAL(error(QString)), this, SLOT(mtcGeneratorError(QString)));
+    m_mtcGenerator->start(QThread::TimeCriticalPriority);
+
+    ui->cbMtcRate->setEnabled(false);
+    ui->leMtcStart->setEnabled(false);
+    ui->sbMtcFullFrameInterval->setEnabled(false);
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_TIMECODE);
+}
+
+void MainWindow::mtcGeneratorError(const QString &message)
 {
-    m_mscCommand.clear();
-    m_mscCommand.append((char)0xF0);
-    m_mscCommand.append((char)0x7F);
-    m_mscCommand.append((char)0xFF & ui->sbMSCDevId->value());
-    m_mscCommand.append((char)0x02);
-    m_mscCommand.append((char)0xFF & ui->cbMSCCommandFormat->currentData().toInt());
-    m_mscCommand.append((char)0xFF & ui->cbMSCCommand->currentData().toInt());
-    m_mscCommand.append(m_mscData);
-    m_mscCommand.append((char)0xF7);
+    // Refused real-time settings leave the generator running
+    if(m_mtcGenerator && !m_mtcGenerator->failed())
+    {
+        ui->statusBar->showMessage(message);
+        return;
+    }
 
-    QString composedCommand;
-    for(int i=0; i<m_mscCommand.length(); i++)
+    stopMtcGenerator();
+    ui->btnMtcGenerate->setChecked(false);
+    ui->lbMtcStatus->setText(message);
+}
+
+void MainWindow::stopMtcGenerator()
+{
+    if(m_mtcGenerator)
     {
-        composedCommand.append(stringToHex(m_mscCommand.at(i)));
-        composedCommand.append(" ");
+        m_mtcGenerator->stop();
+        m_mtcGenerator->wait();
+        updateMtcStatus();
+        delete m_mtcGenerator;
+        m_mtcGenerator = Q_NULLPTR;
     }
 
-    ui->leMSCComposedData->setText(composedCommand);
+    ui->cbMtcRate->setEnabled(true);
+    ui->leMtcStart->setEnabled(true);
+    ui->sbMtcFullFrameInterval->setEnabled(true);
 }
 
-void MainWindow::on_leMSCData_textChanged(const QString &text)
+void MainWindow::updateMtcStatus()
 {
-    m_mscData.clear();
-    if(ui->cbMscDataType->currentIndex() == 0)
+    MtcGenerator::State state = m_mtcGenerator->state();
+    if(state.running)
+        m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_TIMECODE);
+
+    QString status = tr("%1 %2 : %3 quarter frames, %4 full frames : send jitter %5 us mean, %6 us max")
+            .arg(state.running ? tr("Sending") : tr("Stopped at"))
+            .arg(state.position.toString())
+            .arg(state.quarterFrames)
+            .arg(state.fullFrames)
+            .arg(state.jitterMeanNs / 1e3, 0, 'f', 1)
+            .arg(state.jitterMaxNs / 1e3, 0, 'f', 1);
+    if(state.resyncs > 0)
+        status.append(tr(" : %1 stalls").arg(state.resyncs));
+    ui->lbMtcStatus->setText(status);
+}
+
+void MainWindow::updateClockDisplay()
+{
+    quint32 version;
+    ClockAnalyzer::State state = m_clockAnalyzer.state(&version);
+    bool receiving = ClockAnalyzer::isReceiving(state, PreciseClock::nowNs());
+
+    if(receiving)
+        m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+
+    if(version == m_clockVersion && receiving == m_clockReceiving)
+        return;
+    m_clockVersion = version;
+    m_clockReceiving = receiving;
+
+    if(state.ticks == 0)
+        return;
+
+    QString info = tr("%1 BPM%2\n%3, beat %4\nJitter %5 ms mean, %6 ms max")
+            .arg(receiving ? QString::number(state.bpm, 'f', 2) : tr("--"))
+            .arg(receiving ? QString() : tr(", no clock"))
+            .arg(state.playing ? tr("Playing") : tr("Stopped"))
+            .arg(state.songPosition / ClockAnalyzer::PPQN + 1)
+            .arg(state.jitterMeanNs / 1e6, 0, 'f', 3)
+            .arg(state.jitterMaxNs / 1e6, 0, 'f', 3);
+    ui->lbClockInfo->setText(info);
+}
+
+void MainWindow::on_btnClockGenerate_toggled(bool checked)
+{
+    if(!checked)
     {
-        // Data should be Hex bytes
-        QString dataString = text;
-        dataString.replace(QString(" "), QString());
-        if(dataString.length() % 2)
-        {
-            // Not properly formatted - invalid
-            ui->lbInvalidData->setVisible(true);
-            ui->btnMSCSend->setEnabled(false);
-            return;
-        }
-        for(int i=0; i<dataString.length(); i+=2)
-        {
-            QString byteString;
-            byteString.resize(2);
-            byteString[0] = dataString[i];
-            byteString[1] = dataString[i+1];
-            bool ok = false;
-            quint8 value = byteString.toInt(&ok, 16);
-            if(!ok)
-            {
-                ui->lbInvalidData->setVisible(true);
-                ui->btnMSCSend->setEnabled(false);
-                m_mscData.clear();
-                return;
-            }
-            m_mscData.append((char) value);
-        }
+        stopClockGenerator();
+        return;
     }
-    if(ui->cbMscDataType->currentIndex()==1)
+
+    m_clockGenerator = new ClockGenerator(&m_metrics, this);
+    m_clockGenerator->setDestination(m_localAddress, QHostAddress(ui->leTargetIp->text()), static_cast<quint16>(ui->sbTargetPort->value()));
+    m_clockGenerator->setBpm(ui->sbClockBpm->value());
+    connect(m_clockGenerator, SIGNAL(error(QString)), this, SLOT(clockGeneratorError(QString)));
+    m_clockGenerator->start(QThread::TimeCriticalPriority);
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+}
+
+void MainWindow::on_sbClockBpm_valueChanged(double bpm)
+{
+    if(m_clockGenerator)
+        m_clockGenerator->setBpm(bpm);
+}
+
+void MainWindow::clockGeneratorError(const QString &message)
+{
+    // Refused real-time settings leave the generator running
+    if(m_clockGenerator && !m_clockGenerator->failed())
     {
-        // Eos cue format
-        /* There are four simple rules for formatting:
-        1. Specify the cue number first, and then the cue list
-        2. Place a "3" in front of every digit of the number
-        3. Place a "2E" wherever there is a decimal
-        4. Place a "00" when separating a cue number from the cue list */
+        ui->statusBar->showMessage(message);
+        return;
+    }
+
+    stopClockGenerator();
+    ui->btnClockGenerate->setChecked(false);
+    ui->lbClockStatus->setText(message);
+}
+
+void MainWindow::stopClockGenerator()
+{
+    if(m_clockGenerator)
+    {
+        m_clockGenerator->stop();
+        m_clockGenerator->wait();
+        updateClockStatus();
+        delete m_clockGenerator;
+        m_clockGenerator = Q_NULLPTR;
+    }
+}
+
+void MainWindow::updateClockStatus()
+{
+    ClockGenerator::State state = m_clockGenerator->state();
+    if(state.running)
+        m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+
+    ui->lbClockStatus->setText(tr("%1 at %2 BPM : %3 ticks : send jitter %4 us mean, %5 us max")
+            .arg(state.running ? tr("Sending") : tr("Stopped"))
+            .arg(state.bpm, 0, 'f', 3)
+            .arg(state.ticks)
+            .arg(state.jitterMeanNs / 1e3, 0, 'f', 1)
+            .arg(state.jitterMaxNs / 1e3, 0, 'f', 1));
+}
+
+void MainWindow::on_btnSmfOpen_pressed()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open MIDI File"), QString(), tr("MIDI Files (*.mid *.midi *.smf)"));
+    if(fileName.isEmpty())
+        return;
 
-        // Entered format is Cuelist/Cue
-        // Or cuelist/
-        // Or cue
-        QRegExp regex("([0-9.]*)/?([0-9.]+)?");
-        QList<float> parts;
-        bool noCueNum = text.endsWith(QChar('/'));
+    stopSmfPlayer();
+    QString error;
+    if(!m_midiFile.load(fileName, &error))
+    {
+        m_midiFile = MidiFile();
+        ui->lbSmfFile->setText(tr("No file loaded"));
+        QMessageBox::warning(this, tr("Open MIDI File"), error);
+    }
+    else
+    {
+        ui->lbSmfFile->setText(tr("%1 : format %2, %3 tracks, %4 events, %5 s")
+                               .arg(QFileInfo(fileName).fileName())
+                               .arg(m_midiFile.format())
+                               .arg(m_midiFile.trackCount())
+                               .arg(m_midiFile.events().count())
+                               .arg(m_midiFile.duration() / 1e9, 0, 'f', 1));
+    }
+    ui->lbSmfStatus->clear();
+    updateSmfPlayEnabled();
+}
 
+void MainWindow::updateSmfPlayEnabled()
+{
+    ui->btnSmfPlay->setEnabled(m_txScheduler && !m_midiFile.events().isEmpty());
+}
 
-        int pos = regex.indexIn(text);
-        if(pos>-1)
+void MainWindow::on_btnSmfPlay_toggled(bool checked)
+{
+    if(!checked)
+    {
+        stopSmfPlayer();
+        return;
+    }
+
+    if(m_smfSource)
+        m_txScheduler->releaseSource(m_smfSource);
+    m_smfPlayer = new SmfPlayer(m_midiFile, m_txScheduler, ui->sbSmfSpeed->value(), this);
+    m_smfSource = m_smfPlayer->source();
+    connect(m_smfPlayer, SIGNAL(finished()), this, SLOT(smfPlayerFinished()));
+    m_smfPlayer->start(QThread::HighPriority);
+
+    ui->btnSmfOpen->setEnabled(false);
+    ui->sbSmfSpeed->setEnabled(false);
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+}
+
+void MainWindow::smfPlayerFinished()
+{
+    // Ignore a player that was already stopped and replaced
+    if(!m_smfPlayer || !m_smfPlayer->isFinished())
+        return;
+    stopSmfPlayer();
+    ui->btnSmfPlay->setChecked(false);
+}
+
+void MainWindow::stopSmfPlayer()
+{
+    if(m_smfPlayer)
+    {
+        m_smfPlayer->stop();
+        m_smfPlayer->wait();
+        updateSmfStatus();
+        delete m_smfPlayer;
+        m_smfPlayer = Q_NULLPTR;
+    }
+
+    ui->btnSmfOpen->setEnabled(true);
+    ui->sbSmfSpeed->setEnabled(true);
+}
+
+void MainWindow::updateSmfStatus()
+{
+    SmfPlayer::Progress progress = m_smfPlayer->progress();
+    TxScheduler::SourceReport report = m_txScheduler->sourceReport(m_smfSource);
+    if(progress.playing)
+        m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+
+    QString status = tr("%1 %2 / %3 s : %4 of %5 events sent\n"
+                        "Lateness p50 %6 us, p99 %7 us, max %8 us : %9 over 1 ms")
+            .arg(progress.playing ? tr("Playing") : tr("Stopped at"))
+            .arg(progress.positionNs / 1e9, 0, 'f', 1)
+            .arg(progress.durationNs / 1e9, 0, 'f', 1)
+            .arg(report.sent)
+            .arg(progress.eventCount)
+            .arg(report.lateness.percentile(0.5) / 1e3, 0, 'f', 1)
+            .arg(report.lateness.percentile(0.99) / 1e3, 0, 'f', 1)
+            .arg(report.latenessMaxNs / 1e3, 0, 'f', 1)
+            .arg(report.late);
+    if(progress.dropped)
+        status.append(tr(" : %1 dropped").arg(progress.dropped));
+    ui->lbSmfStatus->setText(status);
+}
+
+void MainWindow::on_btnCueScriptOpen_pressed()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Cue Script"), QString(), tr("Cue Scripts (*.txt *.msc);;All Files (*)"));
+    if(fileName.isEmpty())
+        return;
+
+    // Commands without their own device or format use the Show Control tab's
+    m_cueScript.setDefaults(static_cast<quint8>(qMin(ui->sbMSCDevId->value(), 0x7F)),
+                            static_cast<quint8>(ui->cbMSCCommandFormat->currentData().toInt()));
+    QString error;
+    if(!m_cueScript.load(fileName, &error))
+    {
+        m_cueScript = CueScript();
+        ui->lbCueScriptFile->setText(tr("No script loaded"));
+        QMessageBox::warning(this, tr("Open Cue Script"), error);
+    }
+    else
+    {
+        ui->lbCueScriptFile->setText(tr("%1 : %2 commands, %3 s")
+                                     .arg(QFileInfo(fileName).fileName())
+                                     .arg(m_cueScript.steps().count())
+                                     .arg(m_cueScript.duration() / 1e9, 0, 'f', 3));
+    }
+    ui->lbCueScriptStatus->clear();
+    ui->teCueScriptReport->clear();
+    ui->btnCueScriptRun->setEnabled(m_txScheduler && !m_cueScript.steps().isEmpty());
+}
+
+void MainWindow::on_btnCueScriptRun_toggled(bool checked)
+{
+    if(!checked)
+    {
+        stopCueScript();
+        return;
+    }
+
+    if(m_cueSource)
+        m_txScheduler->releaseSource(m_cueSource);
+    m_cueSource = TxScheduler::newSource();
+    m_txScheduler->traceSource(m_cueSource);
+
+    // The whole script is compiled, so it is handed over at once
+    const qint64 origin = PreciseClock::nowNs() + CUE_SCRIPT_START_DELAY_NS;
+    const QVector<CueScript::Step> &steps = m_cueScript.steps();
+    for(int i=0; i<steps.count(); i++)
+    {
+        if(!m_txScheduler->schedule(origin + steps[i].time, m_cueScript.message(steps[i]), steps[i].length, m_cueSource))
         {
-            for(int i=0; i<regex.captureCount(); i++)
-            {
-                QString capture = regex.cap(i+1);
-                bool ok;
-                float value = capture.toFloat(&ok);
-                if(!ok)
-                    parts << 0;
-                else
-                    parts << value;
-            }
+            m_txScheduler->cancel(m_cueSource);
+            ui->statusBar->showMessage(tr("Transmit queue full, cue script not run"));
+            ui->btnCueScriptRun->setChecked(false);
+            return;
         }
+    }
+
+    m_cueRunning = true;
+    ui->btnCueScriptOpen->setEnabled(false);
+    ui->teCueScriptReport->clear();
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+}
+
+void MainWindow::stopCueScript()
+{
+    ui->btnCueScriptOpen->setEnabled(true);
+    if(!m_cueRunning)
+        return;
+    m_txScheduler->cancel(m_cueSource);
+    m_cueRunning = false;
+    updateCueScriptStatus();
+
+    // Planned against actual send time for every command
+    TxScheduler::SourceReport report = m_txScheduler->sourceReport(m_cueSource);
+    const QVector<CueScript::Step> &steps = m_cueScript.steps();
+    QStringList lines;
+    lines << tr("Line  Planned ms   Actual ms    Late us  Command");
+    for(int i=0; i<steps.count(); i++)
+    {
+        const CueScript::Step &step = steps[i];
+        QString actual = i < report.trace.count() ? QString("%1").arg((step.time + report.trace[i]) / 1e6, 11, 'f', 3)
+                                                  : tr("not sent").rightJustified(11);
+        QString late = i < report.trace.count() ? QString("%1").arg(report.trace[i] / 1e3, 10, 'f', 1)
+                                                : QString(10, QChar(' '));
+        lines << QString("%1 %2 %3 %4  %5")
+                 .arg(step.line, 5)
+                 .arg(step.time / 1e6, 11, 'f', 3)
+                 .arg(actual)
+                 .arg(late)
+                 .arg(m_cueScript.lineText(step));
+    }
+    ui->teCueScriptReport->setPlainText(lines.join(QChar('\n')));
+}
 
-        if(parts.count()<1 || parts.count()>2 || (parts[0]==0 && parts[1]==0))
+void MainWindow::updateCueScriptStatus()
+{
+    TxScheduler::SourceReport report = m_txScheduler->sourceReport(m_cueSource);
+    const int count = m_cueScript.steps().count();
+    if(m_cueRunning)
+    {
+        if(report.sent >= quint64(count))
         {
-            ui->lbInvalidData->setVisible(true);
-            ui->btnMSCSend->setEnabled(false);
-            m_mscData.clear();
+            // Unchecking stops the run, which fills in the report
+            ui->btnCueScriptRun->setChecked(false);
             return;
         }
+        m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+    }
 
-        // Cuelist/cue
-        if(parts[0]>0 && parts[1]>0)
+    ui->lbCueScriptStatus->setText(tr("%1 : %2 of %3 commands sent\n"
+                                      "Lateness p50 %4 us, p99 %5 us, max %6 us : %7 over 1 ms")
+            .arg(m_cueRunning ? tr("Running") : tr("Stopped"))
+            .arg(report.sent)
+            .arg(count)
+            .arg(report.lateness.percentile(0.5) / 1e3, 0, 'f', 1)
+            .arg(report.lateness.percentile(0.99) / 1e3, 0, 'f', 1)
+            .arg(report.latenessMaxNs / 1e3, 0, 'f', 1)
+            .arg(report.late));
+}
+
+void MainWindow::refreshRateChanged(int index)
+{
+    m_uiScheduler->setRefreshRate(m_cbRefreshRate->itemData(index).toInt());
+}
+
+void MainWindow::setupStatistics()
+{
+    const int rows = Metrics::COUNTER_COUNT + Metrics::GAUGE_COUNT + Metrics::HISTOGRAM_COUNT;
+    ui->twStats->setRowCount(rows);
+    for(int row=0; row<rows; row++)
+    {
+        QString name;
+        QString description;
+        if(row < Metrics::COUNTER_COUNT)
         {
-            m_mscData.append(eosEncode(parts[1]));
-            m_mscData.append((char)0x00);
-            m_mscData.append(eosEncode(parts[0]));
+            name = Metrics::name(static_cast<Metrics::Counter>(row));
+            description = Metrics::description(static_cast<Metrics::Counter>(row));
         }
-
-        // Cuelist/
-        if(noCueNum)
+        else if(row < Metrics::COUNTER_COUNT + Metrics::GAUGE_COUNT)
         {
-            m_mscData.append((char)0x00);
-            m_mscData.append(eosEncode(parts[0]));
+            Metrics::Gauge gauge = static_cast<Metrics::Gauge>(row - Metrics::COUNTER_COUNT);
+            name = Metrics::name(gauge);
+            description = Metrics::description(gauge);
         }
         else
         {
-            m_mscData.append(eosEncode(parts[0]));
-            m_mscData.append((char)0x00);
+            Metrics::Histogram histogram = static_cast<Metrics::Histogram>(row - Metrics::COUNTER_COUNT - Metrics::GAUGE_COUNT);
+            name = Metrics::name(histogram);
+            description = Metrics::description(histogram);
         }
 
-
-
+        QTableWidgetItem *item = new QTableWidgetItem(name);
+        item->setToolTip(description);
+        ui->twStats->setItem(row, 0, item);
+        for(int column=1; column<ui->twStats->columnCount(); column++)
+            ui->twStats->setItem(row, column, new QTableWidgetItem());
     }
+    ui->twStats->resizeColumnToContents(0);
 
+    for(int i=0; i<Metrics::COUNTER_COUNT; i++)
+        m_lastCounters[i] = 0;
+    m_lastStatsTime = PreciseClock::nowNs();
 
-    updateMscCommand();
-    ui->lbInvalidData->setVisible(false);
-    ui->btnMSCSend->setEnabled(true);
+    connect(&m_statsTimer, SIGNAL(timeout()), this, SLOT(updateStatistics()));
+    m_statsTimer.start(1000);
 }
 
-void MainWindow::on_btnMSCSend_pressed()
+void MainWindow::updateStatistics()
 {
-    midiMessageSend((quint8*)m_mscCommand.data(), m_mscCommand.length());
+    qint64 now = PreciseClock::nowNs();
+    double elapsed = (now - m_lastStatsTime) / 1e9;
+    m_lastStatsTime = now;
+
+    // Rates keep tracking while hidden, the table is only repainted when visible
+    bool visible = ui->twStats->isVisible();
+    int row = 0;
+    for(int i=0; i<Metrics::COUNTER_COUNT; i++, row++)
+    {
+        quint64 value = m_metrics.counter(static_cast<Metrics::Counter>(i));
+        double rate = elapsed > 0 ? (value - m_lastCounters[i]) / elapsed : 0;
+        m_lastCounters[i] = value;
+        if(visible)
+        {
+            ui->twStats->item(row, 1)->setText(QString::number(value));
+            ui->twStats->item(row, 2)->setText(QString::number(rate, 'f', 1));
+        }
+    }
+
+    if(!visible)
+        return;
+
+    for(int i=0; i<Metrics::GAUGE_COUNT; i++, row++)
+        ui->twStats->item(row, 1)->setText(QString::number(m_metrics.gauge(static_cast<Metrics::Gauge>(i))));
+
+    for(int i=0; i<Metrics::HISTOGRAM_COUNT; i++, row++)
+    {
+        Metrics::HistogramSnapshot snapshot = m_metrics.histogram(static_cast<Metrics::Histogram>(i));
+        ui->twStats->item(row, 1)->setText(QString::number(snapshot.count));
+        ui->twStats->item(row, 3)->setText(QString::number(snapshot.percentile(0.5) / 1000.0, 'f', 1));
+        ui->twStats->item(row, 4)->setText(QString::number(snapshot.percentile(0.99) / 1000.0, 'f', 1));
+    }
 }
 
-void MainWindow::on_cbLogToFile_pressed()
+bool MainWindow::startMetricsExport(quint16 port, const QString &localPath)
 {
-    m_msgCounter = 0;
-    if(!ui->cbLogToFile->isChecked())
+    if(!m_metricsServer)
+        m_metricsServer = new MetricsServer(&m_metrics, this);
+
+    QStringList endpoints;
+    bool ok = true;
+    if(port != 0)
     {
-        m_logFileName = QFileDialog::getSaveFileName(this, tr("Save Log File"), QString(), tr("Log Files (*.log)"));
-        if(m_logFileName.isEmpty())
-        {
-            m_logFileName = "";
-            m_logFile = Q_NULLPTR;
-            ui->cbLogToFile->setChecked(false);
-            return;
-        }
-        m_logFileName.chop(3); // Remove the .log postfix
-        rotateLogFile();
-        ui->cbLogToFile->setChecked(true);
+        if(m_metricsServer->listenTcp(port))
+            endpoints << QString("http://127.0.0.1:%1/metrics").arg(port);
+        else
+            ok = false;
+    }
+    if(!localPath.isEmpty())
+    {
+        if(m_metricsServer->listenLocal(localPath))
+            endpoints << localPath;
+        else
+            ok = false;
+    }
+
+    if(!ok)
+        ui->lbMetricsInfo->setText(tr("Export failed : %1").arg(m_metricsServer->errorString()));
+    else
+        ui->lbMetricsInfo->setText(tr("Serving %1").arg(endpoints.join(", ")));
+
+    // Keep the controls in step when started from the command line
+    ui->cbMetricsExport->blockSignals(true);
+    ui->cbMetricsExport->setChecked(ok);
+    ui->cbMetricsExport->blockSignals(false);
+    if(port != 0)
+        ui->sbMetricsPort->setValue(port);
+    ui->sbMetricsPort->setEnabled(!ok);
 
+    return ok;
+}
+
+void MainWindow::showRealtimeReport(const QString &report, bool granted)
+{
+    ui->lbRealtimeReport->setText(report);
+    ui->lbRealtimeReport->setVisible(true);
+    if(!granted)
+        ui->statusBar->showMessage(tr("Real-time settings not fully granted, see the Statistics tab"));
+}
 
-        // Rotate the log at midnight
-        auto timer = new QTimer(QAbstractEventDispatcher::instance());
-        timer->start(msecsTo(QTime(0,0,0)));
-        QObject::connect(timer, &QTimer::timeout, [=, &timer]{
-          this->rotateLogFile();
-          timer->deleteLater();
-        });
+void MainWindow::on_cbMetricsExport_toggled(bool checked)
+{
+    if(checked)
+    {
+        startMetricsExport(static_cast<quint16>(ui->sbMetricsPort->value()));
     }
-    else {
-        ui->lbLogInfo->clear();
+    else
+    {
+        delete m_metricsServer;
+        m_metricsServer = Q_NULLPTR;
+        ui->lbMetricsInfo->clear();
+        ui->sbMetricsPort->setEnabled(true);
     }
 }
 
-void MainWindow::rotateLogFile()
+void MainWindow::on_btnSessionAdd_pressed()
 {
-    if(m_logFile)
+    Session::Config config;
+    config.name = ui->leSessionName->text().trimmed();
+    if(config.name.isEmpty())
+        config.name = tr("Session %1").arg(m_sessions.count() + 1);
+    config.address = nicAddress(selectedNic()).toIPv4Address();
+    config.port = static_cast<quint16>(ui->sbSessionPort->value());
+
+    if(ui->cbSessionLog->isChecked())
     {
-        m_logFile->close();
-        m_logFile = Q_NULLPTR;
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save Session Log File"), QString(), tr("Log Files (*.log)"));
+        if(fileName.isEmpty())
+            return;
+        fileName.chop(3); // Remove the .log postfix
+        config.logBaseName = fileName;
+        config.logPolicy = logRotationPolicy();
     }
 
-    QString fileName = m_logFileName + QString("%1.log").arg(QDate::currentDate().toString("yy_MM_dd"));
+    // The pool's threads are only started once a session needs them
+    if(!m_sessionManager)
+    {
+        m_sessionManager = new SessionManager(this);
+        m_sessionManager->start(QThread::TimeCriticalPriority);
+    }
 
-    m_logFile = new QFile(fileName);
-    if(!m_logFile->open(QIODevice::WriteOnly))
+    QString error;
+    Session *session = m_sessionManager->add(config, &error);
+    if(!session)
     {
-        ui->cbLogToFile->setChecked(false);
-        m_logFile = Q_NULLPTR;
+        QMessageBox::warning(this, tr("Session Not Added"), tr("Error binding session socket : %1").arg(error));
+        return;
     }
-    updateLogFileDisplay();
+    if(session->logWriter())
+        connect(session->logWriter(), SIGNAL(error(QString)), this, SLOT(receiverError(QString)));
+
+    SessionView view;
+    view.session = session;
+    view.log = new MessageLogModel(MessageLogModel::DIRECTION_RX, SESSION_LOG_CAPACITY, this);
+    m_sessions.append(view);
+
+    int row = ui->twSessions->rowCount();
+    ui->twSessions->insertRow(row);
+    ui->twSessions->setItem(row, 0, new QTableWidgetItem(config.name));
+    ui->twSessions->setItem(row, 1, new QTableWidgetItem(QString("%1:%2")
+                                                         .arg(QHostAddress(config.address).toString())
+                                                         .arg(session->localPort())));
+    for(int column=2; column<ui->twSessions->columnCount(); column++)
+        ui->twSessions->setItem(row, column, new QTableWidgetItem(QString::number(0)));
+    ui->twSessions->selectRow(row);
+
+    ui->leSessionName->clear();
+    if(config.port != 0 && config.port < 65535)
+        ui->sbSessionPort->setValue(config.port + 1);
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+}
 
+void MainWindow::on_btnSessionRemove_pressed()
+{
+    int row = ui->twSessions->currentRow();
+    if(row < 0 || row >= m_sessions.count())
+        return;
+
+    SessionView view = m_sessions.takeAt(row);
+    if(ui->lvSessionMessages->model() == view.log)
+        ui->lvSessionMessages->setModel(Q_NULLPTR);
+    m_sessionManager->remove(view.session);
+    delete view.log;
+    ui->twSessions->removeRow(row);
+    if(m_sessions.isEmpty())
+        ui->lbSessionPool->clear();
 }
 
-void MainWindow::updateLogFileDisplay()
+void MainWindow::on_twSessions_itemSelectionChanged()
 {
-    if(!m_logFile)
-        ui->lbLogInfo->clear();
-    else {
-       QString logInfo = tr("Logging to %1 : %2 messages")
-               .arg(m_logFile->fileName())
-               .arg(m_msgCounter);
-       ui->lbLogInfo->setText(logInfo);
+    int row = ui->twSessions->currentRow();
+    bool selected = row >= 0 && row < m_sessions.count() && !ui->twSessions->selectedItems().isEmpty();
+    ui->lvSessionMessages->setModel(selected ? m_sessions.at(row).log : Q_NULLPTR);
+    ui->btnSessionRemove->setEnabled(selected);
+}
+
+void MainWindow::updateSessions()
+{
+    // Sessions don't signal, so frames keep coming while any exist
+    m_uiScheduler->markDirty(UiUpdateScheduler::UPDATE_STATUS);
+
+    for(int row=0; row<m_sessions.count(); row++)
+    {
+        const SessionView &view = m_sessions.at(row);
+        int count = 0;
+        UdpReceiver::Event event;
+        while(view.session->takeEvent(event))
+        {
+            count++;
+            view.log->append(event.record);
+        }
+        if(count)
+            view.log->commit();
+
+        const Metrics &metrics = view.session->metrics();
+        ui->twSessions->item(row, 2)->setText(QString::number(metrics.counter(Metrics::RX_DATAGRAMS)));
+        ui->twSessions->item(row, 3)->setText(QString::number(metrics.counter(Metrics::RX_MESSAGES)));
+        ui->twSessions->item(row, 4)->setText(QString::number(metrics.counter(Metrics::RX_PARSE_ERRORS)));
+        ui->twSessions->item(row, 5)->setText(QString::number(metrics.counter(Metrics::RX_QUEUE_DROPS)));
     }
+
+    ui->lbSessionPool->setText(tr("%1 sessions on %2 pool threads, %3 steals")
+                               .arg(m_sessions.count())
+                               .arg(m_sessionManager->threadCount())
+                               .arg(m_sessionManager->steals()));
 }
@@ -24,8 +24,34 @@
 #include <QMainWindow>
 #include <QTimer>
 #include <QUdpSocket>
-#include <QFile>
-#include "windows.h"
+#include <QLabel>
+#include <QComboBox>
+#include <QSharedPointer>
+#include <QNetworkInterface>
+#include "logwriter.h"
+#include "messagelogmodel.h"
+#include "uiupdatescheduler.h"
+#include "metrics.h"
+#include "metricsserver.h"
+#include "rxfilter.h"
+#include "udpreceiver.h"
+#include "timecodeengine.h"
+#include "clockanalyzer.h"
+#include "midifile.h"
+#include "cuescript.h"
+#include "midioutput.h"
+#include "midiinput.h"
+#include "miditransform.h"
+
+class MtcGenerator;
+class ClockGenerator;
+class TxScheduler;
+class SmfPlayer;
+class SmfRecorder;
+class OutputDispatcher;
+class MidiBridge;
+class Session;
+class SessionManager;
 
 namespace Ui {
 class MainWindow;
@@ -40,30 +66,125 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    // Serve metrics on a localhost TCP port and/or a local socket, 0 or empty to skip
+    bool startMetricsExport(quint16 port, const QString &localPath = QString());
+    // Result of the startup real-time self-check, shown under the statistics
+    void showRealtimeReport(const QString &report, bool granted);
+
 private slots:
     void on_btnStart_pressed();
-    void readData();
+    void drainReceiver();
+    void receiverError(const QString &message);
+    void on_cbLogAllInput_toggled(bool checked);
+    void on_leRxFilter_textChanged(const QString &text);
     void kbNoteOn(int note);
     void kbNoteOff(int note);
+    void on_leRelayTargets_editingFinished();
+    void on_cbRelayFiltered_toggled(bool checked);
     void on_cbMidiOut_currentIndexChanged(int index);
-    void on_leMSCData_textChanged(const QString &text);
+    void on_cbPlayRx_toggled(bool checked);
+    void on_cbPlayTx_toggled(bool checked);
+    void on_cbMidiIn_currentIndexChanged(int index);
+    void on_btnTransformOpen_pressed();
+    void on_cbTransform_toggled(bool checked);
     void updateMscCommand();
     void on_btnMSCSend_pressed();
     void on_cbLogToFile_pressed();
-private:
-    void rotateLogFile();
+    void logWriterError(const QString &message);
     void updateLogFileDisplay();
+    void applyFrame(quint32 flags, int messagesSinceLastFrame);
+    void refreshRateChanged(int index);
+    void updateStatistics();
+    void on_cbMetricsExport_toggled(bool checked);
+    void on_btnMtcGenerate_toggled(bool checked);
+    void mtcGeneratorError(const QString &message);
+    void on_btnClockGenerate_toggled(bool checked);
+    void on_sbClockBpm_valueChanged(double bpm);
+    void clockGeneratorError(const QString &message);
+    void on_btnSmfOpen_pressed();
+    void on_btnSmfPlay_toggled(bool checked);
+    void smfPlayerFinished();
+    void on_cbRecordSmf_pressed();
+    void recorderError(const QString &message);
+    void on_btnCueScriptOpen_pressed();
+    void on_btnCueScriptRun_toggled(bool checked);
+    void on_btnSessionAdd_pressed();
+    void on_btnSessionRemove_pressed();
+    void on_twSessions_itemSelectionChanged();
+private:
+    void setupStatistics();
+    void updateTimecodeDisplay();
+    void updateMtcStatus();
+    void stopMtcGenerator();
+    void updateClockDisplay();
+    void updateClockStatus();
+    void stopClockGenerator();
+    void updateSmfStatus();
+    void stopSmfPlayer();
+    void updateSmfPlayEnabled();
+    void updateCueScriptStatus();
+    void stopCueScript();
+    void updateMidiInStatus();
+    void updateRelayStatus();
+    void updateSocketBufferStatus();
+    void applyTransform();
+    void stopMidiBridge();
+    void stopRecording();
+    void updateRecordDisplay();
+    void stopLogging();
+    LogRotationPolicy logRotationPolicy() const;
+    QNetworkInterface selectedNic() const;
+    static QHostAddress nicAddress(const QNetworkInterface &nic);
+    void updateSessions();
     Ui::MainWindow *ui;
-    QUdpSocket *m_txSocket;
-    QUdpSocket *m_rxSocket;
-    HMIDIOUT m_midiOut;
+    TxScheduler *m_txScheduler = Q_NULLPTR;
+    UdpReceiver *m_receiver = Q_NULLPTR;
+    RxFilter m_rxFilter;
+    QVector<UdpReceiver::RelayTarget> m_relayTargets;
+    QSharedPointer<const MidiTransform> m_transform;
+    OutputDispatcher *m_outputDispatcher = Q_NULLPTR;
+    QList<MidiOutput::Destination> m_outputDestinations;
+    MidiBridge *m_midiBridge = Q_NULLPTR;
+    QList<MidiInput::Source> m_inputSources;
+    quint64 m_midiInSent = 0;
     void midiMessageSend(quint8* msg, int length);
-    void midiMessageRecieve(const QByteArray &data);
+    MessageLogModel *m_rxLog;
+    MessageLogModel *m_txLog;
+    UiUpdateScheduler *m_uiScheduler;
+    QLabel *m_lbFrameMessages;
+    QLabel *m_lbMidiIn;
+    QComboBox *m_cbRefreshRate;
     QByteArray m_mscCommand;
-    QByteArray m_mscData;
-    QString m_logFileName;
-    QFile *m_logFile = Q_NULLPTR;
+    QSharedPointer<LogWriter> m_logWriter;
     int m_msgCounter = 0;
+    Metrics m_metrics;
+    MetricsServer *m_metricsServer = Q_NULLPTR;
+    QTimer m_statsTimer;
+    quint64 m_lastCounters[Metrics::COUNTER_COUNT];
+    qint64 m_lastStatsTime = 0;
+    TimecodeEngine m_timecodeEngine;
+    quint32 m_timecodeVersion = 0;
+    bool m_timecodeRunning = false;
+    QHostAddress m_localAddress;
+    MtcGenerator *m_mtcGenerator = Q_NULLPTR;
+    ClockAnalyzer m_clockAnalyzer;
+    quint32 m_clockVersion = 0;
+    bool m_clockReceiving = false;
+    ClockGenerator *m_clockGenerator = Q_NULLPTR;
+    MidiFile m_midiFile;
+    SmfPlayer *m_smfPlayer = Q_NULLPTR;
+    quint32 m_smfSource = 0;
+    QSharedPointer<SmfRecorder> m_recorder;
+    CueScript m_cueScript;
+    quint32 m_cueSource = 0;
+    bool m_cueRunning = false;
+    struct SessionView
+    {
+        Session *session;
+        MessageLogModel *log;
+    };
+    SessionManager *m_sessionManager = Q_NULLPTR;
+    QList<SessionView> m_sessions;
 };
 
 
@@ -0,0 +1,158 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "messagelogmodel.h"
+#include "udpmidi.h"
+#include "mscmessage.h"
+#include "midistatus.h"
+#include <QHostAddress>
+#include <cstring>
+
+MessageLogModel::MessageLogModel(Direction direction, int capacity, QObject *parent) :
+    QAbstractListModel(parent),
+    m_direction(direction),
+    m_ring(qMax(capacity, 1))
+{
+}
+
+MessageRecord &MessageLogModel::nextSlot()
+{
+    MessageRecord &slot = m_ring[static_cast<int>(m_total % m_ring.size())];
+    m_total++;
+    return slot;
+}
+
+void MessageLogModel::append(const MessageRecord &record)
+{
+    nextSlot() = record;
+}
+
+void MessageLogModel::appendMidi(const quint8 *data, int length, quint32 address, quint16 port)
+{
+    MessageRecord &record = nextSlot();
+    record.address = address;
+    record.port = port;
+    record.set(data, length, MessageRecord::FLAG_MIDI);
+    if(MscMessage::isMsc(data, length))
+        record.flags |= MessageRecord::FLAG_MSC;
+}
+
+void MessageLogModel::appendText(const char *text, int length, quint32 address, quint16 port)
+{
+    MessageRecord &record = nextSlot();
+    record.address = address;
+    record.port = port;
+    record.set(text, length, 0);
+}
+
+void MessageLogModel::clear()
+{
+    beginResetModel();
+    m_total = 0;
+    m_first = 0;
+    m_count = 0;
+    endResetModel();
+}
+
+void MessageLogModel::commit()
+{
+    const quint64 capacity = static_cast<quint64>(m_ring.size());
+    const quint64 newFirst = m_total > capacity ? m_total - capacity : 0;
+
+    // Rows whose records have been overwritten leave from the top
+    if(newFirst > m_first)
+    {
+        int removed = static_cast<int>(qMin<quint64>(newFirst - m_first, static_cast<quint64>(m_count)));
+        if(removed > 0)
+        {
+            beginRemoveRows(QModelIndex(), 0, removed - 1);
+            m_count -= removed;
+            m_first += removed;
+            endRemoveRows();
+        }
+        m_first = newFirst;
+    }
+
+    int added = static_cast<int>(m_total - m_first) - m_count;
+    if(added > 0)
+    {
+        beginInsertRows(QModelIndex(), m_count, m_count + added - 1);
+        m_count += added;
+        endInsertRows();
+    }
+}
+
+int MessageLogModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid())
+        return 0;
+    return m_count;
+}
+
+QVariant MessageLogModel::data(const QModelIndex &index, int role) const
+{
+    if(role != Qt::DisplayRole || !index.isValid() || index.row() >= m_count)
+        return QVariant();
+
+    // Rows may have been overwritten since the last commit
+    const quint64 absolute = m_first + static_cast<quint64>(index.row());
+    if(m_total - absolute > static_cast<quint64>(m_ring.size()))
+        return QVariant();
+
+    return format(m_ring.at(static_cast<int>(absolute % m_ring.size())));
+}
+
+QString MessageLogModel::format(const MessageRecord &record) const
+{
+    char text[UdpMidi::HEADER_LENGTH + MessageRecord::MAX_DATA * 3];
+    int length;
+    if(record.flags & MessageRecord::FLAG_MIDI)
+        length = UdpMidi::encode(record.data, record.storedLength(), text, sizeof(text));
+    else
+    {
+        length = record.storedLength();
+        memcpy(text, record.data, length);
+    }
+
+    QString result = QString::fromLatin1(text, length);
+    if(record.flags & MessageRecord::FLAG_TRUNCATED)
+        result.append(tr(" ... (%1 bytes)").arg(record.length));
+
+    // Only rows a view asks for are decoded
+    char description[256];
+    int descriptionLength = 0;
+    MscMessage msc;
+    if((record.flags & MessageRecord::FLAG_MSC) && MscMessage::decode(record.data, record.storedLength(), msc))
+        descriptionLength = msc.describe(description, sizeof(description));
+    else if(record.flags & MessageRecord::FLAG_MIDI)
+        descriptionLength = MidiStatus::disassemble(record.data, record.storedLength(), description, sizeof(description));
+    if(descriptionLength > 0)
+    {
+        result.append(QLatin1String(" : "));
+        result.append(QString::fromLatin1(description, descriptionLength));
+    }
+
+    if(m_direction == DIRECTION_RX)
+        return QString("%1:%2 - %3")
+                .arg(QHostAddress(record.address).toString())
+                .arg(record.port)
+                .arg(result);
+    return result;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MESSAGELOGMODEL_H
+#define MESSAGELOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "messagerecord.h"
+
+// List model over a fixed capacity ring of MessageRecords
+// Appending only copies the record into the ring, rows are published to the
+// views in one batch when the owner calls commit() and text is formatted only
+// when a view asks for a visible row. Once full, the oldest records are dropped.
+class MessageLogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Direction {
+        DIRECTION_RX,
+        DIRECTION_TX
+    };
+
+    static const int DEFAULT_CAPACITY = 100000;
+
+    explicit MessageLogModel(Direction direction, int capacity = DEFAULT_CAPACITY, QObject *parent = Q_NULLPTR);
+
+    void append(const MessageRecord &record);
+    void appendMidi(const quint8 *data, int length, quint32 address = 0, quint16 port = 0);
+    void appendText(const char *text, int length, quint32 address = 0, quint16 port = 0);
+
+    int capacity() const { return m_ring.size(); }
+    void clear();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+public slots:
+    // Publish everything appended since the last commit to the views
+    void commit();
+
+private:
+    MessageRecord &nextSlot();
+    QString format(const MessageRecord &record) const;
+
+    const Direction m_direction;
+    QVector<MessageRecord> m_ring;
+    quint64 m_total = 0;        // Records ever appended
+    quint64 m_first = 0;        // Absolute index of row 0
+    int m_count = 0;            // Rows the views know about
+};
+
+#endif // MESSAGELOGMODEL_H
@@ -0,0 +1,47 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "messagelogview.h"
+#include <QScrollBar>
+#include <QFontDatabase>
+
+MessageLogView::MessageLogView(QWidget *parent) :
+    QListView(parent)
+{
+    setUniformItemSizes(true);
+    setEditTriggers(QAbstractItemView::NoEditTriggers);
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scrollValueChanged(int)));
+    connect(verticalScrollBar(), SIGNAL(rangeChanged(int,int)), this, SLOT(scrollRangeChanged(int,int)));
+}
+
+void MessageLogView::scrollValueChanged(int value)
+{
+    m_following = (value == verticalScrollBar()->maximum());
+}
+
+void MessageLogView::scrollRangeChanged(int min, int max)
+{
+    Q_UNUSED(min);
+    if(m_following)
+        verticalScrollBar()->setValue(max);
+}
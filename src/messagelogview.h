@@ -0,0 +1,44 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MESSAGELOGVIEW_H
+#define MESSAGELOGVIEW_H
+
+#include <QListView>
+
+// List view for MessageLogModel
+// Rows are a uniform height so only the visible ones are ever laid out or
+// formatted. While scrolled to the bottom the view follows new rows.
+class MessageLogView : public QListView
+{
+    Q_OBJECT
+
+public:
+    explicit MessageLogView(QWidget *parent = Q_NULLPTR);
+
+private slots:
+    void scrollValueChanged(int value);
+    void scrollRangeChanged(int min, int max);
+
+private:
+    bool m_following = true;
+};
+
+#endif // MESSAGELOGVIEW_H
@@ -0,0 +1,64 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MESSAGERECORD_H
+#define MESSAGERECORD_H
+
+#include <QtGlobal>
+#include <cstring>
+
+// Fixed size record of one sent or received datagram
+// Stored by value in ring buffers, so nothing here may own memory.
+struct MessageRecord
+{
+    enum Flags {
+        FLAG_MIDI = 0x01,       // data holds decoded MIDI bytes, otherwise the raw datagram text
+        FLAG_TRUNCATED = 0x02,  // length is larger than what was kept in data
+        FLAG_DISPLAY = 0x04,    // passed the receive filter and should be shown
+        FLAG_MSC = 0x08         // data is a MIDI Show Control message
+    };
+
+    enum {
+        RECORD_SIZE = 64,
+        HEADER_SIZE = 4 + 2 + 2 + 1,
+        MAX_DATA = RECORD_SIZE - HEADER_SIZE
+    };
+
+    quint32 address;            // IPv4 sender (RX) or target (TX), host byte order
+    quint16 port;
+    quint16 length;             // Length of the full message
+    quint8 flags;
+    quint8 data[MAX_DATA];
+
+    int storedLength() const { return length < MAX_DATA ? length : MAX_DATA; }
+
+    void set(const void *bytes, int size, quint8 recordFlags)
+    {
+        length = static_cast<quint16>(size < 0xFFFF ? size : 0xFFFF);
+        flags = recordFlags;
+        if(size > MAX_DATA)
+            flags |= FLAG_TRUNCATED;
+        memcpy(data, bytes, storedLength());
+    }
+};
+
+Q_STATIC_ASSERT(sizeof(MessageRecord) == MessageRecord::RECORD_SIZE);
+
+#endif // MESSAGERECORD_H
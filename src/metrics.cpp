@@ -0,0 +1,212 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "metrics.h"
+#include <QtAlgorithms>
+#include <cmath>
+#include <cstring>
+
+struct MetricInfo
+{
+    const char *name;
+    const char *description;
+};
+
+static const MetricInfo COUNTER_INFO[Metrics::COUNTER_COUNT] = {
+    {"udpmidi_rx_syscalls_total", "Receive system calls made on the RX socket"},
+    {"udpmidi_rx_datagrams_total", "Datagrams received"},
+    {"udpmidi_rx_bytes_total", "Datagram payload bytes received"},
+    {"udpmidi_rx_messages_total", "MIDI messages decoded from received datagrams"},
+    {"udpmidi_rx_parse_errors_total", "Invalid hex tokens, stray or truncated MIDI bytes and datagrams that were not MIDI"},
+    {"udpmidi_rx_filtered_total", "Received messages, or non-MIDI datagrams, rejected by the receive filter"},
+    {"udpmidi_rx_queue_drops_total", "Received messages dropped because the GUI queue was full"},
+    {"udpmidi_mtc_quarter_frames_total", "MTC quarter frame messages received"},
+    {"udpmidi_mtc_full_frames_total", "MTC full frame messages received"},
+    {"udpmidi_mtc_discontinuities_total", "Jumps, direction changes and lost pieces in received MTC"},
+    {"udpmidi_clock_ticks_total", "MIDI beat clock ticks received"},
+    {"udpmidi_log_bytes_total", "Bytes written to the receive log"},
+    {"udpmidi_log_dropped_bytes_total", "Log bytes dropped because the writer fell behind"},
+    {"udpmidi_record_messages_total", "Received messages written to the MIDI file recording"},
+    {"udpmidi_record_drops_total", "Received messages dropped because the MIDI file recorder fell behind"},
+    {"udpmidi_output_messages_total", "Messages dispatched to the local MIDI output"},
+    {"udpmidi_output_errors_total", "Messages the local MIDI output failed to take"},
+    {"udpmidi_output_queue_drops_total", "Messages not played locally because the output queue was full"},
+    {"udpmidi_tx_sends_total", "Datagrams sent"},
+    {"udpmidi_tx_bytes_total", "Datagram payload bytes sent"},
+    {"udpmidi_tx_errors_total", "Datagrams the socket failed to send"},
+    {"udpmidi_tx_schedule_drops_total", "Messages refused because the transmit schedule was full"},
+    {"udpmidi_input_messages_total", "Messages read from the local MIDI input and forwarded"},
+    {"udpmidi_input_errors_total", "Local MIDI input messages lost, too long or refused by the transmit schedule"},
+    {"udpmidi_relay_datagrams_total", "Received datagrams relayed, counted once per target"},
+    {"udpmidi_relay_errors_total", "Relayed datagrams the socket failed to send"},
+    {"udpmidi_rx_kernel_drops_total", "Datagrams the kernel dropped because the receive socket buffer was full"}
+};
+
+static const MetricInfo GAUGE_INFO[Metrics::GAUGE_COUNT] = {
+    {"udpmidi_rx_queue_depth", "Received messages waiting for the GUI thread"},
+    {"udpmidi_log_queue_bytes", "Bytes waiting for the log writer thread"},
+    {"udpmidi_tx_schedule_pending", "Messages waiting in the transmit schedule"},
+    {"udpmidi_output_queue_depth", "Messages waiting for the local MIDI output thread"},
+    {"udpmidi_rx_socket_buffer_bytes", "Kernel receive buffer granted to the receive socket"}
+};
+
+static const MetricInfo HISTOGRAM_INFO[Metrics::HISTOGRAM_COUNT] = {
+    {"udpmidi_rx_processing_seconds", "Time spent handling one received datagram"},
+    {"udpmidi_output_dispatch_seconds", "Time taken to hand one message to the local MIDI output"},
+    {"udpmidi_output_rx_latency_seconds", "Time from network arrival to the local MIDI output for received messages"},
+    {"udpmidi_output_tx_latency_seconds", "Time from sending to the local MIDI output for transmitted messages"},
+    {"udpmidi_mtc_quarter_frame_jitter_seconds", "Deviation of received MTC quarter frame spacing from nominal"},
+    {"udpmidi_mtc_send_jitter_seconds", "Lateness of generated MTC messages against their scheduled send time"},
+    {"udpmidi_clock_tick_jitter_seconds", "Deviation of received MIDI clock tick spacing from the measured tempo"},
+    {"udpmidi_clock_send_jitter_seconds", "Lateness of generated MIDI clock ticks against their scheduled send time"},
+    {"udpmidi_tx_schedule_lateness_seconds", "Lateness of scheduled messages against their send time"},
+    {"udpmidi_input_to_wire_seconds", "Time from reading a local MIDI input message to sending its datagram"},
+    {"udpmidi_relay_latency_seconds", "Time from receiving a datagram to relaying it to every target"},
+    {"udpmidi_rx_wakeup_latency_seconds", "Time from kernel arrival to the receive thread reading a datagram after waiting for it"},
+    {"udpmidi_rx_spin_latency_seconds", "Time from kernel arrival to the receive thread reading a datagram while busy polling"}
+};
+
+static inline int bucketIndex(qint64 nanoseconds)
+{
+    if(nanoseconds <= 0)
+        return 0;
+    int bits = 64 - qCountLeadingZeroBits(static_cast<quint64>(nanoseconds));
+    return qMin(bits, Metrics::HISTOGRAM_BUCKETS - 1);
+}
+
+Metrics::Metrics()
+{
+    for(int i=0; i<COUNTER_COUNT; i++)
+        m_counters[i].value.store(0, std::memory_order_relaxed);
+    for(int i=0; i<GAUGE_COUNT; i++)
+        m_gauges[i].value.store(0, std::memory_order_relaxed);
+    for(int i=0; i<HISTOGRAM_COUNT; i++)
+    {
+        for(int b=0; b<HISTOGRAM_BUCKETS; b++)
+            m_histograms[i].buckets[b].store(0, std::memory_order_relaxed);
+        m_histograms[i].sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::record(Histogram histogram, qint64 nanoseconds)
+{
+    HistogramCell &cell = m_histograms[histogram];
+    cell.buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    cell.sum.fetch_add(static_cast<quint64>(qMax<qint64>(nanoseconds, 0)), std::memory_order_relaxed);
+}
+
+Metrics::HistogramSnapshot Metrics::histogram(Histogram histogram) const
+{
+    const HistogramCell &cell = m_histograms[histogram];
+    HistogramSnapshot snapshot;
+    snapshot.count = 0;
+    for(int b=0; b<HISTOGRAM_BUCKETS; b++)
+    {
+        snapshot.buckets[b] = cell.buckets[b].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[b];
+    }
+    snapshot.sum = cell.sum.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void Metrics::HistogramSnapshot::clear()
+{
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum = 0;
+}
+
+void Metrics::HistogramSnapshot::add(qint64 nanoseconds)
+{
+    buckets[bucketIndex(nanoseconds)]++;
+    count++;
+    sum += static_cast<quint64>(qMax<qint64>(nanoseconds, 0));
+}
+
+qint64 Metrics::HistogramSnapshot::percentile(double fraction) const
+{
+    if(count == 0)
+        return 0;
+
+    // Nearest rank
+    quint64 rank = qMax<quint64>(1, static_cast<quint64>(std::ceil(fraction * count)));
+    quint64 cumulative = 0;
+    for(int b=0; b<HISTOGRAM_BUCKETS; b++)
+    {
+        cumulative += buckets[b];
+        if(cumulative >= rank)
+            return Q_INT64_C(1) << b;
+    }
+    return Q_INT64_C(1) << (HISTOGRAM_BUCKETS - 1);
+}
+
+const char *Metrics::name(Counter counter) { return COUNTER_INFO[counter].name; }
+const char *Metrics::name(Gauge gauge) { return GAUGE_INFO[gauge].name; }
+const char *Metrics::name(Histogram histogram) { return HISTOGRAM_INFO[histogram].name; }
+const char *Metrics::description(Counter counter) { return COUNTER_INFO[counter].description; }
+const char *Metrics::description(Gauge gauge) { return GAUGE_INFO[gauge].description; }
+const char *Metrics::description(Histogram histogram) { return HISTOGRAM_INFO[histogram].description; }
+
+static void appendHeader(QByteArray &out, const char *name, const char *description, const char *type)
+{
+    out.append("# HELP ").append(name).append(' ').append(description).append('\n');
+    out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+
+QByteArray Metrics::toPrometheus() const
+{
+    QByteArray out;
+    out.reserve(8 * 1024);
+
+    for(int i=0; i<COUNTER_COUNT; i++)
+    {
+        Counter c = static_cast<Counter>(i);
+        appendHeader(out, name(c), description(c), "counter");
+        out.append(name(c)).append(' ').append(QByteArray::number(counter(c))).append('\n');
+    }
+
+    for(int i=0; i<GAUGE_COUNT; i++)
+    {
+        Gauge g = static_cast<Gauge>(i);
+        appendHeader(out, name(g), description(g), "gauge");
+        out.append(name(g)).append(' ').append(QByteArray::number(gauge(g))).append('\n');
+    }
+
+    for(int i=0; i<HISTOGRAM_COUNT; i++)
+    {
+        Histogram h = static_cast<Histogram>(i);
+        HistogramSnapshot snapshot = histogram(h);
+        appendHeader(out, name(h), description(h), "histogram");
+
+        quint64 cumulative = 0;
+        for(int b=0; b<HISTOGRAM_BUCKETS - 1; b++)
+        {
+            cumulative += snapshot.buckets[b];
+            double le = static_cast<double>(Q_INT64_C(1) << b) / 1e9;
+            out.append(name(h)).append("_bucket{le=\"").append(QByteArray::number(le, 'g', 6))
+                    .append("\"} ").append(QByteArray::number(cumulative)).append('\n');
+        }
+        out.append(name(h)).append("_bucket{le=\"+Inf\"} ").append(QByteArray::number(snapshot.count)).append('\n');
+        out.append(name(h)).append("_sum ").append(QByteArray::number(snapshot.sum / 1e9, 'g', 12)).append('\n');
+        out.append(name(h)).append("_count ").append(QByteArray::number(snapshot.count)).append('\n');
+    }
+
+    return out;
+}
@@ -0,0 +1,159 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <atomic>
+
+// Lock free counters, gauges and latency histograms for each pipeline stage
+// Updates are relaxed atomics on their own cache lines, so any thread can
+// record without contention. Readers take snapshots for the stats panel and
+// the Prometheus exporter.
+class Metrics
+{
+public:
+    enum Counter {
+        RX_SYSCALLS,
+        RX_DATAGRAMS,
+        RX_BYTES,
+        RX_MESSAGES,
+        RX_PARSE_ERRORS,
+        RX_FILTERED,
+        RX_QUEUE_DROPS,
+        MTC_QUARTER_FRAMES,
+        MTC_FULL_FRAMES,
+        MTC_DISCONTINUITIES,
+        CLOCK_TICKS,
+        LOG_BYTES,
+        LOG_DROPPED_BYTES,
+        RECORD_MESSAGES,
+        RECORD_DROPS,
+        OUTPUT_MESSAGES,
+        OUTPUT_ERRORS,
+        OUTPUT_QUEUE_DROPS,
+        TX_SENDS,
+        TX_BYTES,
+        TX_ERRORS,
+        TX_SCHEDULE_DROPS,
+        INPUT_MESSAGES,
+        INPUT_ERRORS,
+        RELAY_DATAGRAMS,
+        RELAY_ERRORS,
+        RX_KERNEL_DROPS,
+        COUNTER_COUNT
+    };
+
+    enum Gauge {
+        RX_QUEUE_DEPTH,
+        LOG_QUEUE_BYTES,
+        TX_SCHEDULE_PENDING,
+        OUTPUT_QUEUE_DEPTH,
+        RX_SOCKET_BUFFER_BYTES,
+        GAUGE_COUNT
+    };
+
+    enum Histogram {
+        RX_PROCESSING_TIME,
+        OUTPUT_DISPATCH_LATENCY,
+        OUTPUT_RX_LATENCY,
+        OUTPUT_TX_LATENCY,
+        MTC_QUARTER_FRAME_JITTER,
+        MTC_SEND_JITTER,
+        CLOCK_TICK_JITTER,
+        CLOCK_SEND_JITTER,
+        TX_SCHEDULE_LATENESS,
+        INPUT_TO_WIRE_LATENCY,
+        RELAY_LATENCY,
+        RX_WAKEUP_LATENCY,
+        RX_SPIN_LATENCY,
+        HISTOGRAM_COUNT
+    };
+
+    // Bucket i holds values below 2^i nanoseconds, the last one everything above
+    static const int HISTOGRAM_BUCKETS = 36;
+
+    struct HistogramSnapshot
+    {
+        quint64 buckets[HISTOGRAM_BUCKETS];
+        quint64 count;
+        quint64 sum;
+
+        // For histograms kept privately by one thread
+        void clear();
+        void add(qint64 nanoseconds);
+
+        // Upper bound in nanoseconds of the bucket holding the given fraction
+        qint64 percentile(double fraction) const;
+    };
+
+    Metrics();
+
+    void add(Counter counter, quint64 count = 1)
+    {
+        m_counters[counter].value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void setGauge(Gauge gauge, qint64 value)
+    {
+        m_gauges[gauge].value.store(value, std::memory_order_relaxed);
+    }
+
+    void record(Histogram histogram, qint64 nanoseconds);
+
+    quint64 counter(Counter counter) const { return m_counters[counter].value.load(std::memory_order_relaxed); }
+    qint64 gauge(Gauge gauge) const { return m_gauges[gauge].value.load(std::memory_order_relaxed); }
+    HistogramSnapshot histogram(Histogram histogram) const;
+
+    static const char *name(Counter counter);
+    static const char *name(Gauge gauge);
+    static const char *name(Histogram histogram);
+    static const char *description(Counter counter);
+    static const char *description(Gauge gauge);
+    static const char *description(Histogram histogram);
+
+    // Prometheus text exposition format, version 0.0.4
+    QByteArray toPrometheus() const;
+
+private:
+    struct alignas(64) CounterCell
+    {
+        std::atomic<quint64> value;
+    };
+    struct alignas(64) GaugeCell
+    {
+        std::atomic<qint64> value;
+    };
+    struct alignas(64) HistogramCell
+    {
+        std::atomic<quint64> buckets[HISTOGRAM_BUCKETS];
+        std::atomic<quint64> sum;
+    };
+
+    CounterCell m_counters[COUNTER_COUNT];
+    GaugeCell m_gauges[GAUGE_COUNT];
+    HistogramCell m_histograms[HISTOGRAM_COUNT];
+
+    Q_DISABLE_COPY(Metrics)
+};
+
+#endif // METRICS_H
@@ -0,0 +1,119 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "metricsserver.h"
+#include "metrics.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+// Requests are tiny, anything larger is not a scrape
+static const int MAX_REQUEST_SIZE = 8 * 1024;
+
+MetricsServer::MetricsServer(const Metrics *metrics, QObject *parent) :
+    QObject(parent),
+    m_metrics(metrics)
+{
+}
+
+bool MetricsServer::listenTcp(quint16 port)
+{
+    if(!m_tcpServer)
+    {
+        m_tcpServer = new QTcpServer(this);
+        connect(m_tcpServer, SIGNAL(newConnection()), this, SLOT(newTcpConnection()));
+    }
+
+    if(!m_tcpServer->listen(QHostAddress::LocalHost, port))
+    {
+        m_errorString = m_tcpServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MetricsServer::listenLocal(const QString &path)
+{
+    if(!m_localServer)
+    {
+        m_localServer = new QLocalServer(this);
+        connect(m_localServer, SIGNAL(newConnection()), this, SLOT(newLocalConnection()));
+    }
+
+    QLocalServer::removeServer(path);
+    if(!m_localServer->listen(path))
+    {
+        m_errorString = m_localServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::newTcpConnection()
+{
+    while(QTcpSocket *connection = m_tcpServer->nextPendingConnection())
+    {
+        connect(connection, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(connection, SIGNAL(disconnected()), connection, SLOT(deleteLater()));
+    }
+}
+
+void MetricsServer::newLocalConnection()
+{
+    while(QLocalSocket *connection = m_localServer->nextPendingConnection())
+    {
+        connect(connection, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(connection, SIGNAL(disconnected()), connection, SLOT(deleteLater()));
+    }
+}
+
+void MetricsServer::readRequest()
+{
+    QIODevice *connection = qobject_cast<QIODevice *>(sender());
+    if(!connection)
+        return;
+
+    // Wait for the end of the request headers, the request itself is not inspected
+    QByteArray request = connection->peek(MAX_REQUEST_SIZE);
+    if(!request.contains("\r\n\r\n") && !request.contains("\n\n") && request.size() < MAX_REQUEST_SIZE)
+        return;
+
+    connection->readAll();
+    serve(connection);
+}
+
+void MetricsServer::serve(QIODevice *connection)
+{
+    QByteArray body = m_metrics->toPrometheus();
+    QByteArray response("HTTP/1.1 200 OK\r\n"
+                        "Content-Type: text/plain; version=0.0.4\r\n"
+                        "Connection: close\r\n"
+                        "Content-Length: ");
+    response.append(QByteArray::number(body.size()));
+    response.append("\r\n\r\n");
+    response.append(body);
+    connection->write(response);
+
+    if(QTcpSocket *tcp = qobject_cast<QTcpSocket *>(connection))
+        tcp->disconnectFromHost();
+    else if(QLocalSocket *local = qobject_cast<QLocalSocket *>(connection))
+        local->disconnectFromServer();
+}
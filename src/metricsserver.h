@@ -0,0 +1,58 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+
+class QTcpServer;
+class QLocalServer;
+class QIODevice;
+class Metrics;
+
+// Serves Metrics in Prometheus text format over HTTP
+// Listens on a localhost TCP port, a local (Unix domain) socket, or both.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(const Metrics *metrics, QObject *parent = Q_NULLPTR);
+
+    bool listenTcp(quint16 port);
+    bool listenLocal(const QString &path);
+    QString errorString() const { return m_errorString; }
+
+private slots:
+    void newTcpConnection();
+    void newLocalConnection();
+    void readRequest();
+
+private:
+    void serve(QIODevice *connection);
+
+    const Metrics *m_metrics;
+    QTcpServer *m_tcpServer = Q_NULLPTR;
+    QLocalServer *m_localServer = Q_NULLPTR;
+    QString m_errorString;
+};
+
+#endif // METRICSSERVER_H
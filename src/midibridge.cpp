@@ -0,0 +1,76 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midibridge.h"
+#include "midiinput.h"
+#include "txscheduler.h"
+#include "metrics.h"
+#include "preciseclock.h"
+#include "udpmidi.h"
+#include "realtime.h"
+
+// How often the thread looks at the stop flag while the input is quiet
+static const int POLL_INTERVAL_MS = 50;
+
+MidiBridge::MidiBridge(MidiInput *input, TxScheduler *scheduler, Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_input(input),
+    m_scheduler(scheduler),
+    m_metrics(metrics),
+    m_source(TxScheduler::newSource()),
+    m_stop(false)
+{
+}
+
+MidiBridge::~MidiBridge()
+{
+    stop();
+    wait();
+    m_scheduler->releaseSource(m_source);
+    delete m_input;
+}
+
+void MidiBridge::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+}
+
+void MidiBridge::run()
+{
+    // Input to wire latency is the scheduler's, so the bridge shares its setup
+    QString refused;
+    if(!Realtime::apply(Realtime::ROLE_SCHEDULER, &refused))
+        emit error(refused);
+
+    quint8 msg[UdpMidi::MAX_MESSAGE_LENGTH];
+
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        const int length = m_input->read(msg, sizeof(msg), POLL_INTERVAL_MS);
+        const qint64 timestamp = PreciseClock::nowNs();
+        if(length == 0)
+            continue;
+
+        if(length > 0 && m_scheduler->forward(timestamp, msg, length, m_source))
+            m_metrics->add(Metrics::INPUT_MESSAGES);
+        else
+            m_metrics->add(Metrics::INPUT_ERRORS);
+    }
+}
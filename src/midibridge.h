@@ -0,0 +1,62 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIBRIDGE_H
+#define MIDIBRIDGE_H
+
+#include <QThread>
+#include <atomic>
+
+class MidiInput;
+class TxScheduler;
+class Metrics;
+
+// Forwards a local MIDI input to the gateway
+// Messages are read on this thread into a fixed buffer, timestamped and
+// handed straight to the transmit scheduler under their own source, whose
+// report then holds the input to wire latency of every message.
+class MidiBridge : public QThread
+{
+    Q_OBJECT
+
+public:
+    // Takes ownership of input
+    MidiBridge(MidiInput *input, TxScheduler *scheduler, Metrics *metrics, QObject *parent = Q_NULLPTR);
+    ~MidiBridge();
+
+    void stop();
+
+    quint32 source() const { return m_source; }
+
+signals:
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    MidiInput *m_input;
+    TxScheduler *m_scheduler;
+    Metrics *m_metrics;
+    const quint32 m_source;
+    std::atomic<bool> m_stop;
+};
+
+#endif // MIDIBRIDGE_H
@@ -0,0 +1,325 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midifile.h"
+#include "udpmidi.h"
+#include <QFile>
+#include <algorithm>
+
+// Microseconds per quarter note until a tempo event says otherwise
+static const qint64 DEFAULT_TEMPO = 500000;
+
+namespace
+{
+    // An event as read from a track, before merging and timing
+    struct RawEvent
+    {
+        qint64 tick;
+        int offset;         // Into the message buffer, or the tempo for tempo events
+        int length;         // 0 marks a tempo event
+    };
+
+    bool tickLess(const RawEvent &a, const RawEvent &b)
+    {
+        return a.tick < b.tick;
+    }
+
+    class Reader
+    {
+    public:
+        Reader(const quint8 *data, int length) : m_data(data), m_end(data + length), m_p(data) {}
+
+        bool atEnd() const { return m_p >= m_end; }
+        int remaining() const { return static_cast<int>(m_end - m_p); }
+        const quint8 *position() const { return m_p; }
+
+        bool byte(quint8 &value)
+        {
+            if(m_p >= m_end)
+                return false;
+            value = *m_p++;
+            return true;
+        }
+
+        bool peek(quint8 &value) const
+        {
+            if(m_p >= m_end)
+                return false;
+            value = *m_p;
+            return true;
+        }
+
+        bool bigEndian(int bytes, quint32 &value)
+        {
+            if(remaining() < bytes)
+                return false;
+            value = 0;
+            for(int i=0; i<bytes; i++)
+                value = (value << 8) | *m_p++;
+            return true;
+        }
+
+        // Variable length quantity, at most four bytes
+        bool vlq(quint32 &value)
+        {
+            value = 0;
+            for(int i=0; i<4; i++)
+            {
+                quint8 b;
+                if(!byte(b))
+                    return false;
+                value = (value << 7) | (b & 0x7F);
+                if(!(b & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        bool skip(quint32 bytes)
+        {
+            if(quint32(remaining()) < bytes)
+                return false;
+            m_p += bytes;
+            return true;
+        }
+
+    private:
+        const quint8 *m_data;
+        const quint8 *m_end;
+        const quint8 *m_p;
+    };
+}
+
+MidiFile::MidiFile()
+{
+}
+
+bool MidiFile::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    return parse(file.readAll(), error);
+}
+
+bool MidiFile::parse(const QByteArray &file, QString *error)
+{
+    m_events.clear();
+    m_data.clear();
+
+    Reader reader(reinterpret_cast<const quint8 *>(file.constData()), file.size());
+    quint32 chunkId, chunkLength, format, trackCount, division;
+    if(!reader.bigEndian(4, chunkId) || chunkId != 0x4D546864 // MThd
+            || !reader.bigEndian(4, chunkLength) || chunkLength < 6
+            || !reader.bigEndian(2, format) || !reader.bigEndian(2, trackCount) || !reader.bigEndian(2, division)
+            || !reader.skip(chunkLength - 6))
+    {
+        if(error)
+            *error = tr("Not a Standard MIDI File");
+        return false;
+    }
+    if(format > 2 || (division & 0x7FFF) == 0)
+    {
+        if(error)
+            *error = tr("Unsupported MIDI file format %1").arg(format);
+        return false;
+    }
+
+    QVector<RawEvent> raw;
+    qint64 trackStart = 0;
+    int tracksRead = 0;
+    while(tracksRead < int(trackCount) && !reader.atEnd())
+    {
+        if(!reader.bigEndian(4, chunkId) || !reader.bigEndian(4, chunkLength) || quint32(reader.remaining()) < chunkLength)
+        {
+            if(error)
+                *error = tr("Track %1 is truncated").arg(tracksRead + 1);
+            return false;
+        }
+        if(chunkId != 0x4D54726B) // MTrk, anything else is skipped
+        {
+            reader.skip(chunkLength);
+            continue;
+        }
+
+        Reader track(reader.position(), chunkLength);
+        reader.skip(chunkLength);
+        tracksRead++;
+
+        // Format 2 tracks are independent sequences, played one after another
+        qint64 tick = format == 2 ? trackStart : 0;
+        quint8 runningStatus = 0;
+        bool valid = true;
+        while(valid && !track.atEnd())
+        {
+            quint32 delta;
+            quint8 status;
+            valid = track.vlq(delta) && track.peek(status);
+            if(!valid)
+                break;
+            tick += delta;
+
+            if(status & 0x80)
+                track.byte(status);
+            else if(runningStatus)
+                status = runningStatus;
+            else
+            {
+                valid = false;
+                break;
+            }
+
+            RawEvent event;
+            event.tick = tick;
+            if(status == 0xFF)
+            {
+                quint8 type;
+                quint32 length;
+                valid = track.byte(type) && track.vlq(length) && quint32(track.remaining()) >= length;
+                if(!valid)
+                    break;
+                const quint8 *data = track.position();
+                track.skip(length);
+                runningStatus = 0;
+                if(type == 0x2F)
+                    break;
+                if(type == 0x51 && length == 3)
+                {
+                    event.offset = (data[0] << 16) | (data[1] << 8) | data[2];
+                    event.length = 0;
+                    raw.append(event);
+                }
+            }
+            else if(status == 0xF0 || status == 0xF7)
+            {
+                // F0 starts a SysEx, F7 escapes arbitrary bytes out as they are
+                quint32 length;
+                valid = track.vlq(length) && quint32(track.remaining()) >= length;
+                if(!valid)
+                    break;
+                runningStatus = 0;
+                int total = int(length) + (status == 0xF0 ? 1 : 0);
+                if(total > 0 && total <= UdpMidi::MAX_MESSAGE_LENGTH)
+                {
+                    event.offset = m_data.size();
+                    event.length = total;
+                    if(status == 0xF0)
+                        m_data.append(char(0xF0));
+                    m_data.append(reinterpret_cast<const char *>(track.position()), int(length));
+                    raw.append(event);
+                }
+                track.skip(length);
+            }
+            else if(status >= 0xF0)
+            {
+                // System common and realtime have no place in a file
+                valid = false;
+            }
+            else
+            {
+                runningStatus = status;
+                const int dataBytes = (status & 0xE0) == 0xC0 ? 1 : 2;
+                event.offset = m_data.size();
+                event.length = dataBytes + 1;
+                m_data.append(char(status));
+                for(int i=0; valid && i<dataBytes; i++)
+                {
+                    quint8 b;
+                    valid = track.byte(b) && !(b & 0x80);
+                    m_data.append(char(b));
+                }
+                if(valid)
+                    raw.append(event);
+            }
+        }
+
+        if(!valid)
+        {
+            if(error)
+                *error = tr("Track %1 is corrupt").arg(tracksRead);
+            return false;
+        }
+        trackStart = qMax(trackStart, tick);
+    }
+
+    // Stable, so simultaneous events keep their track and file order
+    std::stable_sort(raw.begin(), raw.end(), tickLess);
+
+    // Resolve the tempo map into absolute times
+    qint64 tempo = DEFAULT_TEMPO;
+    qint64 lastTick = 0;
+    qint64 lastTime = 0;
+    qint64 smpteNumerator = 0;
+    qint64 smpteDenominator = 1;
+    if(division & 0x8000)
+    {
+        // SMPTE division: frames per second and ticks per frame, tempo has no effect
+        const int fps = -static_cast<qint8>(division >> 8);
+        const qint64 ticksPerFrame = division & 0xFF;
+        if(fps <= 0 || ticksPerFrame == 0)
+        {
+            if(error)
+                *error = tr("Invalid SMPTE time division");
+            return false;
+        }
+        // Ticks take numerator / denominator nanoseconds, 29 meaning 29.97
+        smpteNumerator = fps == 29 ? Q_INT64_C(1001000000000) : Q_INT64_C(1000000000000);
+        smpteDenominator = (fps == 29 ? 30000 : fps * 1000) * ticksPerFrame;
+    }
+
+    m_events.reserve(raw.size());
+    for(int i=0; i<raw.count(); i++)
+    {
+        const RawEvent &event = raw[i];
+        qint64 time;
+        if(division & 0x8000)
+        {
+            time = (event.tick / smpteDenominator) * smpteNumerator
+                    + (event.tick % smpteDenominator) * smpteNumerator / smpteDenominator;
+        }
+        else
+        {
+            // Times are measured from the last tempo change so rounding never accumulates
+            time = lastTime + (event.tick - lastTick) * tempo * 1000 / qint64(division);
+        }
+
+        if(event.length == 0)
+        {
+            lastTime = time;
+            lastTick = event.tick;
+            tempo = event.offset;
+            continue;
+        }
+
+        Event out;
+        out.time = time;
+        out.offset = event.offset;
+        out.length = event.length;
+        m_events.append(out);
+    }
+
+    m_format = int(format);
+    m_trackCount = tracksRead;
+    return true;
+}
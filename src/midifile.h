@@ -0,0 +1,68 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIFILE_H
+#define MIDIFILE_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <QCoreApplication>
+
+// Standard MIDI File reader
+// The file is parsed once into a flat array of events sorted by time, with
+// every track merged and the tempo map already applied, so playback only
+// walks the array. Message bytes live in one shared buffer.
+class MidiFile
+{
+    Q_DECLARE_TR_FUNCTIONS(MidiFile)
+
+public:
+    struct Event
+    {
+        qint64 time;        // Nanoseconds from the start of the file
+        int offset;         // Into data()
+        int length;
+    };
+
+    MidiFile();
+
+    bool load(const QString &fileName, QString *error = Q_NULLPTR);
+    bool parse(const QByteArray &file, QString *error = Q_NULLPTR);
+
+    const QVector<Event> &events() const { return m_events; }
+    const quint8 *message(const Event &event) const
+    {
+        return reinterpret_cast<const quint8 *>(m_data.constData()) + event.offset;
+    }
+
+    int format() const { return m_format; }
+    int trackCount() const { return m_trackCount; }
+    qint64 duration() const { return m_events.isEmpty() ? 0 : m_events.last().time; }
+
+private:
+    QVector<Event> m_events;
+    QByteArray m_data;
+    int m_format = 0;
+    int m_trackCount = 0;
+};
+
+#endif // MIDIFILE_H
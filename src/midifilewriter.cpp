@@ -0,0 +1,175 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midifilewriter.h"
+
+static const int FLUSH_SIZE = 64 * 1024;
+
+// Largest delta time a variable length quantity can hold
+static const qint64 MAX_DELTA = 0x0FFFFFFF;
+
+static inline void appendBigEndian(QByteArray &out, quint32 value, int bytes)
+{
+    for(int shift=(bytes - 1) * 8; shift>=0; shift-=8)
+        out.append(char((value >> shift) & 0xFF));
+}
+
+MidiFileWriter::MidiFileWriter()
+{
+    m_buffer.reserve(FLUSH_SIZE + 64);
+}
+
+MidiFileWriter::~MidiFileWriter()
+{
+    close();
+}
+
+bool MidiFileWriter::open(const QString &fileName, int ticksPerQuarterNote, qint64 tempo)
+{
+    close();
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    m_buffer.resize(0);
+    m_buffer.append("MThd", 4);
+    appendBigEndian(m_buffer, 6, 4);
+    appendBigEndian(m_buffer, 0, 2);                        // Format 0
+    appendBigEndian(m_buffer, 1, 2);                        // One track
+    appendBigEndian(m_buffer, ticksPerQuarterNote & 0x7FFF, 2);
+    m_buffer.append("MTrk", 4);
+    m_trackLengthPosition = m_buffer.size();
+    appendBigEndian(m_buffer, 0, 4);                        // Patched by close()
+
+    const int trackStart = m_buffer.size();
+    m_buffer.append(char(0x00));
+    m_buffer.append(char(0xFF));
+    m_buffer.append(char(0x51));
+    m_buffer.append(char(0x03));
+    appendBigEndian(m_buffer, static_cast<quint32>(tempo), 3);
+    m_trackBytes = m_buffer.size() - trackStart;
+
+    m_lastTick = 0;
+    m_runningStatus = 0;
+    return flush();
+}
+
+void MidiFileWriter::appendVlq(quint32 value)
+{
+    char bytes[4];
+    int count = 0;
+    do
+    {
+        bytes[count++] = char(value & 0x7F);
+        value >>= 7;
+    } while(value);
+    while(count > 1)
+        m_buffer.append(char(bytes[--count] | 0x80));
+    m_buffer.append(bytes[0]);
+}
+
+void MidiFileWriter::appendDelta(qint64 tick)
+{
+    qint64 delta = qMax<qint64>(0, tick - m_lastTick);
+    // Gaps too long for one delta are bridged with empty text events
+    while(delta > MAX_DELTA)
+    {
+        appendVlq(static_cast<quint32>(MAX_DELTA));
+        m_buffer.append(char(0xFF));
+        m_buffer.append(char(0x01));
+        m_buffer.append(char(0x00));
+        m_runningStatus = 0;
+        delta -= MAX_DELTA;
+    }
+    appendVlq(static_cast<quint32>(delta));
+    m_lastTick = qMax(m_lastTick, tick);
+}
+
+bool MidiFileWriter::write(qint64 tick, const quint8 *msg, int length)
+{
+    if(!m_file.isOpen() || length <= 0)
+        return false;
+
+    const int start = m_buffer.size();
+    appendDelta(tick);
+
+    const quint8 status = msg[0];
+    const int expected = (status & 0xE0) == 0xC0 ? 2 : 3;
+    bool complete = status >= 0x80 && status < 0xF0 && length == expected;
+    for(int i=1; complete && i<length; i++)
+        complete = !(msg[i] & 0x80);
+
+    if(complete)
+    {
+        if(status != m_runningStatus)
+            m_buffer.append(char(status));
+        m_buffer.append(reinterpret_cast<const char *>(msg + 1), length - 1);
+        m_runningStatus = status;
+    }
+    else if(status == 0xF0)
+    {
+        m_buffer.append(char(0xF0));
+        appendVlq(static_cast<quint32>(length - 1));
+        m_buffer.append(reinterpret_cast<const char *>(msg + 1), length - 1);
+        m_runningStatus = 0;
+    }
+    else
+    {
+        // System common, realtime and anything malformed go out as received
+        m_buffer.append(char(0xF7));
+        appendVlq(static_cast<quint32>(length));
+        m_buffer.append(reinterpret_cast<const char *>(msg), length);
+        m_runningStatus = 0;
+    }
+
+    m_trackBytes += m_buffer.size() - start;
+    if(m_buffer.size() >= FLUSH_SIZE)
+        return flush();
+    return true;
+}
+
+bool MidiFileWriter::flush()
+{
+    if(m_buffer.isEmpty())
+        return true;
+    bool ok = m_file.write(m_buffer) == m_buffer.size();
+    m_buffer.resize(0);
+    return ok;
+}
+
+bool MidiFileWriter::close()
+{
+    if(!m_file.isOpen())
+        return true;
+
+    // End of track
+    m_buffer.append(char(0x00));
+    m_buffer.append(char(0xFF));
+    m_buffer.append(char(0x2F));
+    m_buffer.append(char(0x00));
+    m_trackBytes += 4;
+    bool ok = flush();
+
+    QByteArray length;
+    appendBigEndian(length, static_cast<quint32>(m_trackBytes), 4);
+    ok = ok && m_file.seek(m_trackLengthPosition) && m_file.write(length) == length.size();
+    m_file.close();
+    return ok;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIFILEWRITER_H
+#define MIDIFILEWRITER_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QFile>
+#include <QCoreApplication>
+
+// Streaming Standard MIDI File writer
+// Writes a format 0 file event by event through a small buffer, leaving the
+// track length as a placeholder that close() patches, so a capture of any
+// length never has to be held in memory. Messages that cannot be stored as
+// channel or SysEx events are written as F7 escapes, exactly as received.
+class MidiFileWriter
+{
+    Q_DECLARE_TR_FUNCTIONS(MidiFileWriter)
+
+public:
+    MidiFileWriter();
+    ~MidiFileWriter();
+
+    // tempo in microseconds per quarter note, written as the first event
+    bool open(const QString &fileName, int ticksPerQuarterNote, qint64 tempo);
+
+    // Ticks must not go backwards
+    bool write(qint64 tick, const quint8 *msg, int length);
+
+    // Ends the track and patches its length
+    bool close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    void appendDelta(qint64 tick);
+    void appendVlq(quint32 value);
+    bool flush();
+
+    QFile m_file;
+    QByteArray m_buffer;
+    qint64 m_trackLengthPosition = 0;
+    qint64 m_trackBytes = 0;
+    qint64 m_lastTick = 0;
+    quint8 m_runningStatus = 0;
+};
+
+#endif // MIDIFILEWRITER_H
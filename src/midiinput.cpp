@@ -0,0 +1,53 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midiinput.h"
+
+#if defined(Q_OS_WIN)
+#include "midiinputwinmm.h"
+#elif defined(Q_OS_LINUX)
+#include "midiinputalsa.h"
+#endif
+
+QList<MidiInput::Source> MidiInput::sources()
+{
+#if defined(Q_OS_WIN)
+    return WinMmMidiInput::sources();
+#elif defined(Q_OS_LINUX)
+    return AlsaMidiInput::sources();
+#else
+    return QList<Source>();
+#endif
+}
+
+MidiInput *MidiInput::open(const Source &source, QString *error)
+{
+#if defined(Q_OS_WIN)
+    if(source.backend == WinMmMidiInput::BACKEND)
+        return WinMmMidiInput::open(source.id, error);
+#elif defined(Q_OS_LINUX)
+    if(source.backend == AlsaMidiInput::BACKEND)
+        return AlsaMidiInput::open(source.id, error);
+#endif
+
+    if(error)
+        *error = tr("MIDI input backend \"%1\" is not available").arg(source.backend);
+    return Q_NULLPTR;
+}
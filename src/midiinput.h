@@ -0,0 +1,55 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIINPUT_H
+#define MIDIINPUT_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+#include <QCoreApplication>
+
+// Local MIDI input, the counterpart of MidiOutput
+// Each platform API is one backend. An input is read from one thread, which
+// blocks in read() until a message arrives; nothing is allocated per message.
+class MidiInput
+{
+    Q_DECLARE_TR_FUNCTIONS(MidiInput)
+
+public:
+    struct Source
+    {
+        QString backend;
+        QString name;
+        int id;             // Backend specific, e.g. device index or client:port
+    };
+
+    virtual ~MidiInput() {}
+
+    // Waits up to timeoutMs for the next complete message and copies it to
+    // buffer. Returns its length, 0 on timeout or for events that are not
+    // MIDI, or -1 if a message was lost or did not fit.
+    virtual int read(quint8 *buffer, int capacity, int timeoutMs) = 0;
+
+    static QList<Source> sources();
+    static MidiInput *open(const Source &source, QString *error = Q_NULLPTR);
+};
+
+#endif // MIDIINPUT_H
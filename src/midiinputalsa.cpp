@@ -0,0 +1,150 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midiinputalsa.h"
+#include "udpmidi.h"
+#include <cerrno>
+
+const char *AlsaMidiInput::BACKEND = "alsa";
+
+static const char *CLIENT_NAME = "UdpMidiTest";
+static const unsigned int READ_CAPS = SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ;
+
+AlsaMidiInput::AlsaMidiInput(snd_seq_t *seq, snd_midi_event_t *decoder)
+    : m_seq(seq)
+    , m_decoder(decoder)
+{
+    m_pollCount = snd_seq_poll_descriptors(m_seq, m_pollFds, MAX_POLL_DESCRIPTORS, POLLIN);
+}
+
+AlsaMidiInput::~AlsaMidiInput()
+{
+    snd_midi_event_free(m_decoder);
+    snd_seq_close(m_seq);
+}
+
+QList<MidiInput::Source> AlsaMidiInput::sources()
+{
+    QList<Source> result;
+
+    Source virtualPort;
+    virtualPort.backend = BACKEND;
+    virtualPort.name = tr("Virtual Port");
+    virtualPort.id = VIRTUAL_PORT;
+    result << virtualPort;
+
+    snd_seq_t *seq;
+    if(snd_seq_open(&seq, "default", SND_SEQ_OPEN_INPUT, 0) < 0)
+        return result;
+
+    snd_seq_client_info_t *client;
+    snd_seq_port_info_t *port;
+    snd_seq_client_info_alloca(&client);
+    snd_seq_port_info_alloca(&port);
+    int self = snd_seq_client_id(seq);
+
+    snd_seq_client_info_set_client(client, -1);
+    while(snd_seq_query_next_client(seq, client) >= 0)
+    {
+        int clientId = snd_seq_client_info_get_client(client);
+        if(clientId == self || clientId == SND_SEQ_CLIENT_SYSTEM)
+            continue;
+        snd_seq_port_info_set_client(port, clientId);
+        snd_seq_port_info_set_port(port, -1);
+        while(snd_seq_query_next_port(seq, port) >= 0)
+        {
+            if((snd_seq_port_info_get_capability(port) & READ_CAPS) != READ_CAPS)
+                continue;
+            if(snd_seq_port_info_get_capability(port) & SND_SEQ_PORT_CAP_NO_EXPORT)
+                continue;
+            int portId = snd_seq_port_info_get_port(port);
+            Source s;
+            s.backend = BACKEND;
+            s.name = QString("%1:%2 %3")
+                    .arg(clientId)
+                    .arg(portId)
+                    .arg(QString::fromLocal8Bit(snd_seq_port_info_get_name(port)));
+            s.id = (clientId << 8) | portId;
+            result << s;
+        }
+    }
+
+    snd_seq_close(seq);
+    return result;
+}
+
+AlsaMidiInput *AlsaMidiInput::open(int source, QString *error)
+{
+    snd_seq_t *seq;
+    int err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+    if(err < 0)
+    {
+        if(error)
+            *error = tr("Unable to open ALSA sequencer: %1").arg(snd_strerror(err));
+        return Q_NULLPTR;
+    }
+    snd_seq_set_client_name(seq, CLIENT_NAME);
+
+    int port = snd_seq_create_simple_port(seq, "Input",
+            SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+            SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    err = port;
+    if(port >= 0 && source != VIRTUAL_PORT)
+        err = snd_seq_connect_from(seq, port, source >> 8, source & 0xFF);
+
+    snd_midi_event_t *decoder = Q_NULLPTR;
+    if(err >= 0)
+        err = snd_midi_event_new(UdpMidi::MAX_MESSAGE_LENGTH, &decoder);
+    if(err < 0)
+    {
+        if(error)
+            *error = tr("Unable to connect from ALSA port %1:%2: %3")
+                    .arg(source >> 8)
+                    .arg(source & 0xFF)
+                    .arg(snd_strerror(err));
+        snd_seq_close(seq);
+        return Q_NULLPTR;
+    }
+    // Every message goes out in its own datagram, so each needs its status byte
+    snd_midi_event_no_status(decoder, 1);
+
+    return new AlsaMidiInput(seq, decoder);
+}
+
+int AlsaMidiInput::read(quint8 *buffer, int capacity, int timeoutMs)
+{
+    if(snd_seq_event_input_pending(m_seq, 1) == 0)
+    {
+        if(poll(m_pollFds, static_cast<nfds_t>(m_pollCount), timeoutMs) <= 0)
+            return 0;
+    }
+
+    snd_seq_event_t *ev;
+    int err = snd_seq_event_input(m_seq, &ev);
+    if(err == -EAGAIN)
+        return 0;
+    if(err < 0)
+        return -1;      // -ENOSPC, the sequencer's buffer overran
+
+    long length = snd_midi_event_decode(m_decoder, buffer, capacity, ev);
+    if(length == -ENOMEM)
+        return -1;
+    return length > 0 ? static_cast<int>(length) : 0;
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIINPUTALSA_H
+#define MIDIINPUTALSA_H
+
+#include "midiinput.h"
+#include <alsa/asoundlib.h>
+#include <poll.h>
+
+// ALSA sequencer input
+// Opens a client with one destination port, either subscribed to the source
+// port (client << 8) | port or, for VIRTUAL_PORT, left for other clients to
+// connect to with aconnect. Events are decoded back to MIDI bytes straight
+// from the sequencer's own buffer.
+class AlsaMidiInput : public MidiInput
+{
+public:
+    static const char *BACKEND;
+    static const int VIRTUAL_PORT = -1;
+
+    ~AlsaMidiInput();
+
+    static QList<Source> sources();
+    static AlsaMidiInput *open(int source, QString *error);
+
+    int read(quint8 *buffer, int capacity, int timeoutMs) Q_DECL_OVERRIDE;
+
+private:
+    static const int MAX_POLL_DESCRIPTORS = 4;
+
+    AlsaMidiInput(snd_seq_t *seq, snd_midi_event_t *decoder);
+
+    snd_seq_t *m_seq;
+    snd_midi_event_t *m_decoder;
+    struct pollfd m_pollFds[MAX_POLL_DESCRIPTORS];
+    int m_pollCount;
+};
+
+#endif // MIDIINPUTALSA_H
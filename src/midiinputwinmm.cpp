@@ -0,0 +1,113 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midiinputwinmm.h"
+#include "midistatus.h"
+
+const char *WinMmMidiInput::BACKEND = "winmm";
+
+WinMmMidiInput::WinMmMidiInput()
+    : m_handle(Q_NULLPTR)
+    , m_event(CreateEvent(Q_NULLPTR, FALSE, FALSE, Q_NULLPTR))
+    , m_queue(QUEUE_CAPACITY)
+    , m_overflow(false)
+{
+}
+
+WinMmMidiInput::~WinMmMidiInput()
+{
+    if(m_handle)
+    {
+        midiInStop(m_handle);
+        midiInReset(m_handle);
+        midiInClose(m_handle);
+    }
+    CloseHandle(m_event);
+}
+
+QList<MidiInput::Source> WinMmMidiInput::sources()
+{
+    QList<Source> result;
+    UINT nDevs = midiInGetNumDevs();
+    for(UINT i=0; i<nDevs; i++)
+    {
+        MIDIINCAPS capabilities;
+        if(midiInGetDevCaps(i, &capabilities, sizeof(MIDIINCAPS)) != MMSYSERR_NOERROR)
+            continue;
+        Source s;
+        s.backend = BACKEND;
+        s.name = QString::fromWCharArray(capabilities.szPname);
+        s.id = static_cast<int>(i);
+        result << s;
+    }
+    return result;
+}
+
+WinMmMidiInput *WinMmMidiInput::open(int device, QString *error)
+{
+    WinMmMidiInput *input = new WinMmMidiInput;
+    MMRESULT result = midiInOpen(&input->m_handle, static_cast<UINT>(device),
+                                 reinterpret_cast<DWORD_PTR>(&WinMmMidiInput::callback),
+                                 reinterpret_cast<DWORD_PTR>(input), CALLBACK_FUNCTION);
+    if(result == MMSYSERR_NOERROR)
+        result = midiInStart(input->m_handle);
+    if(result != MMSYSERR_NOERROR)
+    {
+        if(error)
+            *error = tr("Unable to open MIDI input device %1 (error %2)").arg(device).arg(result);
+        delete input;
+        return Q_NULLPTR;
+    }
+    return input;
+}
+
+void CALLBACK WinMmMidiInput::callback(HMIDIIN, UINT message, DWORD_PTR instance, DWORD_PTR param1, DWORD_PTR)
+{
+    if(message != MIM_DATA)
+        return;
+
+    // Only the driver's thread pushes
+    WinMmMidiInput *input = reinterpret_cast<WinMmMidiInput *>(instance);
+    if(!input->m_queue.push(static_cast<quint32>(param1)))
+        input->m_overflow.store(true, std::memory_order_relaxed);
+    SetEvent(input->m_event);
+}
+
+int WinMmMidiInput::read(quint8 *buffer, int capacity, int timeoutMs)
+{
+    if(m_overflow.exchange(false, std::memory_order_relaxed))
+        return -1;
+
+    quint32 packedMsg;
+    if(!m_queue.pop(packedMsg))
+    {
+        WaitForSingleObject(m_event, static_cast<DWORD>(timeoutMs));
+        if(!m_queue.pop(packedMsg))
+            return 0;
+    }
+
+    const quint8 status = static_cast<quint8>(packedMsg);
+    const int length = 1 + MidiStatus::dataLength(status);
+    if(length > capacity)
+        return -1;
+    for(int i=0; i<length; i++)
+        buffer[i] = static_cast<quint8>(packedMsg >> (8 * i));
+    return length;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIINPUTWINMM_H
+#define MIDIINPUTWINMM_H
+
+#include "midiinput.h"
+#include "spscqueue.h"
+#include <windows.h>
+#include <atomic>
+
+// Windows multimedia MIDI input
+// The driver calls back on its own thread with packed short messages, which
+// are queued for read(). SysEx would need buffers handed to the driver and is
+// not bridged.
+class WinMmMidiInput : public MidiInput
+{
+public:
+    static const char *BACKEND;
+    static const int QUEUE_CAPACITY = 4096;
+
+    ~WinMmMidiInput();
+
+    static QList<Source> sources();
+    static WinMmMidiInput *open(int device, QString *error);
+
+    int read(quint8 *buffer, int capacity, int timeoutMs) Q_DECL_OVERRIDE;
+
+private:
+    WinMmMidiInput();
+
+    static void CALLBACK callback(HMIDIIN handle, UINT message, DWORD_PTR instance,
+                                  DWORD_PTR param1, DWORD_PTR param2);
+
+    HMIDIIN m_handle;
+    HANDLE m_event;
+    SpscQueue<quint32> m_queue;
+    std::atomic<bool> m_overflow;
+};
+
+#endif // MIDIINPUTWINMM_H
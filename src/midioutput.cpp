@@ -0,0 +1,69 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midioutput.h"
+
+#if defined(Q_OS_WIN)
+#include "midioutputwinmm.h"
+#elif defined(Q_OS_LINUX)
+#include "midioutputalsa.h"
+#endif
+
+static const char *BACKEND_NULL = "null";
+static const char *BACKEND_COUNTING = "counting";
+
+QList<MidiOutput::Destination> MidiOutput::destinations()
+{
+    QList<Destination> result;
+#if defined(Q_OS_WIN)
+    result << WinMmMidiOutput::destinations();
+#elif defined(Q_OS_LINUX)
+    result << AlsaMidiOutput::destinations();
+#endif
+
+    Destination sink;
+    sink.id = 0;
+    sink.backend = BACKEND_NULL;
+    sink.name = tr("Null Sink");
+    result << sink;
+    sink.backend = BACKEND_COUNTING;
+    sink.name = tr("Counting Sink");
+    result << sink;
+    return result;
+}
+
+MidiOutput *MidiOutput::open(const Destination &destination, QString *error)
+{
+    if(destination.backend == BACKEND_NULL)
+        return new NullMidiOutput;
+    if(destination.backend == BACKEND_COUNTING)
+        return new CountingMidiOutput;
+#if defined(Q_OS_WIN)
+    if(destination.backend == WinMmMidiOutput::BACKEND)
+        return WinMmMidiOutput::open(destination.id, error);
+#elif defined(Q_OS_LINUX)
+    if(destination.backend == AlsaMidiOutput::BACKEND)
+        return AlsaMidiOutput::open(destination.id, error);
+#endif
+
+    if(error)
+        *error = tr("MIDI output backend \"%1\" is not available").arg(destination.backend);
+    return Q_NULLPTR;
+}
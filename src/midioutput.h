@@ -0,0 +1,95 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIOUTPUT_H
+#define MIDIOUTPUT_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+#include <QCoreApplication>
+#include <atomic>
+
+// Destination for local MIDI playback
+// Each platform API is one backend behind this interface, alongside a null
+// sink and a counting sink for measuring everything up to the synth.
+// Backends are used from one thread at a time.
+class MidiOutput
+{
+    Q_DECLARE_TR_FUNCTIONS(MidiOutput)
+
+public:
+    // What one send() costs, so callers know whether it may hold them up
+    enum DispatchCost {
+        COST_NONE,          // Returns at once, nothing leaves the process
+        COST_SYSCALL,       // One system call into a sequencer
+        COST_DRIVER         // A call into a device driver, which may block
+    };
+
+    struct Destination
+    {
+        QString backend;
+        QString name;
+        int id;             // Backend specific, e.g. device index or client:port
+    };
+
+    virtual ~MidiOutput() {}
+
+    virtual DispatchCost dispatchCost() const = 0;
+
+    // Short messages of up to three bytes; SysEx is not played locally
+    virtual bool send(const quint8 *msg, int length) = 0;
+
+    // Every destination the backends built in offer, null and counting sinks last
+    static QList<Destination> destinations();
+    static MidiOutput *open(const Destination &destination, QString *error = Q_NULLPTR);
+};
+
+// Discards everything
+class NullMidiOutput : public MidiOutput
+{
+public:
+    DispatchCost dispatchCost() const Q_DECL_OVERRIDE { return COST_NONE; }
+    bool send(const quint8 *, int) Q_DECL_OVERRIDE { return true; }
+};
+
+// Discards everything but counts it, readable from any thread
+class CountingMidiOutput : public MidiOutput
+{
+public:
+    CountingMidiOutput() : m_messages(0), m_bytes(0) {}
+
+    DispatchCost dispatchCost() const Q_DECL_OVERRIDE { return COST_NONE; }
+    bool send(const quint8 *, int length) Q_DECL_OVERRIDE
+    {
+        m_messages.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(static_cast<quint64>(length), std::memory_order_relaxed);
+        return true;
+    }
+
+    quint64 messages() const { return m_messages.load(std::memory_order_relaxed); }
+    quint64 bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_messages;
+    std::atomic<quint64> m_bytes;
+};
+
+#endif // MIDIOUTPUT_H
@@ -0,0 +1,134 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midioutputalsa.h"
+
+const char *AlsaMidiOutput::BACKEND = "alsa";
+
+static const char *CLIENT_NAME = "UdpMidiTest";
+static const unsigned int WRITE_CAPS = SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE;
+
+AlsaMidiOutput::AlsaMidiOutput(snd_seq_t *seq, int port, snd_midi_event_t *encoder)
+    : m_seq(seq)
+    , m_port(port)
+    , m_encoder(encoder)
+{
+}
+
+AlsaMidiOutput::~AlsaMidiOutput()
+{
+    snd_midi_event_free(m_encoder);
+    snd_seq_close(m_seq);
+}
+
+QList<MidiOutput::Destination> AlsaMidiOutput::destinations()
+{
+    QList<Destination> result;
+    snd_seq_t *seq;
+    if(snd_seq_open(&seq, "default", SND_SEQ_OPEN_OUTPUT, 0) < 0)
+        return result;
+
+    snd_seq_client_info_t *client;
+    snd_seq_port_info_t *port;
+    snd_seq_client_info_alloca(&client);
+    snd_seq_port_info_alloca(&port);
+    int self = snd_seq_client_id(seq);
+
+    snd_seq_client_info_set_client(client, -1);
+    while(snd_seq_query_next_client(seq, client) >= 0)
+    {
+        int clientId = snd_seq_client_info_get_client(client);
+        if(clientId == self || clientId == SND_SEQ_CLIENT_SYSTEM)
+            continue;
+        snd_seq_port_info_set_client(port, clientId);
+        snd_seq_port_info_set_port(port, -1);
+        while(snd_seq_query_next_port(seq, port) >= 0)
+        {
+            if((snd_seq_port_info_get_capability(port) & WRITE_CAPS) != WRITE_CAPS)
+                continue;
+            if(snd_seq_port_info_get_capability(port) & SND_SEQ_PORT_CAP_NO_EXPORT)
+                continue;
+            int portId = snd_seq_port_info_get_port(port);
+            Destination d;
+            d.backend = BACKEND;
+            d.name = QString("%1:%2 %3")
+                    .arg(clientId)
+                    .arg(portId)
+                    .arg(QString::fromLocal8Bit(snd_seq_port_info_get_name(port)));
+            d.id = (clientId << 8) | portId;
+            result << d;
+        }
+    }
+
+    snd_seq_close(seq);
+    return result;
+}
+
+AlsaMidiOutput *AlsaMidiOutput::open(int destination, QString *error)
+{
+    snd_seq_t *seq;
+    int err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_OUTPUT, 0);
+    if(err < 0)
+    {
+        if(error)
+            *error = tr("Unable to open ALSA sequencer: %1").arg(snd_strerror(err));
+        return Q_NULLPTR;
+    }
+    snd_seq_set_client_name(seq, CLIENT_NAME);
+
+    int port = snd_seq_create_simple_port(seq, "Output",
+            SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+            SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    if(port >= 0)
+        err = snd_seq_connect_to(seq, port, destination >> 8, destination & 0xFF);
+    else
+        err = port;
+
+    snd_midi_event_t *encoder = Q_NULLPTR;
+    if(err >= 0)
+        err = snd_midi_event_new(3, &encoder);
+    if(err < 0)
+    {
+        if(error)
+            *error = tr("Unable to connect to ALSA port %1:%2: %3")
+                    .arg(destination >> 8)
+                    .arg(destination & 0xFF)
+                    .arg(snd_strerror(err));
+        snd_seq_close(seq);
+        return Q_NULLPTR;
+    }
+
+    return new AlsaMidiOutput(seq, port, encoder);
+}
+
+bool AlsaMidiOutput::send(const quint8 *msg, int length)
+{
+    snd_seq_event_t ev;
+    snd_seq_ev_clear(&ev);
+    snd_midi_event_reset_encode(m_encoder);
+    if(snd_midi_event_encode(m_encoder, msg, length, &ev) != length
+            || ev.type == SND_SEQ_EVENT_NONE)
+        return false;
+
+    snd_seq_ev_set_source(&ev, m_port);
+    snd_seq_ev_set_subs(&ev);
+    snd_seq_ev_set_direct(&ev);
+    return snd_seq_event_output_direct(m_seq, &ev) >= 0;
+}
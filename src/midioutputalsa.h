@@ -0,0 +1,53 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDIOUTPUTALSA_H
+#define MIDIOUTPUTALSA_H
+
+#include "midioutput.h"
+#include <alsa/asoundlib.h>
+
+// ALSA sequencer output
+// Opens a client with one source port subscribed to the destination port and
+// sends events direct, bypassing the sequencer queue. Destinations are
+// identified as (client << 8) | port, so snd-seq-dummy "Midi Through" shows up
+// as 14:0 just as aconnect would list it.
+class AlsaMidiOutput : public MidiOutput
+{
+public:
+    static const char *BACKEND;
+
+    ~AlsaMidiOutput();
+
+    static QList<Destination> destinations();
+    static AlsaMidiOutput *open(int destination, QString *error);
+
+    DispatchCost dispatchCost() const Q_DECL_OVERRIDE { return COST_SYSCALL; }
+    bool send(const quint8 *msg, int length) Q_DECL_OVERRIDE;
+
+private:
+    AlsaMidiOutput(snd_seq_t *seq, int port, snd_midi_event_t *encoder);
+
+    snd_seq_t *m_seq;
+    int m_port;
+    snd_midi_event_t *m_encoder;
+};
+
+#endif // MIDIOUTPUTALSA_H
@@ -0,0 +1,76 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midioutputwinmm.h"
+
+const char *WinMmMidiOutput::BACKEND = "winmm";
+
+WinMmMidiOutput::WinMmMidiOutput(HMIDIOUT handle)
+    : m_handle(handle)
+{
+}
+
+WinMmMidiOutput::~WinMmMidiOutput()
+{
+    midiOutReset(m_handle);
+    midiOutClose(m_handle);
+}
+
+QList<MidiOutput::Destination> WinMmMidiOutput::destinations()
+{
+    QList<Destination> result;
+    UINT nDevs = midiOutGetNumDevs();
+    for(UINT i=0; i<nDevs; i++)
+    {
+        MIDIOUTCAPS capabilities;
+        if(midiOutGetDevCaps(i, &capabilities, sizeof(MIDIOUTCAPS)) != MMSYSERR_NOERROR)
+            continue;
+        Destination d;
+        d.backend = BACKEND;
+        d.name = QString::fromWCharArray(capabilities.szPname);
+        d.id = static_cast<int>(i);
+        result << d;
+    }
+    return result;
+}
+
+WinMmMidiOutput *WinMmMidiOutput::open(int device, QString *error)
+{
+    HMIDIOUT handle;
+    MMRESULT result = midiOutOpen(&handle, static_cast<UINT>(device), 0, 0, CALLBACK_NULL);
+    if(result != MMSYSERR_NOERROR)
+    {
+        if(error)
+            *error = tr("Unable to open MIDI output device %1 (error %2)").arg(device).arg(result);
+        return Q_NULLPTR;
+    }
+    return new WinMmMidiOutput(handle);
+}
+
+bool WinMmMidiOutput::send(const quint8 *msg, int length)
+{
+    if(length < 1 || length > 3)
+        return false;
+
+    quint32 packedMsg = 0;
+    for(int i=0; i<length; i++)
+        packedMsg |= static_cast<quint32>(msg[i]) << (8 * i);
+    return midiOutShortMsg(m_handle, packedMsg) == MMSYSERR_NOERROR;
+}
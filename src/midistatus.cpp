@@ -0,0 +1,144 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midistatus.h"
+#include <cstring>
+
+namespace
+{
+    const char *const NOTE_NAMES[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+    class Writer
+    {
+    public:
+        Writer(char *out, int capacity) : m_p(out), m_end(out + capacity), m_start(out) {}
+
+        void text(const char *s)
+        {
+            while(*s && m_p < m_end)
+                *m_p++ = *s++;
+        }
+        void number(int value)
+        {
+            if(value < 0)
+            {
+                text("-");
+                value = -value;
+            }
+            char digits[12];
+            int count = 0;
+            do
+            {
+                digits[count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while(value);
+            while(count && m_p < m_end)
+                *m_p++ = digits[--count];
+        }
+        void field(const char *prefix, int value)
+        {
+            text(" ");
+            text(prefix);
+            number(value);
+        }
+        // Middle C, 60, is C4
+        void note(int value)
+        {
+            text(" ");
+            text(NOTE_NAMES[value % 12]);
+            number(value / 12 - 1);
+        }
+
+        int length() const { return static_cast<int>(m_p - m_start); }
+
+    private:
+        char *m_p;
+        char *m_end;
+        char *m_start;
+    };
+}
+
+int MidiStatus::disassemble(const quint8 *msg, int length, char *out, int capacity)
+{
+    Writer w(out, capacity);
+    if(length <= 0)
+        return 0;
+
+    const quint8 status = msg[0];
+    w.text(mnemonic(status));
+    if(kind(status) == KIND_SYSEX_START)
+    {
+        w.field("", length);
+        w.text(" bytes");
+        return w.length();
+    }
+    if(length < 1 + dataLength(status))
+    {
+        w.text(" (incomplete)");
+        return w.length();
+    }
+
+    if(kind(status) == KIND_CHANNEL)
+    {
+        w.field("ch", (status & 0x0F) + 1);
+        switch(status & 0xF0)
+        {
+        case 0x80:
+        case 0x90:
+            w.note(msg[1]);
+            w.field("v", msg[2]);
+            break;
+        case 0xA0:
+            w.note(msg[1]);
+            w.field("p", msg[2]);
+            break;
+        case 0xB0:
+            w.field("cc", msg[1]);
+            w.field("v", msg[2]);
+            break;
+        case 0xC0:
+        case 0xD0:
+            w.field("p", msg[1]);
+            break;
+        default:
+            // Centred on 0, -8192 to 8191
+            w.field("", (msg[1] | msg[2] << 7) - 8192);
+            break;
+        }
+        return w.length();
+    }
+
+    switch(status)
+    {
+    case 0xF1:
+        w.field("piece ", msg[1] >> 4);
+        w.field("value ", msg[1] & 0x0F);
+        break;
+    case 0xF2:
+        w.field("", msg[1] | msg[2] << 7);
+        break;
+    case 0xF3:
+        w.field("", msg[1]);
+        break;
+    default:
+        break;
+    }
+    return w.length();
+}
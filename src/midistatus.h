@@ -0,0 +1,114 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDISTATUS_H
+#define MIDISTATUS_H
+
+#include <QtGlobal>
+
+// Compile time tables indexed by a MIDI byte
+// Parsing, filtering and display all classify a byte with one lookup; the
+// tables are built by constexpr functions so they cannot drift from the
+// rules written out below.
+namespace MidiStatus
+{
+    enum Kind {
+        KIND_DATA,              // 00-7F
+        KIND_CHANNEL,           // 80-EF
+        KIND_COMMON,            // F1-F3, F6
+        KIND_REALTIME,          // F8-FF, may appear anywhere, even inside SysEx
+        KIND_SYSEX_START,       // F0
+        KIND_SYSEX_END,         // F7
+        KIND_UNDEFINED          // F4, F5
+    };
+
+    Q_DECL_CONSTEXPR inline int kindOf(int byte)
+    {
+        return byte < 0x80 ? KIND_DATA
+             : byte < 0xF0 ? KIND_CHANNEL
+             : byte == 0xF0 ? KIND_SYSEX_START
+             : byte == 0xF7 ? KIND_SYSEX_END
+             : byte >= 0xF8 ? KIND_REALTIME
+             : byte == 0xF4 || byte == 0xF5 ? KIND_UNDEFINED
+             : KIND_COMMON;
+    }
+
+    // Data bytes that follow a status byte
+    Q_DECL_CONSTEXPR inline int dataLengthOf(int byte)
+    {
+        return (byte >= 0xC0 && byte < 0xE0) || byte == 0xF1 || byte == 0xF3 ? 1
+             : (byte >= 0x80 && byte < 0xF0) || byte == 0xF2 ? 2
+             : 0;
+    }
+
+    // Kind in the low nibble, data length in the high one
+    Q_DECL_CONSTEXPR inline quint8 entryOf(int byte)
+    {
+        return static_cast<quint8>(kindOf(byte) | dataLengthOf(byte) << 4);
+    }
+
+    // Name of the message a status byte starts, channel messages by their high nibble
+    Q_DECL_CONSTEXPR inline const char *mnemonicOf(int byte)
+    {
+        return byte < 0x80 ? "Data"
+             : byte < 0x90 ? "NoteOff"
+             : byte < 0xA0 ? "NoteOn"
+             : byte < 0xB0 ? "KeyPressure"
+             : byte < 0xC0 ? "Control"
+             : byte < 0xD0 ? "Program"
+             : byte < 0xE0 ? "ChannelPressure"
+             : byte < 0xF0 ? "PitchBend"
+             : byte == 0xF0 ? "SysEx"
+             : byte == 0xF1 ? "TimecodeQF"
+             : byte == 0xF2 ? "SongPosition"
+             : byte == 0xF3 ? "SongSelect"
+             : byte == 0xF6 ? "TuneRequest"
+             : byte == 0xF7 ? "EndSysEx"
+             : byte == 0xF8 ? "Clock"
+             : byte == 0xFA ? "Start"
+             : byte == 0xFB ? "Continue"
+             : byte == 0xFC ? "Stop"
+             : byte == 0xFE ? "ActiveSensing"
+             : byte == 0xFF ? "Reset"
+             : "Undefined";
+    }
+
+#define MIDISTATUS_ROW(f, n) \
+    f(n + 0x0), f(n + 0x1), f(n + 0x2), f(n + 0x3), f(n + 0x4), f(n + 0x5), f(n + 0x6), f(n + 0x7), \
+    f(n + 0x8), f(n + 0x9), f(n + 0xA), f(n + 0xB), f(n + 0xC), f(n + 0xD), f(n + 0xE), f(n + 0xF)
+#define MIDISTATUS_TABLE(f) { \
+    MIDISTATUS_ROW(f, 0x00), MIDISTATUS_ROW(f, 0x10), MIDISTATUS_ROW(f, 0x20), MIDISTATUS_ROW(f, 0x30), \
+    MIDISTATUS_ROW(f, 0x40), MIDISTATUS_ROW(f, 0x50), MIDISTATUS_ROW(f, 0x60), MIDISTATUS_ROW(f, 0x70), \
+    MIDISTATUS_ROW(f, 0x80), MIDISTATUS_ROW(f, 0x90), MIDISTATUS_ROW(f, 0xA0), MIDISTATUS_ROW(f, 0xB0), \
+    MIDISTATUS_ROW(f, 0xC0), MIDISTATUS_ROW(f, 0xD0), MIDISTATUS_ROW(f, 0xE0), MIDISTATUS_ROW(f, 0xF0) }
+
+    constexpr quint8 TABLE[256] = MIDISTATUS_TABLE(entryOf);
+    constexpr const char *MNEMONICS[256] = MIDISTATUS_TABLE(mnemonicOf);
+
+    inline int kind(quint8 byte) { return TABLE[byte] & 0x0F; }
+    inline int dataLength(quint8 byte) { return TABLE[byte] >> 4; }
+    inline const char *mnemonic(quint8 byte) { return MNEMONICS[byte]; }
+
+    // Renders a message as text, e.g. "NoteOn ch3 C4 v100", into out
+    // Returns the length written, truncated to capacity
+    int disassemble(const quint8 *msg, int length, char *out, int capacity);
+}
+
+#endif // MIDISTATUS_H
@@ -0,0 +1,227 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDISTREAMPARSER_H
+#define MIDISTREAMPARSER_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <cstring>
+#include "midistatus.h"
+#include "udpmidi.h"
+
+// MIDI 1.0 byte stream parser for one source
+// Bytes may arrive split anywhere, so state carries over between calls:
+// running status, a partly received message, and SysEx being reassembled.
+// Real time bytes are delivered the moment they arrive, including from the
+// middle of a SysEx or a channel message. Each byte costs one table lookup
+// and nothing is allocated.
+class MidiStreamParser
+{
+public:
+    // Longer SysEx is dropped and counted as an error
+    static const int SYSEX_CAPACITY = UdpMidi::MAX_MESSAGE_LENGTH;
+
+    MidiStreamParser() {}
+
+    void reset()
+    {
+        m_message[0] = 0;
+        m_count = 0;
+        m_inSysex = false;
+    }
+
+    // Calls sink(const quint8 *msg, int length) for each complete message in
+    // stream order. msg is only valid for the duration of the call.
+    template <typename Sink>
+    void parse(const quint8 *data, int length, Sink &sink);
+
+    // Stray data bytes, undefined status bytes, messages cut short by a
+    // status byte and SysEx that did not fit
+    quint64 errors() const { return m_errors; }
+
+private:
+    template <typename Sink>
+    void endSysex(Sink &sink);
+
+    quint8 m_message[3] = { 0, 0, 0 };  // Status, 0 when there is none, and data
+    int m_expected = 0;
+    int m_count = 0;
+    bool m_inSysex = false;
+    bool m_sysexOverflow = false;
+    int m_sysexLength = 0;
+    quint64 m_errors = 0;
+    quint8 m_sysex[SYSEX_CAPACITY];
+};
+
+// One stream parser per sender address and port, created on first use
+class MidiSourceParsers
+{
+public:
+    // Senders whose stream state is kept at once
+    static const int MAX_SOURCES = 256;
+
+    MidiSourceParsers() {}
+    ~MidiSourceParsers() { qDeleteAll(m_parsers); }
+
+    MidiStreamParser &parserFor(quint32 sender, quint16 port)
+    {
+        const quint64 key = quint64(sender) << 16 | port;
+        QHash<quint64, MidiStreamParser *>::const_iterator i = m_parsers.constFind(key);
+        if(i != m_parsers.constEnd())
+            return *i.value();
+
+        // A flood of senders costs them their partial messages, not unbounded memory
+        if(m_parsers.count() >= MAX_SOURCES)
+        {
+            qDeleteAll(m_parsers);
+            m_parsers.clear();
+        }
+        MidiStreamParser *parser = new MidiStreamParser;
+        m_parsers.insert(key, parser);
+        return *parser;
+    }
+
+private:
+    QHash<quint64, MidiStreamParser *> m_parsers;
+
+    Q_DISABLE_COPY(MidiSourceParsers)
+};
+
+template <typename Sink>
+void MidiStreamParser::endSysex(Sink &sink)
+{
+    // Any status byte other than real time ends a SysEx, F7 or not
+    m_inSysex = false;
+    if(m_sysexOverflow)
+    {
+        m_errors++;
+        return;
+    }
+    m_sysex[m_sysexLength++] = 0xF7;
+    sink(static_cast<const quint8 *>(m_sysex), m_sysexLength);
+}
+
+template <typename Sink>
+void MidiStreamParser::parse(const quint8 *data, int length, Sink &sink)
+{
+    // The common case of short messages works on locals, written back when
+    // anything else needs the members
+    quint8 *message = m_message;
+    int count = m_count;
+    const quint8 *end = data + length;
+    for(const quint8 *p = data; p < end; p++)
+    {
+        const quint8 byte = *p;
+        const quint8 entry = MidiStatus::TABLE[byte];
+        const int kind = entry & 0x0F;
+        if(kind == MidiStatus::KIND_DATA && !m_inSysex)
+        {
+            if(!message[0])
+            {
+                m_errors++;
+                continue;
+            }
+            message[++count] = byte;
+            if(count == m_expected)
+            {
+                sink(static_cast<const quint8 *>(message), count + 1);
+                count = 0;
+                // Only channel messages run on
+                if(message[0] >= 0xF0)
+                    message[0] = 0;
+            }
+            continue;
+        }
+
+        switch(kind)
+        {
+        case MidiStatus::KIND_DATA:
+        {
+            // SysEx body, copied up to the next status byte in one go
+            const quint8 *run = p + 1;
+            while(run < end && *run < 0x80)
+                run++;
+            const int bytes = static_cast<int>(run - p);
+            // One byte is kept back for the F7
+            if(m_sysexLength + bytes < SYSEX_CAPACITY)
+            {
+                memcpy(m_sysex + m_sysexLength, p, bytes);
+                m_sysexLength += bytes;
+            }
+            else
+                m_sysexOverflow = true;
+            p = run - 1;
+            break;
+        }
+
+        case MidiStatus::KIND_CHANNEL:
+        case MidiStatus::KIND_COMMON:
+            if(m_inSysex)
+                endSysex(sink);
+            if(count)
+                m_errors++;
+            message[0] = byte;
+            m_expected = entry >> 4;
+            count = 0;
+            if(m_expected == 0)
+            {
+                sink(static_cast<const quint8 *>(message), 1);
+                message[0] = 0;
+            }
+            break;
+
+        case MidiStatus::KIND_REALTIME:
+            sink(p, 1);
+            break;
+
+        case MidiStatus::KIND_SYSEX_START:
+            if(m_inSysex)
+                endSysex(sink);
+            if(count)
+                m_errors++;
+            message[0] = 0;
+            count = 0;
+            m_inSysex = true;
+            m_sysexOverflow = false;
+            m_sysex[0] = byte;
+            m_sysexLength = 1;
+            break;
+
+        case MidiStatus::KIND_SYSEX_END:
+            if(m_inSysex)
+                endSysex(sink);
+            else
+                m_errors++;
+            break;
+
+        default:
+            if(m_inSysex)
+                endSysex(sink);
+            message[0] = 0;
+            count = 0;
+            m_errors++;
+            break;
+        }
+    }
+    m_count = count;
+}
+
+#endif // MIDISTREAMPARSER_H
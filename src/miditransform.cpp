@@ -0,0 +1,180 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "miditransform.h"
+#include "mididata.h"
+#include <QFile>
+#include <QStringList>
+#include <cmath>
+
+// Rows of the tables, by the high nibble of the status byte
+static const int ROW_NOTE_OFF = (MidiData::MIDI_NOTE_OFF - 0x80) >> 4;
+static const int ROW_NOTE_ON = (MidiData::MIDI_NOTE_ON - 0x80) >> 4;
+static const int ROW_POLY_PRESSURE = ROW_NOTE_ON + 1;
+static const int KIND_COUNT = 7;
+
+namespace
+{
+    // 1-16 as 0-15, or "all" as -1
+    bool parseChannel(const QString &text, bool allowAll, int &channel)
+    {
+        if(allowAll && text.toLower() == QLatin1String("all"))
+        {
+            channel = -1;
+            return true;
+        }
+        bool ok;
+        channel = text.toInt(&ok) - 1;
+        return ok && channel >= 0 && channel < 16;
+    }
+
+    quint8 clampData(int value, int low)
+    {
+        return static_cast<quint8>(qBound(low, value, 127));
+    }
+}
+
+MidiTransform::MidiTransform()
+{
+    reset();
+}
+
+void MidiTransform::reset()
+{
+    for(unsigned row=0; row<CHANNEL_ROWS; row++)
+    {
+        m_status[row] = static_cast<quint8>(0x80 + row);
+        for(int v=0; v<128; v++)
+        {
+            m_data1[row][v] = static_cast<quint8>(v);
+            m_data2[row][v] = static_cast<quint8>(v);
+        }
+    }
+    m_identity = true;
+}
+
+bool MidiTransform::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        if(error)
+            *error = file.errorString();
+        return false;
+    }
+    return parse(QString::fromUtf8(file.readAll()), error);
+}
+
+bool MidiTransform::parse(const QString &text, QString *error)
+{
+    reset();
+
+    const QStringList lines = text.split(QChar('\n'));
+    for(int n=0; n<lines.count(); n++)
+    {
+        QString line = lines[n];
+        int comment = line.indexOf(QChar('#'));
+        if(comment >= 0)
+            line.truncate(comment);
+        QStringList tokens = line.simplified().split(QChar(' '), QString::SkipEmptyParts);
+        if(tokens.isEmpty())
+            continue;
+
+        const QString keyword = tokens[0].toLower();
+        int channel = 0;
+        bool ok = tokens.count() >= 3;
+        if(keyword == QLatin1String("channel"))
+        {
+            int out = 0;
+            ok = ok && tokens.count() == 3 && parseChannel(tokens[1], false, channel) && parseChannel(tokens[2], false, out);
+            for(int kind=0; ok && kind<KIND_COUNT; kind++)
+                m_status[kind * 16 + channel] = static_cast<quint8>(0x80 + kind * 16 + out);
+        }
+        else if(keyword == QLatin1String("transpose"))
+        {
+            int semitones = tokens.value(2).toInt(&ok);
+            ok = ok && tokens.count() == 3 && parseChannel(tokens[1], true, channel) && qAbs(semitones) <= 127;
+            for(int c=0; ok && c<16; c++)
+            {
+                if(channel >= 0 && c != channel)
+                    continue;
+                for(int kind=ROW_NOTE_OFF; kind<=ROW_POLY_PRESSURE; kind++)
+                {
+                    for(int v=0; v<128; v++)
+                        m_data1[kind * 16 + c][v] = clampData(m_data1[kind * 16 + c][v] + semitones, 0);
+                }
+            }
+        }
+        else if(keyword == QLatin1String("velocity"))
+        {
+            // Each curve maps 1-127 onto 1-127, applied to what earlier rules produced
+            const QString curve = tokens.value(2).toLower();
+            quint8 map[128];
+            map[0] = 0;
+            ok = ok && parseChannel(tokens[1], true, channel);
+            if(curve == QLatin1String("fixed"))
+            {
+                int value = tokens.value(3).toInt(&ok);
+                ok = ok && tokens.count() == 4 && value >= 1 && value <= 127;
+                for(int v=1; v<128; v++)
+                    map[v] = static_cast<quint8>(value);
+            }
+            else if(curve == QLatin1String("range"))
+            {
+                bool ok2;
+                int low = tokens.value(3).toInt(&ok);
+                int high = tokens.value(4).toInt(&ok2);
+                ok = ok && ok2 && tokens.count() == 5 && low >= 1 && low <= high && high <= 127;
+                for(int v=1; v<128; v++)
+                    map[v] = static_cast<quint8>(low + ((v - 1) * (high - low) + 63) / 126);
+            }
+            else if(curve == QLatin1String("curve"))
+            {
+                double exponent = tokens.value(3).toDouble(&ok);
+                ok = ok && tokens.count() == 4 && exponent >= 0.1 && exponent <= 10;
+                for(int v=1; v<128; v++)
+                    map[v] = clampData(qRound(127 * std::pow(v / 127.0, exponent)), 1);
+            }
+            else
+                ok = false;
+
+            for(int c=0; ok && c<16; c++)
+            {
+                if(channel >= 0 && c != channel)
+                    continue;
+                quint8 *velocities = m_data2[ROW_NOTE_ON * 16 + c];
+                for(int v=0; v<128; v++)
+                    velocities[v] = map[velocities[v]];
+            }
+        }
+        else
+            ok = false;
+
+        if(!ok)
+        {
+            if(error)
+                *error = tr("Line %1 : cannot read \"%2\"").arg(n + 1).arg(line.trimmed());
+            reset();
+            return false;
+        }
+        m_identity = false;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MIDITRANSFORM_H
+#define MIDITRANSFORM_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QCoreApplication>
+
+// Channel remap, transpose and velocity curves for outgoing messages
+// A mapping file is compiled into lookup tables indexed by the status byte a
+// message arrives with, so rewriting one costs the same three lookups however
+// many rules there are.
+//
+//   # Comments run to the end of the line
+//   channel 1 3             Messages on channel 1 go out on channel 3
+//   transpose 2 -12         Notes on channel 2, or all, move by semitones, within 0-127
+//   velocity all range 40 127   Note on velocities 1-127 spread over 40-127
+//   velocity 10 fixed 100   Every note on channel 10 at velocity 100
+//   velocity all curve 0.6  Velocities raised to a power, below 1 plays louder
+//
+// Transpose and velocity rules match the channel before any remap and are
+// applied in file order. A note on at velocity 0 stays a note off.
+class MidiTransform
+{
+    Q_DECLARE_TR_FUNCTIONS(MidiTransform)
+
+public:
+    MidiTransform();
+
+    bool load(const QString &fileName, QString *error = Q_NULLPTR);
+    bool parse(const QString &text, QString *error = Q_NULLPTR);
+
+    // True when no rules were loaded
+    bool isIdentity() const { return m_identity; }
+
+    // Rewrites a complete message in place; anything but channel messages is left alone
+    void apply(quint8 *msg, int length) const
+    {
+        const unsigned row = msg[0] - 0x80u;
+        if(row >= CHANNEL_ROWS || length < 2)
+            return;
+        msg[0] = m_status[row];
+        msg[1] = m_data1[row][msg[1] & 0x7F];
+        if(length > 2)
+            msg[2] = m_data2[row][msg[2] & 0x7F];
+    }
+
+private:
+    // Status bytes 0x80 to 0xEF
+    static const unsigned CHANNEL_ROWS = 0x70;
+
+    void reset();
+
+    quint8 m_status[CHANNEL_ROWS];
+    quint8 m_data1[CHANNEL_ROWS][128];
+    quint8 m_data2[CHANNEL_ROWS][128];
+    bool m_identity;
+};
+
+#endif // MIDITRANSFORM_H
@@ -0,0 +1,353 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "mscbuilder.h"
+#include "mididata.h"
+
+namespace
+{
+    struct Name
+    {
+        quint8 value;
+        const char *name;
+    };
+
+    constexpr Name COMMANDS[] = {
+        {MidiData::MSC_COMMAND_GO, "GO"},
+        {MidiData::MSC_COMMAND_STOP, "STOP"},
+        {MidiData::MSC_COMMAND_RESUME, "RESUME"},
+        {MidiData::MSC_COMMAND_TIMED_GO, "TIMED_GO"},
+        {MidiData::MSC_COMMAND_LOAD, "LOAD"},
+        {MidiData::MSC_COMMAND_SET, "SET"},
+        {MidiData::MSC_COMMAND_FIRE, "FIRE"},
+        {MidiData::MSC_COMMAND_ALL_OFF, "ALL_OFF"},
+        {MidiData::MSC_COMMAND_RESTORE, "RESTORE"},
+        {MidiData::MSC_COMMAND_RESET, "RESET"},
+        {MidiData::MSC_COMMAND_GO_OFF, "GO_OFF"},
+        {MidiData::MSC_COMMAND_GO_JAM_CLOCK, "GO_JAM_CLOCK"},
+        {MidiData::MSC_COMMAND_STANDBY_PLUS, "STANDBY_PLUS"},
+        {MidiData::MSC_COMMAND_STANDBY_MINUS, "STANDBY_MINUS"},
+        {MidiData::MSC_COMMAND_SEQUENCE_PLUS, "SEQUENCE_PLUS"},
+        {MidiData::MSC_COMMAND_SEQUENCE_MINUS, "SEQUENCE_MINUS"},
+        {MidiData::MSC_COMMAND_START_CLOCK, "START_CLOCK"},
+        {MidiData::MSC_COMMAND_STOP_CLOCK, "STOP_CLOCK"},
+        {MidiData::MSC_COMMAND_ZERO_CLOCK, "ZERO_CLOCK"},
+        {MidiData::MSC_COMMAND_SET_CLOCK, "SET_CLOCK"},
+        {MidiData::MSC_COMMAND_MTC_CHASE_ON, "MTC_CHASE_ON"},
+        {MidiData::MSC_COMMAND_MTC_CHASE_OFF, "MTC_CHASE_OFF"},
+        {MidiData::MSC_COMMAND_OPEN_CUE_LIST, "OPEN_CUE_LIST"},
+        {MidiData::MSC_COMMAND_CLOSE_CUE_LIST, "CLOSE_CUE_LIST"},
+        {MidiData::MSC_COMMAND_OPEN_CUE_PATH, "OPEN_CUE_PATH"},
+    };
+
+    constexpr Name FORMATS[] = {
+        {MidiData::MSC_COMMAND_FORMAT_LIGHTING, "LIGHTING"},
+        {MidiData::MSC_COMMAND_FORMAT_MOVING_LIGHTS, "MOVING_LIGHTS"},
+        {MidiData::MSC_COMMAND_FORMAT_COLOUR_CHANGERS, "COLOUR_CHANGERS"},
+        {MidiData::MSC_COMMAND_FORMAT_STROBES, "STROBES"},
+        {MidiData::MSC_COMMAND_FORMAT_LASERS, "LASERS"},
+        {MidiData::MSC_COMMAND_FORMAT_CHASERS, "CHASERS"},
+        {MidiData::MSC_COMMAND_FORMAT_SOUND, "SOUND"},
+        {MidiData::MSC_COMMAND_FORMAT_MUSIC, "MUSIC"},
+        {MidiData::MSC_COMMAND_FORMAT_CD_PLAYERS, "CD_PLAYERS"},
+        {MidiData::MSC_COMMAND_FORMAT_EPROM_PLAYBACK, "EPROM_PLAYBACK"},
+        {MidiData::MSC_COMMAND_FORMAT_AUDIO_TAPE_MACHINES, "AUDIO_TAPE_MACHINES"},
+        {MidiData::MSC_COMMAND_FORMAT_INTERCOMS, "INTERCOMS"},
+        {MidiData::MSC_COMMAND_FORMAT_AMPLIFIERS, "AMPLIFIERS"},
+        {MidiData::MSC_COMMAND_FORMAT_AUDIO_EFFECTS_DEVICES, "AUDIO_EFFECTS_DEVICES"},
+        {MidiData::MSC_COMMAND_FORMAT_EQUALISERS, "EQUALISERS"},
+        {MidiData::MSC_COMMAND_FORMAT_MACHINERY, "MACHINERY"},
+        {MidiData::MSC_COMMAND_FORMAT_RIGGING, "RIGGING"},
+        {MidiData::MSC_COMMAND_FORMAT_FLYS, "FLYS"},
+        {MidiData::MSC_COMMAND_FORMAT_LIFTS, "LIFTS"},
+        {MidiData::MSC_COMMAND_FORMAT_TURNTABLES, "TURNTABLES"},
+        {MidiData::MSC_COMMAND_FORMAT_TRUSSES, "TRUSSES"},
+        {MidiData::MSC_COMMAND_FORMAT_ROBOTS, "ROBOTS"},
+        {MidiData::MSC_COMMAND_FORMAT_ANIMATION, "ANIMATION"},
+        {MidiData::MSC_COMMAND_FORMAT_FLOATS, "FLOATS"},
+        {MidiData::MSC_COMMAND_FORMAT_BREAKAWAYS, "BREAKAWAYS"},
+        {MidiData::MSC_COMMAND_FORMAT_BARGES, "BARGES"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO, "VIDEO"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_TAPE_MACHINES, "VIDEO_TAPE_MACHINES"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_CASSETTE_MACHINES, "VIDEO_CASSETTE_MACHINES"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_DISC_PLAYERS, "VIDEO_DISC_PLAYERS"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_SWITCHERS, "VIDEO_SWITCHERS"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_EFFECTS, "VIDEO_EFFECTS"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_CHARACTER_GENERATORS, "VIDEO_CHARACTER_GENERATORS"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_STILL_STORES, "VIDEO_STILL_STORES"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_MONITORS, "VIDEO_MONITORS"},
+        {MidiData::MSC_COMMAND_FORMAT_PROJECTION, "PROJECTION"},
+        {MidiData::MSC_COMMAND_FORMAT_FILM_PROJECTORS, "FILM_PROJECTORS"},
+        {MidiData::MSC_COMMAND_FORMAT_SLIDE_PROJECTORS, "SLIDE_PROJECTORS"},
+        {MidiData::MSC_COMMAND_FORMAT_VIDEO_PROJECTORS, "VIDEO_PROJECTORS"},
+        {MidiData::MSC_COMMAND_FORMAT_DISSOLVERS, "DISSOLVERS"},
+        {MidiData::MSC_COMMAND_FORMAT_SHUTTER_CONTROLS, "SHUTTER_CONTROLS"},
+        {MidiData::MSC_COMMAND_FORMAT_PROCESS_CONTROL, "PROCESS_CONTROL"},
+        {MidiData::MSC_COMMAND_FORMAT_HYDRAULIC_OIL, "HYDRAULIC_OIL"},
+        {MidiData::MSC_COMMAND_FORMAT_H2O, "H2O"},
+        {MidiData::MSC_COMMAND_FORMAT_CO2, "CO2"},
+        {MidiData::MSC_COMMAND_FORMAT_COMPRESSED_AIR, "COMPRESSED_AIR"},
+        {MidiData::MSC_COMMAND_FORMAT_NATURAL_GAS, "NATURAL_GAS"},
+        {MidiData::MSC_COMMAND_FORMAT_FOG, "FOG"},
+        {MidiData::MSC_COMMAND_FORMAT_SMOKE, "SMOKE"},
+        {MidiData::MSC_COMMAND_FORMAT_CRACKED_HAZE, "CRACKED_HAZE"},
+        {MidiData::MSC_COMMAND_FORMAT_PYRO, "PYRO"},
+        {MidiData::MSC_COMMAND_FORMAT_FIREWORKS, "FIREWORKS"},
+        {MidiData::MSC_COMMAND_FORMAT_EXPLOSIONS, "EXPLOSIONS"},
+        {MidiData::MSC_COMMAND_FORMAT_FLAME, "FLAME"},
+        {MidiData::MSC_COMMAND_FORMAT_SMOKE_POTS, "SMOKE_POTS"},
+        {MidiData::MSC_COMMAND_FORMAT_ALL_TYPES, "ALL_TYPES"},
+    };
+
+    template <int N>
+    const char *nameOf(const Name (&table)[N], quint8 value)
+    {
+        for(int i=0; i<N; i++)
+        {
+            if(table[i].value == value)
+                return table[i].name;
+        }
+        return Q_NULLPTR;
+    }
+
+    template <int N>
+    int valueOf(const Name (&table)[N], const QString &name)
+    {
+        for(int i=0; i<N; i++)
+        {
+            const char *key = table[i].name;
+            int c = 0;
+            while(key[c] && c < name.length() && name[c].toUpper() == QLatin1Char(key[c]))
+                c++;
+            if(!key[c] && c == name.length())
+                return table[i].value;
+        }
+        return -1;
+    }
+
+    int hexValue(ushort c)
+    {
+        if(c >= '0' && c <= '9')
+            return c - '0';
+        if(c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        if(c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    }
+}
+
+MscBuilder::MscBuilder(quint8 deviceId, quint8 commandFormat, quint8 command)
+{
+    m_data[m_length++] = 0xF0;
+    m_data[m_length++] = 0x7F;
+    m_data[m_length++] = deviceId;
+    m_data[m_length++] = 0x02;
+    m_data[m_length++] = commandFormat;
+    m_data[m_length++] = command;
+}
+
+bool MscBuilder::fail()
+{
+    m_valid = false;
+    return false;
+}
+
+bool MscBuilder::append(quint8 value)
+{
+    // The last byte is kept for the F7
+    if(m_length >= MAX_LENGTH - 1)
+        return fail();
+    m_data[m_length++] = value;
+    return true;
+}
+
+bool MscBuilder::separate()
+{
+    // Every number after the first follows a 00
+    return m_numbers++ == 0 || append(0x00);
+}
+
+bool MscBuilder::addNumber(const char *decimal, int length)
+{
+    if(length <= 0)
+        return fail();
+
+    int points = 0;
+    for(int i=0; i<length; i++)
+    {
+        if(decimal[i] == '.')
+        {
+            if(++points > 1 || i == 0 || i == length - 1)
+                return fail();
+        }
+        else if(decimal[i] < '0' || decimal[i] > '9')
+            return fail();
+    }
+
+    if(!separate())
+        return false;
+    for(int i=0; i<length; i++)
+    {
+        if(!append(static_cast<quint8>(decimal[i])))
+            return false;
+    }
+    return true;
+}
+
+bool MscBuilder::addNumber(const QChar *decimal, int length)
+{
+    char digits[MAX_LENGTH];
+    if(length > MAX_LENGTH)
+        return fail();
+    for(int i=0; i<length; i++)
+        digits[i] = decimal[i].unicode() < 0x80 ? static_cast<char>(decimal[i].unicode()) : '?';
+    return addNumber(digits, length);
+}
+
+bool MscBuilder::addNumber(const QString &decimal)
+{
+    return addNumber(decimal.constData(), decimal.length());
+}
+
+bool MscBuilder::addNumber(quint32 value, int decimals)
+{
+    if(decimals < 0 || decimals > 9)
+        return fail();
+
+    // Digits backwards, with enough leading zeros for the point
+    char reversed[24];
+    int count = 0;
+    do
+    {
+        reversed[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while(value || count <= decimals);
+
+    // 1.50 is cue 1.5, and 2.00 cue 2
+    int skip = 0;
+    while(skip < decimals && reversed[skip] == '0')
+        skip++;
+
+    char digits[24];
+    int length = 0;
+    for(int i=count - 1; i>=skip; i--)
+    {
+        if(i == decimals - 1)
+            digits[length++] = '.';
+        digits[length++] = reversed[i];
+    }
+    return addNumber(digits, length);
+}
+
+bool MscBuilder::addEosCue(const QString &text)
+{
+    const int slash = text.indexOf(QLatin1Char('/'));
+    if(slash < 0)
+        return addNumber(text);
+
+    // Cue first, then the list it belongs to
+    if(slash == 0)
+        return fail();
+    // "list/" leaves the cue blank, as in 00 list
+    if(slash == text.length() - 1)
+        return separate() && addNumber(text.constData(), slash);
+    return addNumber(text.constData() + slash + 1, text.length() - slash - 1)
+            && addNumber(text.constData(), slash);
+}
+
+bool MscBuilder::addHex(const QString &text)
+{
+    int high = -1;
+    for(int i=0; i<text.length(); i++)
+    {
+        const ushort c = text[i].unicode();
+        if(c == ' ')
+            continue;
+        const int nibble = hexValue(c);
+        if(nibble < 0)
+            return fail();
+        if(high < 0)
+            high = nibble;
+        else
+        {
+            if(!append(static_cast<quint8>(high << 4 | nibble)))
+                return false;
+            high = -1;
+        }
+    }
+    return high < 0 ? true : fail();
+}
+
+bool MscBuilder::addData(const quint8 *data, int length)
+{
+    for(int i=0; i<length; i++)
+    {
+        if(!append(data[i]))
+            return false;
+    }
+    return true;
+}
+
+bool MscBuilder::finish()
+{
+    m_data[m_length++] = 0xF7;
+    return m_valid;
+}
+
+const char *MscBuilder::commandName(quint8 command)
+{
+    return nameOf(COMMANDS, command);
+}
+
+const char *MscBuilder::formatName(quint8 commandFormat)
+{
+    return nameOf(FORMATS, commandFormat);
+}
+
+int MscBuilder::commandFromName(const QString &name)
+{
+    return valueOf(COMMANDS, name);
+}
+
+int MscBuilder::formatFromName(const QString &name)
+{
+    return valueOf(FORMATS, name);
+}
+
+int MscBuilder::commandCount()
+{
+    return sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+}
+
+quint8 MscBuilder::command(int index)
+{
+    return COMMANDS[index].value;
+}
+
+int MscBuilder::formatCount()
+{
+    return sizeof(FORMATS) / sizeof(FORMATS[0]);
+}
+
+quint8 MscBuilder::format(int index)
+{
+    return FORMATS[index].value;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MSCBUILDER_H
+#define MSCBUILDER_H
+
+#include <QtGlobal>
+#include <QString>
+
+// Builds one MIDI Show Control message in place
+// F0 7F <device_ID> 02 <command_format> <command> <data> F7
+// Cue, list and path numbers are written as the ASCII digits they are given
+// in, so a cue such as 1.1 or 0.05 is never rounded through floating point.
+// Nothing is allocated; an invalid or over-long part marks the message bad
+// and finish() reports it.
+class MscBuilder
+{
+public:
+    // The MSC specification caps a message at 128 bytes
+    static const int MAX_LENGTH = 128;
+
+    MscBuilder(quint8 deviceId, quint8 commandFormat, quint8 command);
+
+    // Cue, then list, then path, separated by 00. A number is at least one
+    // digit, with at most one decimal point between digits.
+    bool addNumber(const QString &decimal);
+    bool addNumber(const char *decimal, int length);
+    // Fixed point, e.g. 105 with two decimals is cue 1.05
+    bool addNumber(quint32 value, int decimals = 0);
+
+    // Eos entry as typed: "list/cue", "list/" or "cue"
+    bool addEosCue(const QString &text);
+
+    // Hex byte pairs, spaces ignored, e.g. "01 00 7F"
+    bool addHex(const QString &text);
+    bool addData(const quint8 *data, int length);
+
+    // Appends the F7, false if anything added was rejected
+    bool finish();
+
+    bool isValid() const { return m_valid; }
+    const quint8 *data() const { return m_data; }
+    int length() const { return m_length; }
+
+    // Names without the MidiData enum prefixes, e.g. "GO", "LIGHTING"
+    static const char *commandName(quint8 command);
+    static const char *formatName(quint8 commandFormat);
+    // Case insensitive, -1 if unknown
+    static int commandFromName(const QString &name);
+    static int formatFromName(const QString &name);
+    // Every named value, in MidiData order
+    static int commandCount();
+    static quint8 command(int index);
+    static int formatCount();
+    static quint8 format(int index);
+
+private:
+    bool addNumber(const QChar *decimal, int length);
+    bool separate();
+    bool append(quint8 value);
+    bool fail();
+
+    quint8 m_data[MAX_LENGTH];
+    int m_length = 0;
+    int m_numbers = 0;
+    bool m_valid = true;
+};
+
+#endif // MSCBUILDER_H
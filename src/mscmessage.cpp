@@ -0,0 +1,254 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "mscmessage.h"
+#include "mscbuilder.h"
+#include "mididata.h"
+#include <cstring>
+
+namespace
+{
+    // How a command's data is laid out, after the MSC specification
+    enum Layout {
+        LAYOUT_NONE,
+        LAYOUT_CUE,             // cue 00 list 00 path
+        LAYOUT_TIME_CUE,        // time then cue 00 list 00 path
+        LAYOUT_LIST,
+        LAYOUT_TIME_LIST,
+        LAYOUT_PATH
+    };
+
+    Layout layoutOf(quint8 command)
+    {
+        switch(command)
+        {
+        case MidiData::MSC_COMMAND_GO:
+        case MidiData::MSC_COMMAND_STOP:
+        case MidiData::MSC_COMMAND_RESUME:
+        case MidiData::MSC_COMMAND_LOAD:
+        case MidiData::MSC_COMMAND_GO_OFF:
+        case MidiData::MSC_COMMAND_GO_JAM_CLOCK:
+            return LAYOUT_CUE;
+        case MidiData::MSC_COMMAND_TIMED_GO:
+            return LAYOUT_TIME_CUE;
+        case MidiData::MSC_COMMAND_STANDBY_PLUS:
+        case MidiData::MSC_COMMAND_STANDBY_MINUS:
+        case MidiData::MSC_COMMAND_SEQUENCE_PLUS:
+        case MidiData::MSC_COMMAND_SEQUENCE_MINUS:
+        case MidiData::MSC_COMMAND_START_CLOCK:
+        case MidiData::MSC_COMMAND_STOP_CLOCK:
+        case MidiData::MSC_COMMAND_ZERO_CLOCK:
+        case MidiData::MSC_COMMAND_MTC_CHASE_ON:
+        case MidiData::MSC_COMMAND_MTC_CHASE_OFF:
+        case MidiData::MSC_COMMAND_OPEN_CUE_LIST:
+        case MidiData::MSC_COMMAND_CLOSE_CUE_LIST:
+            return LAYOUT_LIST;
+        case MidiData::MSC_COMMAND_SET_CLOCK:
+            return LAYOUT_TIME_LIST;
+        case MidiData::MSC_COMMAND_OPEN_CUE_PATH:
+            return LAYOUT_PATH;
+        default:
+            return LAYOUT_NONE;
+        }
+    }
+
+    const int TIME_LENGTH = 5;
+
+    // Next 00 separated field of [p, end)
+    MscMessage::Span field(const quint8 *&p, const quint8 *end)
+    {
+        MscMessage::Span span;
+        span.data = p;
+        while(p < end && *p != 0x00)
+            p++;
+        span.length = static_cast<int>(p - span.data);
+        if(p < end)
+            p++;
+        return span;
+    }
+
+    class Writer
+    {
+    public:
+        Writer(char *text, int size) : m_p(text), m_end(text + size), m_start(text) {}
+
+        void append(const char *text, int length)
+        {
+            length = qMin(length, static_cast<int>(m_end - m_p));
+            memcpy(m_p, text, length);
+            m_p += length;
+        }
+        void append(const char *text) { append(text, static_cast<int>(strlen(text))); }
+        void append(const MscMessage::Span &span)
+        {
+            append(reinterpret_cast<const char *>(span.data), span.length);
+        }
+        void hex(quint8 value)
+        {
+            static const char digits[] = "0123456789ABCDEF";
+            char pair[2] = { digits[value >> 4], digits[value & 0x0F] };
+            append(pair, 2);
+        }
+        void decimal(int value, int minDigits = 1)
+        {
+            char digits[12];
+            int count = 0;
+            do
+            {
+                digits[sizeof(digits) - 1 - count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while(value || count < minDigits);
+            append(digits + sizeof(digits) - count, count);
+        }
+
+        int length() const { return static_cast<int>(m_p - m_start); }
+
+    private:
+        char *m_p;
+        char *m_end;
+        char *m_start;
+    };
+}
+
+bool MscMessage::Span::equals(const char *text, int textLength) const
+{
+    return length == textLength && memcmp(data, text, length) == 0;
+}
+
+bool MscMessage::decode(const quint8 *msg, int length, MscMessage &message)
+{
+    if(!isMsc(msg, length))
+        return false;
+
+    const quint8 *end = msg + length;
+    if(end[-1] == 0xF7)
+        end--;
+
+    message.deviceId = msg[2];
+    message.commandFormat = msg[4];
+    message.command = msg[5];
+
+    const quint8 *p = msg + 6;
+    message.data.data = p;
+    message.data.length = static_cast<int>(end - p);
+    message.cue.data = message.list.data = message.path.data = message.time.data = p;
+    message.cue.length = message.list.length = message.path.length = message.time.length = 0;
+
+    const Layout layout = layoutOf(message.command);
+    if(layout == LAYOUT_TIME_CUE || layout == LAYOUT_TIME_LIST)
+    {
+        if(end - p < TIME_LENGTH)
+            return true;
+        message.time.length = TIME_LENGTH;
+        p += TIME_LENGTH;
+    }
+
+    switch(layout)
+    {
+    case LAYOUT_CUE:
+    case LAYOUT_TIME_CUE:
+        message.cue = field(p, end);
+        message.list = field(p, end);
+        message.path = field(p, end);
+        break;
+    case LAYOUT_LIST:
+    case LAYOUT_TIME_LIST:
+        message.list = field(p, end);
+        break;
+    case LAYOUT_PATH:
+        message.path = field(p, end);
+        break;
+    case LAYOUT_NONE:
+        break;
+    }
+    return true;
+}
+
+int MscMessage::describe(char *text, int size) const
+{
+    Writer out(text, size);
+
+    const char *name = MscBuilder::commandName(command);
+    if(name)
+        out.append(name);
+    else
+    {
+        out.append("command ");
+        out.hex(command);
+    }
+
+    if(layoutOf(command) == LAYOUT_NONE)
+    {
+        for(int i=0; i<data.length; i++)
+        {
+            out.append(" ");
+            out.hex(data.data[i]);
+        }
+    }
+    else
+    {
+        if(!cue.isEmpty())
+        {
+            out.append(" cue ");
+            out.append(cue);
+        }
+        if(!list.isEmpty())
+        {
+            out.append(" list ");
+            out.append(list);
+        }
+        if(!path.isEmpty())
+        {
+            out.append(" path ");
+            out.append(path);
+        }
+        if(!time.isEmpty())
+        {
+            // The upper bits carry the frame rate and flags
+            out.append(" at ");
+            out.decimal(time.data[0] & 0x1F, 2);
+            out.append(":");
+            out.decimal(time.data[1] & 0x3F, 2);
+            out.append(":");
+            out.decimal(time.data[2] & 0x3F, 2);
+            out.append(":");
+            out.decimal(time.data[3] & 0x1F, 2);
+        }
+    }
+
+    out.append(" - ");
+    const char *format = MscBuilder::formatName(commandFormat);
+    if(format)
+        out.append(format);
+    else
+    {
+        out.append("format ");
+        out.hex(commandFormat);
+    }
+
+    if(deviceId == ALL_CALL)
+        out.append(" - all devices");
+    else
+    {
+        out.append(" - device ");
+        out.decimal(deviceId);
+    }
+    return out.length();
+}
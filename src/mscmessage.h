@@ -0,0 +1,65 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MSCMESSAGE_H
+#define MSCMESSAGE_H
+
+#include <QtGlobal>
+
+// A received MIDI Show Control message, decoded in place
+// Every field points into the buffer that was decoded, so the buffer must
+// outlive the message. Decoding once on the receive thread lets the filter,
+// the log and the display share the result.
+struct MscMessage
+{
+    struct Span
+    {
+        const quint8 *data;
+        int length;
+
+        bool isEmpty() const { return length == 0; }
+        bool equals(const char *text, int textLength) const;
+    };
+
+    // Sent to every device
+    static const quint8 ALL_CALL = 0x7F;
+
+    quint8 deviceId;
+    quint8 commandFormat;
+    quint8 command;
+    Span cue;                   // ASCII numbers as sent, empty when absent
+    Span list;
+    Span path;
+    Span time;                  // hr mn sc fr ff of timed commands
+    Span data;                  // Everything between the command and F7
+
+    // False unless msg is F0 7F <device_ID> 02 <format> <command> ... F7
+    static bool decode(const quint8 *msg, int length, MscMessage &message);
+    static bool isMsc(const quint8 *msg, int length)
+    {
+        return length >= 6 && msg[0] == 0xF0 && msg[1] == 0x7F && msg[3] == 0x02;
+    }
+
+    // e.g. "GO cue 401 list 3 - LIGHTING - device 1", without commas so it
+    // can sit in a log line. Returns the length written.
+    int describe(char *text, int size) const;
+};
+
+#endif // MSCMESSAGE_H
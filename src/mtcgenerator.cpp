@@ -0,0 +1,185 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "mtcgenerator.h"
+#include "metrics.h"
+#include "preciseclock.h"
+#include "txsocket.h"
+#include "realtime.h"
+#include "mididata.h"
+#include <cstring>
+
+// Weight of each new sample in the running jitter average
+static const double AVERAGE_WEIGHT = 1.0 / 32;
+
+// Gives receivers a moment to take the locate before quarter frames start
+static const int START_DELAY_FRAMES = 2;
+
+static inline quint8 quarterFrameData(int piece, const Timecode &tc)
+{
+    int value;
+    switch(piece)
+    {
+    case 0: value = tc.frames & 0x0F; break;
+    case 1: value = tc.frames >> 4; break;
+    case 2: value = tc.seconds & 0x0F; break;
+    case 3: value = tc.seconds >> 4; break;
+    case 4: value = tc.minutes & 0x0F; break;
+    case 5: value = tc.minutes >> 4; break;
+    case 6: value = tc.hours & 0x0F; break;
+    default: value = (tc.rate << 1) | (tc.hours >> 4); break;
+    }
+    return static_cast<quint8>((piece << 4) | (value & 0x0F));
+}
+
+MtcGenerator::MtcGenerator(Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_metrics(metrics),
+    m_stop(false),
+    m_failed(false)
+{
+    State state;
+    state.running = false;
+    state.quarterFrames = 0;
+    state.fullFrames = 0;
+    state.jitterMeanNs = 0;
+    state.jitterMaxNs = 0;
+    state.resyncs = 0;
+    m_published.store(state);
+}
+
+MtcGenerator::~MtcGenerator()
+{
+    stop();
+    wait();
+}
+
+void MtcGenerator::setDestination(const QHostAddress &localAddress, const QHostAddress &address, quint16 port)
+{
+    m_localAddress = localAddress;
+    m_address = address;
+    m_port = port;
+}
+
+void MtcGenerator::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+}
+
+qint64 MtcGenerator::quarterFrameOffsetNs(qint64 index) const
+{
+    // 4 * numerator quarter frames take exactly denominator seconds; split so
+    // the products stay in range for runs of any length
+    const qint64 perPeriod = 4 * Timecode::rateNumerator(m_startPosition.rate);
+    const qint64 periodNs = Timecode::rateDenominator(m_startPosition.rate) * Q_INT64_C(1000000000);
+    return (index / perPeriod) * periodNs + (index % perPeriod) * periodNs / perPeriod;
+}
+
+void MtcGenerator::run()
+{
+    QString refused;
+    if(!Realtime::apply(Realtime::ROLE_SCHEDULER, &refused))
+        emit error(refused);
+
+    TxSocket socket(m_metrics);
+    if(!socket.bind(m_localAddress))
+    {
+        m_failed.store(true, std::memory_order_relaxed);
+        emit error(tr("Error binding MTC socket : %1").arg(socket.errorString()));
+        return;
+    }
+    socket.setDestination(m_address, m_port);
+
+    const Timecode::Rate rate = m_startPosition.rate;
+    const qint64 startFrame = m_startPosition.toFrameNumber();
+    // Full frames go out at the start of a quarter frame set
+    const qint64 fullFrameEvery = ((qint64(m_fullFrameInterval) * Timecode::nominalFps(rate) * 4 + 7) / 8) * 8;
+
+    State state = m_published.load();
+    state.position = m_startPosition;
+    state.running = true;
+    double jitterAverage = 0;
+
+    quint8 fullFrame[sizeof(MidiData::TIMECODE_START) + 5];
+    memcpy(fullFrame, MidiData::TIMECODE_START, sizeof(MidiData::TIMECODE_START));
+    fullFrame[sizeof(fullFrame) - 1] = 0xF7;
+    quint8 *fullFramePosition = fullFrame + sizeof(MidiData::TIMECODE_START);
+
+    qint64 origin = 0;
+    qint64 originIndex = 0;
+    for(qint64 index = 0; !m_stop.load(std::memory_order_relaxed); index++)
+    {
+        const int piece = index & 7;
+        bool sendFullFrame = false;
+        if(piece == 0)
+        {
+            state.position = Timecode::fromFrameNumber(startFrame + (index >> 3) * 2, rate);
+            sendFullFrame = index == 0 || (fullFrameEvery > 0 && index % fullFrameEvery == 0);
+            if(sendFullFrame)
+            {
+                fullFramePosition[0] = static_cast<quint8>((rate << 5) | state.position.hours);
+                fullFramePosition[1] = state.position.minutes;
+                fullFramePosition[2] = state.position.seconds;
+                fullFramePosition[3] = state.position.frames;
+            }
+        }
+
+        if(index == 0)
+        {
+            // Locate first, the schedule starts once receivers have had time to take it
+            socket.send(fullFrame, sizeof(fullFrame));
+            state.fullFrames++;
+            sendFullFrame = false;
+            origin = PreciseClock::nowNs() + Timecode::frameTimeNs(START_DELAY_FRAMES, rate);
+        }
+
+        qint64 deadline = origin + quarterFrameOffsetNs(index - originIndex);
+        const qint64 now = PreciseClock::waitUntilNs(deadline, SPIN_NS);
+
+        if(now - deadline > RESYNC_NS)
+        {
+            // Stalled, e.g. by a suspend; carry on from here rather than burst
+            origin = now;
+            originIndex = index;
+            deadline = now;
+            state.resyncs++;
+        }
+
+        if(sendFullFrame)
+        {
+            socket.send(fullFrame, sizeof(fullFrame));
+            state.fullFrames++;
+        }
+
+        const quint8 quarterFrame[2] = {0xF1, quarterFrameData(piece, state.position)};
+        const qint64 late = PreciseClock::nowNs() - deadline;
+        socket.send(quarterFrame, sizeof(quarterFrame));
+
+        m_metrics->record(Metrics::MTC_SEND_JITTER, late);
+        jitterAverage += (late - jitterAverage) * AVERAGE_WEIGHT;
+        state.jitterMeanNs = static_cast<qint64>(jitterAverage);
+        state.jitterMaxNs = qMax(state.jitterMaxNs, late);
+        state.quarterFrames++;
+        m_published.store(state);
+    }
+
+    state.running = false;
+    m_published.store(state);
+}
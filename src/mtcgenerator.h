@@ -0,0 +1,94 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef MTCGENERATOR_H
+#define MTCGENERATOR_H
+
+#include <QThread>
+#include <QHostAddress>
+#include <atomic>
+#include "timecode.h"
+#include "seqlock.h"
+
+class Metrics;
+
+// Transmits MIDI timecode as a stand-in timecode master
+// Every quarter frame has an absolute deadline computed from the start time
+// with exact rate arithmetic, and the thread sleeps to each deadline on the
+// monotonic clock. Wake-up error therefore shows up as send jitter but never
+// as drift, so the output rate stays on nominal over any length of run.
+class MtcGenerator : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct State
+    {
+        Timecode position;          // Frame encoded by the current quarter frame set
+        bool running;
+        quint64 quarterFrames;
+        quint64 fullFrames;
+        qint64 jitterMeanNs;        // Mean lateness of sends against their deadline
+        qint64 jitterMaxNs;
+        quint64 resyncs;            // Restarts of the schedule after falling badly behind
+    };
+
+    // Wake this far ahead of a deadline and spin the rest, trading a little CPU for jitter
+    static const qint64 SPIN_NS = Q_INT64_C(200000);
+    // Further behind than this the schedule restarts instead of bursting to catch up
+    static const qint64 RESYNC_NS = Q_INT64_C(100000000);
+
+    MtcGenerator(Metrics *metrics, QObject *parent = Q_NULLPTR);
+    ~MtcGenerator();
+
+    // Set before start()
+    void setDestination(const QHostAddress &localAddress, const QHostAddress &address, quint16 port);
+    void setStartPosition(const Timecode &position) { m_startPosition = position; }
+    // Seconds between full frame messages, 0 for only the one at start
+    void setFullFrameInterval(int seconds) { m_fullFrameInterval = seconds; }
+
+    void stop();
+
+    State state(quint32 *version = Q_NULLPTR) const { return m_published.load(version); }
+    // Set when run() gives up, before error() is emitted; other errors are only reports
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+signals:
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    qint64 quarterFrameOffsetNs(qint64 index) const;
+
+    Metrics *m_metrics;
+    QHostAddress m_localAddress;
+    QHostAddress m_address;
+    quint16 m_port = 0;
+    Timecode m_startPosition;
+    int m_fullFrameInterval = 0;
+
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_failed;
+    SeqLock<State> m_published;
+};
+
+#endif // MTCGENERATOR_H
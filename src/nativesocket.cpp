@@ -0,0 +1,213 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "nativesocket.h"
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+    sockaddr_in toSockAddr(quint32 address, quint16 port)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(address);
+        addr.sin_port = htons(port);
+        return addr;
+    }
+
+    QString lastError()
+    {
+#if defined(Q_OS_WIN)
+        return QString("error %1").arg(WSAGetLastError());
+#else
+        return QString::fromLocal8Bit(strerror(errno));
+#endif
+    }
+
+    int bufferSize(NativeSocket::Handle handle, int option)
+    {
+        int bytes = 0;
+        socklen_t length = sizeof(bytes);
+        if(getsockopt(handle, SOL_SOCKET, option, reinterpret_cast<char *>(&bytes), &length) != 0)
+            return 0;
+#if defined(Q_OS_LINUX)
+        // Linux reports double the size set, the rest is its bookkeeping
+        bytes /= 2;
+#endif
+        return bytes;
+    }
+
+    int setBufferSize(NativeSocket::Handle handle, int option, int forceOption, int bytes)
+    {
+        setsockopt(handle, SOL_SOCKET, option, reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+        int granted = bufferSize(handle, option);
+        // Capped by net.core.[rw]mem_max unless the process has CAP_NET_ADMIN
+        if(granted < bytes && forceOption != 0
+                && setsockopt(handle, SOL_SOCKET, forceOption, reinterpret_cast<const char *>(&bytes), sizeof(bytes)) == 0)
+            granted = bufferSize(handle, option);
+        return granted;
+    }
+
+    bool wouldBlock()
+    {
+#if defined(Q_OS_WIN)
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+}
+
+NativeSocket::Handle NativeSocket::open(quint32 address, quint16 port, QString *error)
+{
+#if defined(Q_OS_WIN)
+    static const bool started = []() { WSADATA data; return WSAStartup(MAKEWORD(2, 2), &data) == 0; }();
+    Q_UNUSED(started);
+#endif
+
+    Handle handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(handle == INVALID_HANDLE)
+    {
+        if(error)
+            *error = lastError();
+        return INVALID_HANDLE;
+    }
+
+    // Several sessions may listen on one port for different senders
+    int reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+    bool ok;
+#if defined(Q_OS_WIN)
+    u_long nonBlocking = 1;
+    ok = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+    ok = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+    sockaddr_in addr = toSockAddr(address, port);
+    ok = ok && bind(handle, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0;
+    if(!ok)
+    {
+        if(error)
+            *error = lastError();
+        close(handle);
+        return INVALID_HANDLE;
+    }
+    return handle;
+}
+
+void NativeSocket::close(Handle handle)
+{
+    if(handle == INVALID_HANDLE)
+        return;
+#if defined(Q_OS_WIN)
+    closesocket(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+quint16 NativeSocket::localPort(Handle handle)
+{
+    sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    if(getsockname(handle, reinterpret_cast<sockaddr *>(&addr), &length) != 0)
+        return 0;
+    return ntohs(addr.sin_port);
+}
+
+// Traffic held while the reader is stalled, e.g. by a page fault or the desktop
+static const int BUFFER_HEADROOM_MS = 250;
+static const int DATAGRAM_TRUESIZE = 2048;
+static const int MIN_BUFFER_SIZE = 64 * 1024;
+static const int MAX_BUFFER_SIZE = 256 * 1024 * 1024;
+
+int NativeSocket::bufferSizeFor(int datagramsPerSecond)
+{
+    const qint64 bytes = qint64(datagramsPerSecond) * BUFFER_HEADROOM_MS / 1000 * DATAGRAM_TRUESIZE;
+    return static_cast<int>(qBound<qint64>(MIN_BUFFER_SIZE, bytes, MAX_BUFFER_SIZE));
+}
+
+int NativeSocket::setReceiveBufferSize(Handle handle, int bytes)
+{
+#if defined(Q_OS_LINUX)
+    return setBufferSize(handle, SO_RCVBUF, SO_RCVBUFFORCE, bytes);
+#else
+    return setBufferSize(handle, SO_RCVBUF, 0, bytes);
+#endif
+}
+
+int NativeSocket::setSendBufferSize(Handle handle, int bytes)
+{
+#if defined(Q_OS_LINUX)
+    return setBufferSize(handle, SO_SNDBUF, SO_SNDBUFFORCE, bytes);
+#else
+    return setBufferSize(handle, SO_SNDBUF, 0, bytes);
+#endif
+}
+
+int NativeSocket::receiveBufferSize(Handle handle)
+{
+    return bufferSize(handle, SO_RCVBUF);
+}
+
+int NativeSocket::sendBufferSize(Handle handle)
+{
+    return bufferSize(handle, SO_SNDBUF);
+}
+
+int NativeSocket::receive(Handle handle, char *buffer, int capacity, quint32 *sender, quint16 *senderPort)
+{
+    sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    int size = static_cast<int>(recvfrom(handle, buffer, capacity, 0, reinterpret_cast<sockaddr *>(&addr), &length));
+    if(size < 0)
+        return wouldBlock() ? WOULD_BLOCK : FAILED;
+    *sender = ntohl(addr.sin_addr.s_addr);
+    *senderPort = ntohs(addr.sin_port);
+    return size;
+}
+
+bool NativeSocket::send(Handle handle, const char *data, int length, quint32 address, quint16 port)
+{
+    sockaddr_in addr = toSockAddr(address, port);
+    return sendto(handle, data, length, 0, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == length;
+}
+
+int NativeSocket::poll(PollFd *fds, int count, int timeoutMs)
+{
+#if defined(Q_OS_WIN)
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+#else
+    return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+#endif
+}
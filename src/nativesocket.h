@@ -0,0 +1,85 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef NATIVESOCKET_H
+#define NATIVESOCKET_H
+
+#include <QtGlobal>
+#include <QString>
+
+#if defined(Q_OS_WIN)
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
+// Thin wrapper over the platform's non-blocking IPv4 UDP sockets
+// For sockets serviced from whichever thread is free, where QUdpSocket's
+// thread affinity gets in the way. Addresses are in host byte order.
+namespace NativeSocket
+{
+#if defined(Q_OS_WIN)
+    typedef SOCKET Handle;
+    typedef WSAPOLLFD PollFd;
+    static const Handle INVALID_HANDLE = INVALID_SOCKET;
+#else
+    typedef int Handle;
+    typedef struct pollfd PollFd;
+    static const Handle INVALID_HANDLE = -1;
+#endif
+
+    enum {
+        WOULD_BLOCK = -1,
+        FAILED = -2
+    };
+
+    // Binds to address:port, port 0 for any; returns INVALID_HANDLE on failure
+    Handle open(quint32 address, quint16 port, QString *error = Q_NULLPTR);
+    void close(Handle handle);
+
+    // Port the socket ended up bound to
+    quint16 localPort(Handle handle);
+
+    // Kernel buffer that holds bursts of datagramsPerSecond traffic while the
+    // reader is held up; the kernel charges each small datagram ~2 KB
+    int bufferSizeFor(int datagramsPerSecond);
+    // Asks for a kernel buffer, past the system limit where the process is
+    // allowed to, and returns the usable size granted
+    int setReceiveBufferSize(Handle handle, int bytes);
+    int setSendBufferSize(Handle handle, int bytes);
+    int receiveBufferSize(Handle handle);
+    int sendBufferSize(Handle handle);
+
+    // Size of the datagram received, WOULD_BLOCK or FAILED
+    int receive(Handle handle, char *buffer, int capacity, quint32 *sender, quint16 *senderPort);
+    bool send(Handle handle, const char *data, int length, quint32 address, quint16 port);
+
+    // Waits for any of fds to become readable; the number ready, or -1
+    int poll(PollFd *fds, int count, int timeoutMs);
+    inline void setPollFd(PollFd &fd, Handle handle)
+    {
+        fd.fd = handle;
+        fd.events = POLLIN;
+        fd.revents = 0;
+    }
+    inline bool isReadable(const PollFd &fd) { return fd.revents != 0; }
+}
+
+#endif // NATIVESOCKET_H
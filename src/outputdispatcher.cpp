@@ -0,0 +1,175 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "outputdispatcher.h"
+#include "midioutput.h"
+#include "midistatus.h"
+#include "preciseclock.h"
+#include "realtime.h"
+#include <QMutexLocker>
+#include <cstring>
+
+// Upper bound on a sleep, in case a wake up races with going to sleep
+static const unsigned long POLL_INTERVAL_MS = 50;
+
+OutputDispatcher::OutputDispatcher(Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_metrics(metrics),
+    m_stop(false),
+    m_hasOutput(false),
+    m_playReceived(false),
+    m_playTransmitted(false),
+    m_rxQueue(QUEUE_CAPACITY),
+    m_txQueue(QUEUE_CAPACITY),
+    m_sleeping(false),
+    m_outputGeneration(0)
+{
+}
+
+OutputDispatcher::~OutputDispatcher()
+{
+    stop();
+    wait();
+}
+
+void OutputDispatcher::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+    QMutexLocker lock(&m_mutex);
+    m_wake.wakeOne();
+}
+
+void OutputDispatcher::setOutput(const QSharedPointer<MidiOutput> &output)
+{
+    QMutexLocker lock(&m_mutex);
+    m_pendingOutput = output;
+    m_hasOutput.store(!output.isNull(), std::memory_order_relaxed);
+    m_outputGeneration.fetch_add(1, std::memory_order_release);
+    m_wake.wakeOne();
+}
+
+bool OutputDispatcher::playReceived(const quint8 *msg, int length, qint64 timestamp)
+{
+    if(!m_playReceived.load(std::memory_order_relaxed))
+        return false;
+    return enqueue(m_rxQueue, msg, length, timestamp);
+}
+
+bool OutputDispatcher::playTransmitted(const quint8 *msg, int length, qint64 timestamp)
+{
+    if(!m_playTransmitted.load(std::memory_order_relaxed))
+        return false;
+    return enqueue(m_txQueue, msg, length, timestamp);
+}
+
+bool OutputDispatcher::enqueue(SpscQueue<Event> &queue, const quint8 *msg, int length, qint64 timestamp)
+{
+    if(length < 1 || length > 3 || MidiStatus::kind(msg[0]) == MidiStatus::KIND_SYSEX_START)
+        return false;
+    if(!m_hasOutput.load(std::memory_order_relaxed))
+        return false;
+
+    Event event;
+    event.timestamp = timestamp;
+    event.length = static_cast<quint8>(length);
+    memcpy(event.data, msg, length);
+    if(!queue.push(event))
+    {
+        m_metrics->add(Metrics::OUTPUT_QUEUE_DROPS);
+        return false;
+    }
+
+    // Pairs with the fence in run(), so either the push is seen or the sleeper woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleeping.load(std::memory_order_relaxed))
+    {
+        QMutexLocker lock(&m_mutex);
+        m_wake.wakeOne();
+    }
+    return true;
+}
+
+void OutputDispatcher::refreshOutput()
+{
+    int generation = m_outputGeneration.load(std::memory_order_acquire);
+    if(generation == m_appliedGeneration)
+        return;
+
+    QSharedPointer<MidiOutput> previous;
+    {
+        QMutexLocker lock(&m_mutex);
+        previous = m_output;
+        m_output = m_pendingOutput;
+        m_appliedGeneration = m_outputGeneration.load(std::memory_order_relaxed);
+    }
+    // Closing a device can take a while, so not under the lock
+    previous.clear();
+}
+
+int OutputDispatcher::dispatch(SpscQueue<Event> &queue, Metrics::Histogram latency)
+{
+    int count = 0;
+    Event event;
+    while(queue.pop(event))
+    {
+        count++;
+        if(!m_output)
+            continue;
+
+        const qint64 start = PreciseClock::nowNs();
+        const bool sent = m_output->send(event.data, event.length);
+        const qint64 end = PreciseClock::nowNs();
+        m_metrics->record(Metrics::OUTPUT_DISPATCH_LATENCY, end - start);
+        m_metrics->record(latency, end - event.timestamp);
+        m_metrics->add(sent ? Metrics::OUTPUT_MESSAGES : Metrics::OUTPUT_ERRORS);
+    }
+    return count;
+}
+
+void OutputDispatcher::run()
+{
+    QString refused;
+    if(!Realtime::apply(Realtime::ROLE_OUTPUT, &refused))
+        emit error(refused);
+
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        refreshOutput();
+
+        // Received messages first, they have already waited on the network
+        int count = dispatch(m_rxQueue, Metrics::OUTPUT_RX_LATENCY);
+        count += dispatch(m_txQueue, Metrics::OUTPUT_TX_LATENCY);
+        m_metrics->setGauge(Metrics::OUTPUT_QUEUE_DEPTH, m_rxQueue.size() + m_txQueue.size());
+        if(count > 0)
+            continue;
+
+        m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            QMutexLocker lock(&m_mutex);
+            if(isIdle() && !m_stop.load(std::memory_order_relaxed)
+                    && m_outputGeneration.load(std::memory_order_relaxed) == m_appliedGeneration)
+                m_wake.wait(&m_mutex, POLL_INTERVAL_MS);
+        }
+        m_sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    m_output.clear();
+}
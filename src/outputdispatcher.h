@@ -0,0 +1,103 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef OUTPUTDISPATCHER_H
+#define OUTPUTDISPATCHER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <atomic>
+#include "metrics.h"
+#include "spscqueue.h"
+
+class MidiOutput;
+
+// Plays messages on the local MIDI output from its own thread
+// A slow synth driver then holds up neither the GUI nor the receive thread.
+// Received and transmitted messages each come through their own lock free
+// queue, one per producing thread, together with the time they arrived or
+// were sent, so the whole delay up to the synth is measured.
+class OutputDispatcher : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Event
+    {
+        qint64 timestamp;       // PreciseClock arrival or send time
+        quint8 length;
+        quint8 data[3];
+    };
+
+    static const int QUEUE_CAPACITY = 4096;
+
+    OutputDispatcher(Metrics *metrics, QObject *parent = Q_NULLPTR);
+    ~OutputDispatcher();
+
+    void stop();
+
+    // Thread safe. The previous output is released by the dispatch thread once
+    // it has finished with it; a null output discards everything.
+    void setOutput(const QSharedPointer<MidiOutput> &output);
+    void setPlayReceived(bool enabled) { m_playReceived.store(enabled, std::memory_order_relaxed); }
+    void setPlayTransmitted(bool enabled) { m_playTransmitted.store(enabled, std::memory_order_relaxed); }
+
+    // Producers, the receive thread and the GUI thread respectively. Only short
+    // messages are played; false if the message was not queued.
+    bool playReceived(const quint8 *msg, int length, qint64 timestamp);
+    bool playTransmitted(const quint8 *msg, int length, qint64 timestamp);
+
+signals:
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    bool enqueue(SpscQueue<Event> &queue, const quint8 *msg, int length, qint64 timestamp);
+    void refreshOutput();
+    int dispatch(SpscQueue<Event> &queue, Metrics::Histogram latency);
+    bool isIdle() const { return m_rxQueue.size() == 0 && m_txQueue.size() == 0; }
+
+    Metrics *m_metrics;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_hasOutput;
+    std::atomic<bool> m_playReceived;
+    std::atomic<bool> m_playTransmitted;
+    SpscQueue<Event> m_rxQueue;
+    SpscQueue<Event> m_txQueue;
+
+    // The dispatch thread sleeps on m_wake only after setting m_sleeping
+    std::atomic<bool> m_sleeping;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+
+    // Written by other threads under m_mutex
+    std::atomic<int> m_outputGeneration;
+    QSharedPointer<MidiOutput> m_pendingOutput;
+
+    // Dispatch thread only
+    int m_appliedGeneration = -1;
+    QSharedPointer<MidiOutput> m_output;
+};
+
+#endif // OUTPUTDISPATCHER_H
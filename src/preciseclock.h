@@ -0,0 +1,72 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef PRECISECLOCK_H
+#define PRECISECLOCK_H
+
+#include <QtGlobal>
+#include <chrono>
+#ifdef Q_OS_LINUX
+#include <time.h>
+#include <errno.h>
+#else
+#include <thread>
+#endif
+
+// Monotonic nanosecond clock shared by every timestamp in the pipeline
+namespace PreciseClock
+{
+    inline qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Sleep until an absolute nowNs() time, so wake-up error never accumulates
+    inline void sleepUntilNs(qint64 deadline)
+    {
+#ifdef Q_OS_LINUX
+        // steady_clock is CLOCK_MONOTONIC
+        timespec ts;
+        ts.tv_sec = deadline / 1000000000;
+        ts.tv_nsec = deadline % 1000000000;
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, Q_NULLPTR) == EINTR)
+        {
+        }
+#else
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline))));
+#endif
+    }
+
+    // Sleep to within spinNs of the deadline and spin the rest, returns the wake time
+    inline qint64 waitUntilNs(qint64 deadline, qint64 spinNs)
+    {
+        qint64 now = nowNs();
+        if(deadline - now > spinNs)
+            sleepUntilNs(deadline - spinNs);
+        while((now = nowNs()) < deadline)
+        {
+        }
+        return now;
+    }
+}
+
+#endif // PRECISECLOCK_H
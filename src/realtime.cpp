@@ -0,0 +1,240 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "realtime.h"
+#include "preciseclock.h"
+#include <QThread>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#if defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+static Realtime::Settings s_settings;
+
+// Probe wakeups, long enough to catch a desktop compositor frame or two
+static const int PROBE_WAKEUPS = 500;
+static const qint64 PROBE_PERIOD_NS = 1000000;
+
+bool Realtime::Settings::isDefault() const
+{
+    if(priority > 0 || lockMemory)
+        return false;
+    for(int i=0; i<ROLE_COUNT; i++)
+    {
+        if(cpu[i] >= 0)
+            return false;
+    }
+    return true;
+}
+
+void Realtime::configure(const Settings &settings)
+{
+    s_settings = settings;
+}
+
+const Realtime::Settings &Realtime::settings()
+{
+    return s_settings;
+}
+
+bool Realtime::parseCpus(const QString &text, Settings *settings, QString *error)
+{
+    const QStringList parts = text.split(QChar(','));
+    if(parts.count() > ROLE_COUNT)
+    {
+        if(error)
+            *error = tr("At most %1 cores, one per thread role").arg(ROLE_COUNT);
+        return false;
+    }
+    for(int i=0; i<parts.count(); i++)
+    {
+        const QString part = parts.at(i).trimmed();
+        if(part.isEmpty())
+            continue;
+        bool ok;
+        int cpu = part.toInt(&ok);
+        if(!ok || cpu < -1 || cpu >= QThread::idealThreadCount())
+        {
+            if(error)
+                *error = tr("\"%1\" is not a core between 0 and %2").arg(part).arg(QThread::idealThreadCount() - 1);
+            return false;
+        }
+        settings->cpu[i] = cpu;
+    }
+    return true;
+}
+
+const char *Realtime::roleName(Role role)
+{
+    switch(role)
+    {
+    case ROLE_RECEIVE: return "receive";
+    case ROLE_SCHEDULER: return "scheduler";
+    case ROLE_OUTPUT: return "output";
+    default: return "";
+    }
+}
+
+bool Realtime::apply(Role role, QString *error)
+{
+    QStringList refused;
+    const int cpu = s_settings.cpu[role];
+
+#if defined(Q_OS_LINUX)
+    if(s_settings.priority > 0)
+    {
+        sched_param param;
+        param.sched_priority = qMin(s_settings.priority, MAX_PRIORITY);
+        int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(result != 0)
+            refused << tr("SCHED_FIFO %1 refused (%2)").arg(param.sched_priority).arg(QString::fromLocal8Bit(strerror(result)));
+    }
+    if(cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(result != 0)
+            refused << tr("CPU %1 refused (%2)").arg(cpu).arg(QString::fromLocal8Bit(strerror(result)));
+    }
+#elif defined(Q_OS_WIN)
+    // The nearest Windows has to SCHED_FIFO within a normal priority class
+    if(s_settings.priority > 0 && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+        refused << tr("Time critical priority refused (error %1)").arg(GetLastError());
+    if(cpu >= 0 && !SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu))
+        refused << tr("CPU %1 refused (error %2)").arg(cpu).arg(GetLastError());
+#else
+    if(s_settings.priority > 0)
+        refused << tr("SCHED_FIFO is not supported on this platform");
+    if(cpu >= 0)
+        refused << tr("CPU affinity is not supported on this platform");
+#endif
+
+    if(refused.isEmpty())
+        return true;
+    if(error)
+        *error = tr("%1 thread: %2").arg(QLatin1String(roleName(role))).arg(refused.join(QStringLiteral(", ")));
+    return false;
+}
+
+// Applies a role's settings and wakes up at fixed absolute deadlines
+class RealtimeProbe : public QThread
+{
+public:
+    explicit RealtimeProbe(Realtime::Role role) : m_role(role), m_granted(false) {}
+
+    Realtime::Role role() const { return m_role; }
+    bool granted() const { return m_granted; }
+    const QString &error() const { return m_error; }
+    const QVector<qint64> &lateness() const { return m_lateness; }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        m_granted = Realtime::apply(m_role, &m_error);
+        m_lateness.reserve(PROBE_WAKEUPS);
+
+        qint64 deadline = PreciseClock::nowNs() + PROBE_PERIOD_NS;
+        for(int i=0; i<PROBE_WAKEUPS; i++)
+        {
+            PreciseClock::sleepUntilNs(deadline);
+            m_lateness.append(PreciseClock::nowNs() - deadline);
+            deadline += PROBE_PERIOD_NS;
+        }
+    }
+
+private:
+    const Realtime::Role m_role;
+    bool m_granted;
+    QString m_error;
+    QVector<qint64> m_lateness;
+};
+
+QString Realtime::selfCheck(bool *granted)
+{
+    QStringList report;
+    bool allGranted = true;
+
+    if(s_settings.lockMemory)
+    {
+#if defined(Q_OS_LINUX)
+        if(mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+            report << tr("Memory locked");
+        else
+        {
+            report << tr("Memory lock refused (%1)").arg(QString::fromLocal8Bit(strerror(errno)));
+            allGranted = false;
+        }
+#else
+        report << tr("Memory locking is not supported on this platform");
+        allGranted = false;
+#endif
+    }
+
+    // All roles at once, so threads sharing a core compete as they would in use
+    RealtimeProbe *probes[ROLE_COUNT];
+    for(int i=0; i<ROLE_COUNT; i++)
+    {
+        probes[i] = new RealtimeProbe(static_cast<Role>(i));
+        probes[i]->start();
+    }
+    for(int i=0; i<ROLE_COUNT; i++)
+    {
+        RealtimeProbe *probe = probes[i];
+        probe->wait();
+
+        QVector<qint64> lateness = probe->lateness();
+        std::sort(lateness.begin(), lateness.end());
+        qint64 total = 0;
+        foreach(qint64 value, lateness)
+            total += value;
+
+        QString result = probe->error();
+        if(probe->granted())
+        {
+            const int cpu = s_settings.cpu[i];
+            result = tr("%1 thread: %2, %3")
+                    .arg(QLatin1String(roleName(static_cast<Role>(i))))
+                    .arg(s_settings.priority > 0 ? tr("SCHED_FIFO %1").arg(s_settings.priority) : tr("default priority"))
+                    .arg(cpu >= 0 ? tr("CPU %1").arg(cpu) : tr("any CPU"));
+        }
+        report << tr("%1; wakeup lateness mean %2 us, p99 %3 us, max %4 us")
+                  .arg(result)
+                  .arg(total / lateness.count() / 1000.0, 0, 'f', 1)
+                  .arg(lateness.at(lateness.count() * 99 / 100) / 1000.0, 0, 'f', 1)
+                  .arg(lateness.last() / 1000.0, 0, 'f', 1);
+        if(!probe->granted())
+            allGranted = false;
+        delete probe;
+    }
+
+    if(granted)
+        *granted = allGranted;
+    return report.join(QChar('\n'));
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QCoreApplication>
+
+// Real-time scheduling, CPU affinity and memory locking for timing critical threads
+// Settings are made once at startup. Each thread applies those of its role
+// when it starts, and selfCheck() reports what the OS actually granted and
+// how late periodic wakeups are under the chosen setup.
+class Realtime
+{
+    Q_DECLARE_TR_FUNCTIONS(Realtime)
+
+public:
+    enum Role {
+        ROLE_RECEIVE,
+        ROLE_SCHEDULER,     // Also the MTC and clock generators and the MIDI input bridge
+        ROLE_OUTPUT,
+        ROLE_COUNT
+    };
+
+    struct Settings
+    {
+        int priority = 0;                       // SCHED_FIFO priority 1-99, 0 for the OS default
+        int cpu[ROLE_COUNT] = {-1, -1, -1};     // Core each role is pinned to, -1 for any
+        bool lockMemory = false;                // mlockall current and future pages
+
+        bool isDefault() const;
+    };
+
+    static const int MAX_PRIORITY = 99;
+
+    // Before any thread is started
+    static void configure(const Settings &settings);
+    static const Settings &settings();
+
+    // Comma separated cores in role order, e.g. "2,3,1"; empty or -1 for any
+    static bool parseCpus(const QString &text, Settings *settings, QString *error);
+    static const char *roleName(Role role);
+
+    // Called by a thread on entry. False with error set if anything was refused.
+    static bool apply(Role role, QString *error = Q_NULLPTR);
+
+    // Locks memory if asked, then runs a probe thread per role for a moment
+    // and measures its wakeup lateness. Returns a report, one line per item.
+    static QString selfCheck(bool *granted);
+};
+
+#endif // REALTIME_H
@@ -0,0 +1,476 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rxfilter.h"
+#include "mscmessage.h"
+#include "midistatus.h"
+#include "mscbuilder.h"
+#include <QHostAddress>
+#include <QStringList>
+#include <cstring>
+
+class RxFilter::Compiler
+{
+public:
+    Compiler(RxFilter &filter, const QStringList &tokens) :
+        m_filter(filter),
+        m_tokens(tokens)
+    {}
+
+    bool run(Code &code)
+    {
+        code = parseExpression();
+        if(!m_error.isEmpty())
+            return false;
+        if(m_pos < m_tokens.count())
+            return fail(tr("Unexpected '%1'").arg(m_tokens[m_pos]));
+        return true;
+    }
+
+    QString error() const { return m_error; }
+
+private:
+    bool atEnd() const { return m_pos >= m_tokens.count(); }
+    QString peek() const { return atEnd() ? QString() : m_tokens[m_pos].toLower(); }
+    QString next() { return atEnd() ? QString() : m_tokens[m_pos++].toLower(); }
+
+    bool fail(const QString &message)
+    {
+        if(m_error.isEmpty())
+            m_error = message;
+        return false;
+    }
+
+    Code parseExpression()
+    {
+        Code left = parseTerm();
+        while(m_error.isEmpty() && (peek() == "or" || peek() == "||"))
+        {
+            next();
+            left = combine(left, parseTerm(), OP_OR);
+        }
+        return left;
+    }
+
+    Code parseTerm()
+    {
+        Code left = parseFactor();
+        while(m_error.isEmpty() && (peek() == "and" || peek() == "&&"))
+        {
+            next();
+            left = combine(left, parseFactor(), OP_AND);
+        }
+        return left;
+    }
+
+    Code parseFactor()
+    {
+        if(atEnd())
+        {
+            fail(tr("Expression is incomplete"));
+            return Code();
+        }
+
+        QString token = peek();
+        if(token == "not" || token == "!")
+        {
+            next();
+            Code operand = parseFactor();
+            if(isSingleStatus(operand))
+            {
+                // Fold into the table
+                StatusSet &set = m_filter.m_statusSets[operand[0].operand];
+                for(int i=0; i<4; i++)
+                    set.bits[i] = ~set.bits[i];
+                return operand;
+            }
+            operand << instruction(OP_NOT);
+            return operand;
+        }
+
+        if(token == "(")
+        {
+            next();
+            Code inner = parseExpression();
+            if(next() != ")")
+                fail(tr("Missing ')'"));
+            return inner;
+        }
+
+        return parsePredicate();
+    }
+
+    Code parsePredicate()
+    {
+        QString keyword = next();
+        Code code;
+
+        if(keyword == "sender" || keyword == "from")
+        {
+            QString address = next();
+            QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(address.contains('/') ? address : address + "/32");
+            if(subnet.first.protocol() != QAbstractSocket::IPv4Protocol || subnet.second < 0)
+            {
+                fail(tr("'%1' is not an IPv4 address or subnet").arg(address));
+                return code;
+            }
+            Instruction ins = instruction(OP_SENDER);
+            ins.mask = subnet.second == 0 ? 0 : ~quint32(0) << (32 - subnet.second);
+            ins.operand = subnet.first.toIPv4Address() & ins.mask;
+            code << ins;
+        }
+        else if(keyword == "status")
+        {
+            int lo, hi;
+            if(!parseRange(16, 0x80, 0xFF, lo, hi))
+                return code;
+            StatusSet set = emptySet();
+            for(int s=lo; s<=hi; s++)
+                set.set(static_cast<quint8>(s));
+            code << statusInstruction(set);
+        }
+        else if(keyword == "type")
+        {
+            QString name = next();
+            StatusSet set = emptySet();
+            bool found = false;
+            for(int s=0x80; s<=0xFF; s++)
+            {
+                if(name.compare(QLatin1String(MidiStatus::mnemonic(static_cast<quint8>(s))), Qt::CaseInsensitive) == 0)
+                {
+                    set.set(static_cast<quint8>(s));
+                    found = true;
+                }
+            }
+            if(!found)
+            {
+                fail(tr("'%1' is not a message type").arg(name));
+                return code;
+            }
+            code << statusInstruction(set);
+        }
+        else if(keyword == "channel")
+        {
+            int lo, hi;
+            if(!parseRange(10, 1, 16, lo, hi))
+                return code;
+            StatusSet set = emptySet();
+            for(int s=0x80; s<=0xFF; s++)
+            {
+                if(MidiStatus::kind(static_cast<quint8>(s)) != MidiStatus::KIND_CHANNEL)
+                    continue;
+                int channel = (s & 0x0F) + 1;
+                if(channel >= lo && channel <= hi)
+                    set.set(static_cast<quint8>(s));
+            }
+            code << statusInstruction(set);
+        }
+        else if(keyword == "note")
+        {
+            int lo, hi;
+            if(!parseRange(10, 0, 127, lo, hi))
+                return code;
+            Instruction ins = instruction(OP_NOTE);
+            ins.lo = static_cast<quint8>(lo);
+            ins.hi = static_cast<quint8>(hi);
+            code << ins;
+        }
+        else if(keyword == "sysex")
+        {
+            QByteArray prefix;
+            while(!atEnd())
+            {
+                bool ok = false;
+                uint value = m_tokens[m_pos].toUInt(&ok, 16);
+                if(!ok || value > 0xFF)
+                    break;
+                prefix.append(static_cast<char>(value));
+                m_pos++;
+            }
+            if(prefix.isEmpty() || static_cast<quint8>(prefix[0]) != 0xF0)
+                prefix.prepend(static_cast<char>(0xF0));
+            if(prefix.size() > 0xFF)
+            {
+                fail(tr("SysEx prefix is too long"));
+                return code;
+            }
+            Instruction ins = instruction(OP_SYSEX_PREFIX);
+            ins.operand = static_cast<quint32>(m_filter.m_constants.size());
+            ins.lo = static_cast<quint8>(prefix.size());
+            m_filter.m_constants.append(prefix);
+            code << ins;
+        }
+        else if(keyword == "msc")
+        {
+            Instruction ins = instruction(OP_MSC);
+            int command = atEnd() ? -1 : mscCommand(peek());
+            if(command >= 0)
+            {
+                next();
+                ins.lo = static_cast<quint8>(command);
+                ins.hi = 1;
+            }
+            code << ins;
+
+            static const char *const fields[] = { "cue", "list", "path" };
+            bool more = true;
+            while(more && m_error.isEmpty())
+            {
+                more = false;
+                for(int f=0; f<3 && !more; f++)
+                {
+                    if(peek() != QLatin1String(fields[f]))
+                        continue;
+                    next();
+                    QByteArray number = next().toLatin1();
+                    if(number.isEmpty() || number.size() > 0xFF || number.contains('/'))
+                    {
+                        fail(tr("'%1' is not a cue number").arg(QString::fromLatin1(number)));
+                        return code;
+                    }
+                    Instruction field = instruction(OP_MSC_NUMBER);
+                    field.lo = static_cast<quint8>(f);
+                    field.hi = static_cast<quint8>(number.size());
+                    field.operand = static_cast<quint32>(m_filter.m_constants.size());
+                    m_filter.m_constants.append(number);
+                    code << field << instruction(OP_AND);
+                    more = true;
+                }
+            }
+        }
+        else if(keyword.isEmpty())
+            fail(tr("Expression is incomplete"));
+        else
+            fail(tr("Unknown filter term '%1'").arg(keyword));
+
+        return code;
+    }
+
+    bool parseRange(int base, int min, int max, int &lo, int &hi)
+    {
+        QString text = next();
+        QStringList parts = text.split('-');
+        bool ok = parts.count() <= 2;
+        if(ok)
+        {
+            bool okLo = false;
+            bool okHi = false;
+            lo = parseNumber(parts[0], base, &okLo);
+            hi = parts.count() == 2 ? parseNumber(parts[1], base, &okHi) : lo;
+            ok = okLo && (parts.count() == 1 || okHi);
+        }
+        if(!ok || lo < min || hi > max || lo > hi)
+            return fail(tr("'%1' is not a valid range").arg(text));
+        return true;
+    }
+
+    static int parseNumber(QString text, int base, bool *ok)
+    {
+        if(text.startsWith("0x"))
+        {
+            text = text.mid(2);
+            base = 16;
+        }
+        return text.toInt(ok, base);
+    }
+
+    static int mscCommand(const QString &token)
+    {
+        int command = MscBuilder::commandFromName(token);
+        if(command >= 0)
+            return command;
+
+        bool ok = false;
+        int value = parseNumber(token, 16, &ok);
+        return ok && value >= 0 && value <= 0x7F ? value : -1;
+    }
+
+    static Instruction instruction(OpCode op)
+    {
+        Instruction ins;
+        memset(&ins, 0, sizeof(ins));
+        ins.op = static_cast<quint8>(op);
+        return ins;
+    }
+
+    static StatusSet emptySet()
+    {
+        StatusSet set;
+        memset(&set, 0, sizeof(set));
+        return set;
+    }
+
+    Instruction statusInstruction(const StatusSet &set)
+    {
+        Instruction ins = instruction(OP_STATUS);
+        ins.operand = static_cast<quint32>(m_filter.m_statusSets.count());
+        m_filter.m_statusSets << set;
+        return ins;
+    }
+
+    static bool isSingleStatus(const Code &code)
+    {
+        return code.count() == 1 && code[0].op == OP_STATUS;
+    }
+
+    Code combine(Code left, const Code &right, OpCode op)
+    {
+        if(!m_error.isEmpty())
+            return left;
+
+        if(isSingleStatus(left) && isSingleStatus(right))
+        {
+            StatusSet &target = m_filter.m_statusSets[left[0].operand];
+            const StatusSet &other = m_filter.m_statusSets[right[0].operand];
+            for(int i=0; i<4; i++)
+                target.bits[i] = op == OP_AND ? (target.bits[i] & other.bits[i]) : (target.bits[i] | other.bits[i]);
+            return left;
+        }
+
+        left << right << instruction(op);
+        return left;
+    }
+
+    RxFilter &m_filter;
+    const QStringList m_tokens;
+    int m_pos = 0;
+    QString m_error;
+};
+
+static QStringList tokenize(QString expression)
+{
+    expression.replace(QLatin1String("&&"), QLatin1String(" && "));
+    expression.replace(QLatin1String("||"), QLatin1String(" || "));
+
+    QStringList tokens;
+    QString current;
+    for(int i=0; i<expression.length(); i++)
+    {
+        QChar c = expression[i];
+        if(c.isSpace() || c == '(' || c == ')' || c == '!')
+        {
+            if(!current.isEmpty())
+                tokens << current;
+            current.clear();
+            if(!c.isSpace())
+                tokens << QString(c);
+        }
+        else
+            current.append(c);
+    }
+    if(!current.isEmpty())
+        tokens << current;
+    return tokens;
+}
+
+bool RxFilter::compile(const QString &expression, QString *errorString)
+{
+    RxFilter result;
+    QStringList tokens = tokenize(expression);
+    if(!tokens.isEmpty())
+    {
+        Compiler compiler(result, tokens);
+        Code code;
+        if(!compiler.run(code))
+        {
+            if(errorString)
+                *errorString = compiler.error();
+            return false;
+        }
+
+        // Status sets dropped by folding are left in place, they are only referenced by index
+        result.m_code = code;
+
+        int depth = 0;
+        for(int i=0; i<code.count(); i++)
+        {
+            if(code[i].op == OP_AND || code[i].op == OP_OR)
+                depth--;
+            else if(code[i].op != OP_NOT)
+                depth++;
+            if(depth > MAX_STACK_DEPTH)
+            {
+                if(errorString)
+                    *errorString = tr("Expression is too complex");
+                return false;
+            }
+        }
+    }
+
+    *this = result;
+    return true;
+}
+
+static const MscMessage::Span &mscNumber(const MscMessage &msc, int field)
+{
+    return field == 0 ? msc.cue : field == 1 ? msc.list : msc.path;
+}
+
+bool RxFilter::matches(quint32 sender, const quint8 *msg, int length, const MscMessage *msc) const
+{
+    if(m_code.isEmpty())
+        return true;
+
+    bool stack[MAX_STACK_DEPTH];
+    int top = -1;
+    const quint8 status = length > 0 ? msg[0] : 0;
+
+    const Instruction *ins = m_code.constData();
+    const Instruction *end = ins + m_code.count();
+    for(; ins != end; ins++)
+    {
+        switch(ins->op)
+        {
+        case OP_STATUS:
+            stack[++top] = length > 0 && m_statusSets.at(ins->operand).test(status);
+            break;
+        case OP_SENDER:
+            stack[++top] = (sender & ins->mask) == ins->operand;
+            break;
+        case OP_NOTE:
+            stack[++top] = length > 1 && MidiStatus::kind(status) == MidiStatus::KIND_CHANNEL && status < 0xB0
+                    && msg[1] >= ins->lo && msg[1] <= ins->hi;
+            break;
+        case OP_SYSEX_PREFIX:
+            stack[++top] = length >= ins->lo
+                    && memcmp(msg, m_constants.constData() + ins->operand, ins->lo) == 0;
+            break;
+        case OP_MSC:
+            stack[++top] = msc && (ins->hi == 0 || msc->command == ins->lo);
+            break;
+        case OP_MSC_NUMBER:
+            stack[++top] = msc && mscNumber(*msc, ins->lo).equals(m_constants.constData() + ins->operand, ins->hi);
+            break;
+        case OP_AND:
+            top--;
+            stack[top] = stack[top] && stack[top + 1];
+            break;
+        case OP_OR:
+            top--;
+            stack[top] = stack[top] || stack[top + 1];
+            break;
+        case OP_NOT:
+            stack[top] = !stack[top];
+            break;
+        }
+    }
+
+    return stack[0];
+}
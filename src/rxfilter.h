@@ -0,0 +1,105 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RXFILTER_H
+#define RXFILTER_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <QCoreApplication>
+
+struct MscMessage;
+
+// Receive filter, compiled once from an expression and evaluated per message
+//
+// Predicates:
+//   sender <ip>[/<prefix>]      sender address or subnet
+//   status <hex>[-<hex>]        status byte or range, e.g. status 90-9F
+//   type <name>                 message type, e.g. type noteon, type clock (see midistatus.h)
+//   channel <n>[-<m>]           channel messages on channels 1-16
+//   note <n>[-<m>]              note on/off/key pressure for notes 0-127
+//   sysex [<hex> ...]           system exclusive starting with these bytes
+//   msc [<command>]             MIDI Show Control, optionally one command (go, stop, 01...)
+//       [cue <n>] [list <n>] [path <n>]   and cue numbers, e.g. msc go list 3
+// combined with and / or / not (also && || !) and parentheses.
+//
+// The expression becomes postfix bytecode over a small boolean stack. Any
+// status or channel terms joined by and/or/not are folded into a single
+// 256 entry status byte table, so they cost one lookup at run time.
+class RxFilter
+{
+    Q_DECLARE_TR_FUNCTIONS(RxFilter)
+
+public:
+    static const int MAX_STACK_DEPTH = 32;
+
+    RxFilter() {}
+
+    // An empty expression compiles to a filter that passes everything
+    bool compile(const QString &expression, QString *errorString = Q_NULLPTR);
+
+    bool isEmpty() const { return m_code.isEmpty(); }
+    int instructionCount() const { return m_code.count(); }
+
+    // msc is the message already decoded, null if it is not Show Control
+    bool matches(quint32 sender, const quint8 *msg, int length, const MscMessage *msc) const;
+
+private:
+    enum OpCode {
+        OP_STATUS,          // operand indexes m_statusSets
+        OP_SENDER,          // (sender & mask) == operand
+        OP_NOTE,            // data byte 1 within lo..hi on a note message
+        OP_SYSEX_PREFIX,    // operand is an offset in m_constants, lo the length
+        OP_MSC,             // any MSC when hi is 0, otherwise command byte lo
+        OP_MSC_NUMBER,      // MSC cue, list or path (lo 0-2) equal to hi bytes at operand in m_constants
+        OP_AND,
+        OP_OR,
+        OP_NOT
+    };
+
+    struct Instruction
+    {
+        quint8 op;
+        quint8 lo;
+        quint8 hi;
+        quint8 reserved;
+        quint32 operand;
+        quint32 mask;
+    };
+
+    struct StatusSet
+    {
+        quint64 bits[4];
+        bool test(quint8 status) const { return (bits[status >> 6] >> (status & 63)) & 1; }
+        void set(quint8 status) { bits[status >> 6] |= Q_UINT64_C(1) << (status & 63); }
+    };
+
+    typedef QVector<Instruction> Code;
+
+    class Compiler;
+
+    Code m_code;
+    QVector<StatusSet> m_statusSets;
+    QByteArray m_constants;
+};
+
+#endif // RXFILTER_H
@@ -0,0 +1,72 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+
+// Single writer, many reader snapshot of a trivially copyable value
+// The writer never waits; readers retry if they raced with a store. Used to
+// publish state from real time threads for the GUI to sample once per frame.
+template <typename T>
+class SeqLock
+{
+public:
+    SeqLock() : m_sequence(0), m_value() {}
+
+    void store(const T &value)
+    {
+        quint32 sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&m_value, &value, sizeof(T));
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load(quint32 *version = Q_NULLPTR) const
+    {
+        T value;
+        quint32 before;
+        quint32 after;
+        do
+        {
+            before = m_sequence.load(std::memory_order_acquire);
+            memcpy(&value, &m_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while((before & 1) || before != after);
+
+        if(version)
+            *version = after;
+        return value;
+    }
+
+    // Changes on every store
+    quint32 version() const { return m_sequence.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<quint32> m_sequence;
+    T m_value;
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,151 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "session.h"
+#include "sessionmanager.h"
+#include "mscmessage.h"
+#include "preciseclock.h"
+
+Session::Session(const Config &config) :
+    m_config(config),
+    m_handle(NativeSocket::INVALID_HANDLE),
+    m_localPort(0),
+    m_queue(QUEUE_CAPACITY),
+    m_busy(false),
+    m_manager(Q_NULLPTR)
+{
+    m_logLine.reserve(UdpMidi::encodedLength(UdpMidi::MAX_MESSAGE_LENGTH) + 64);
+}
+
+Session::~Session()
+{
+    if(m_handle != NativeSocket::INVALID_HANDLE)
+        NativeSocket::close(m_handle);
+    if(m_logWriter)
+    {
+        m_logWriter->stop();
+        m_logWriter->wait();
+    }
+}
+
+bool Session::open(QString *error)
+{
+    m_handle = NativeSocket::open(m_config.address, m_config.port, error);
+    if(m_handle == NativeSocket::INVALID_HANDLE)
+        return false;
+    m_localPort = NativeSocket::localPort(m_handle);
+
+    if(!m_config.logBaseName.isEmpty())
+    {
+        m_logWriter.reset(new LogWriter(m_config.logBaseName, m_config.logPolicy, &m_metrics));
+        m_logWriter->start(QThread::LowPriority);
+    }
+    return true;
+}
+
+void Session::push(const UdpReceiver::Event &event)
+{
+    if(!m_queue.push(event))
+        m_metrics.add(Metrics::RX_QUEUE_DROPS);
+}
+
+void Session::run()
+{
+    for(int i=0; i<DATAGRAM_BUDGET; i++)
+    {
+        quint32 sender;
+        quint16 senderPort;
+        const int length = NativeSocket::receive(m_handle, m_datagram, sizeof(m_datagram), &sender, &senderPort);
+        if(length < 0)
+            break;
+        const qint64 timestamp = PreciseClock::nowNs();
+
+        m_metrics.add(Metrics::RX_SYSCALLS);
+        m_metrics.add(Metrics::RX_DATAGRAMS);
+        m_metrics.add(Metrics::RX_BYTES, length);
+
+        int invalidTokens = 0;
+        const int midiLength = UdpMidi::decode(m_datagram, length, m_midi, sizeof(m_midi), &invalidTokens);
+        if(invalidTokens > 0)
+            m_metrics.add(Metrics::RX_PARSE_ERRORS, invalidTokens);
+        if(midiLength > 0)
+        {
+            MidiStreamParser &parser = m_parsers.parserFor(sender, senderPort);
+            const quint64 errors = parser.errors();
+            const int storedLength = qMin(midiLength, UdpMidi::MAX_MESSAGE_LENGTH);
+            bool logged = false;
+
+            auto handleMessage = [&](const quint8 *msg, int msgLength)
+            {
+                m_metrics.add(Metrics::RX_MESSAGES);
+
+                MscMessage msc;
+                const MscMessage *decodedMsc = MscMessage::decode(msg, msgLength, msc) ? &msc : Q_NULLPTR;
+                if(m_logWriter && !logged)
+                {
+                    UdpReceiver::formatLogLine(m_logLine, sender, m_datagram, length, decodedMsc);
+                    m_logWriter->append(m_logLine);
+                    logged = true;
+                }
+
+                UdpReceiver::Event event;
+                event.timestamp = timestamp;
+                event.record.address = sender;
+                event.record.port = senderPort;
+                event.record.set(msg, msgLength, MessageRecord::FLAG_MIDI | MessageRecord::FLAG_DISPLAY);
+                if(decodedMsc)
+                    event.record.flags |= MessageRecord::FLAG_MSC;
+                push(event);
+            };
+            parser.parse(m_midi, storedLength, handleMessage);
+
+            if(midiLength > storedLength)
+            {
+                parser.reset();
+                m_metrics.add(Metrics::RX_PARSE_ERRORS);
+            }
+            m_metrics.add(Metrics::RX_PARSE_ERRORS, parser.errors() - errors);
+        }
+        else
+        {
+            m_metrics.add(Metrics::RX_PARSE_ERRORS);
+            if(m_logWriter)
+            {
+                UdpReceiver::formatLogLine(m_logLine, sender, m_datagram, length, Q_NULLPTR);
+                m_logWriter->append(m_logLine);
+            }
+
+            UdpReceiver::Event event;
+            event.timestamp = timestamp;
+            event.record.address = sender;
+            event.record.port = senderPort;
+            event.record.set(m_datagram, length, MessageRecord::FLAG_DISPLAY);
+            push(event);
+        }
+
+        m_metrics.record(Metrics::RX_PROCESSING_TIME, PreciseClock::nowNs() - timestamp);
+    }
+    m_metrics.setGauge(Metrics::RX_QUEUE_DEPTH, m_queue.size());
+
+    // The manager may delete the session as soon as it is no longer busy
+    SessionManager *manager = m_manager;
+    m_busy.store(false, std::memory_order_release);
+    manager->wake();
+}
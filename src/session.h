@@ -0,0 +1,101 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <QString>
+#include <QScopedPointer>
+#include <atomic>
+#include "logwriter.h"
+#include "metrics.h"
+#include "midistreamparser.h"
+#include "nativesocket.h"
+#include "spscqueue.h"
+#include "udpmidi.h"
+#include "udpreceiver.h"
+#include "workstealingpool.h"
+
+class SessionManager;
+
+// One receive-only gateway session run by a SessionManager
+// Each session has its own socket, sender stream state, counters and
+// optional log. It holds no thread: whenever its socket is readable the
+// manager hands it to the shared pool, where it drains a bounded batch of
+// datagrams and goes back to waiting. Events are collected by the GUI
+// thread the same way as the main receiver's.
+class Session : public WorkStealingPool::Task
+{
+public:
+    struct Config
+    {
+        QString name;
+        quint32 address = 0;        // IPv4 bind address, host byte order
+        quint16 port = 0;
+        QString logBaseName;        // Empty for no log
+        LogRotationPolicy logPolicy;
+    };
+
+    static const int QUEUE_CAPACITY = 8192;
+    // Datagrams handled per run, so one busy session can't hold a worker
+    static const int DATAGRAM_BUDGET = 64;
+
+    explicit Session(const Config &config);
+    ~Session();
+
+    bool open(QString *error);
+
+    const Config &config() const { return m_config; }
+    quint16 localPort() const { return m_localPort; }
+    NativeSocket::Handle handle() const { return m_handle; }
+    const Metrics &metrics() const { return m_metrics; }
+    LogWriter *logWriter() const { return m_logWriter.data(); }
+
+    // GUI thread, until it returns false
+    bool takeEvent(UdpReceiver::Event &event) { return m_queue.pop(event); }
+
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    friend class SessionManager;
+
+    void push(const UdpReceiver::Event &event);
+
+    const Config m_config;
+    NativeSocket::Handle m_handle;
+    quint16 m_localPort;
+    Metrics m_metrics;
+    SpscQueue<UdpReceiver::Event> m_queue;
+    QScopedPointer<LogWriter> m_logWriter;
+
+    // Only touched by whichever worker is running the session
+    MidiSourceParsers m_parsers;
+    QByteArray m_logLine;
+    char m_datagram[65536];
+    quint8 m_midi[UdpMidi::MAX_MESSAGE_LENGTH];
+
+    // Set by the manager when it submits the session, cleared when run ends
+    std::atomic<bool> m_busy;
+    SessionManager *m_manager;
+
+    Q_DISABLE_COPY(Session)
+};
+
+#endif // SESSION_H
@@ -0,0 +1,147 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "sessionmanager.h"
+#include <QMutexLocker>
+
+static const quint32 LOOPBACK = 0x7F000001;
+
+SessionManager::SessionManager(QObject *parent) :
+    QThread(parent),
+    m_pool(new WorkStealingPool),
+    m_wakePort(0),
+    m_stop(false)
+{
+    m_wakeHandle = NativeSocket::open(LOOPBACK, 0);
+    if(m_wakeHandle != NativeSocket::INVALID_HANDLE)
+        m_wakePort = NativeSocket::localPort(m_wakeHandle);
+}
+
+SessionManager::~SessionManager()
+{
+    stop();
+    wait();
+
+    // Workers may still be finishing a batch
+    foreach(Session *session, m_sessions)
+    {
+        while(session->m_busy.load(std::memory_order_acquire))
+            QThread::yieldCurrentThread();
+        delete session;
+    }
+    // A worker that just cleared busy may still be waking the poller
+    delete m_pool;
+    if(m_wakeHandle != NativeSocket::INVALID_HANDLE)
+        NativeSocket::close(m_wakeHandle);
+}
+
+void SessionManager::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+    wake();
+}
+
+Session *SessionManager::add(const Session::Config &config, QString *error)
+{
+    Session *session = new Session(config);
+    if(!session->open(error))
+    {
+        delete session;
+        return Q_NULLPTR;
+    }
+    session->m_manager = this;
+
+    QMutexLocker lock(&m_mutex);
+    m_sessions.append(session);
+    lock.unlock();
+    wake();
+    return session;
+}
+
+void SessionManager::remove(Session *session)
+{
+    QMutexLocker lock(&m_mutex);
+    if(!m_sessions.removeOne(session))
+        return;
+    lock.unlock();
+
+    // No longer listed, so the poller won't submit it again
+    while(session->m_busy.load(std::memory_order_acquire))
+        QThread::yieldCurrentThread();
+    delete session;
+    wake();
+}
+
+void SessionManager::wake()
+{
+    if(m_wakeHandle != NativeSocket::INVALID_HANDLE)
+        NativeSocket::send(m_wakeHandle, "w", 1, LOOPBACK, m_wakePort);
+}
+
+void SessionManager::run()
+{
+    QVector<NativeSocket::PollFd> fds;
+    QVector<Session *> polled;
+    char drain[16];
+
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        fds.resize(0);
+        polled.resize(0);
+
+        NativeSocket::PollFd wakeFd;
+        NativeSocket::setPollFd(wakeFd, m_wakeHandle);
+        fds.append(wakeFd);
+
+        m_mutex.lock();
+        foreach(Session *session, m_sessions)
+        {
+            if(session->m_busy.load(std::memory_order_acquire))
+                continue;
+            NativeSocket::PollFd fd;
+            NativeSocket::setPollFd(fd, session->handle());
+            fds.append(fd);
+            polled.append(session);
+        }
+        m_mutex.unlock();
+
+        if(NativeSocket::poll(fds.data(), fds.count(), POLL_INTERVAL_MS) <= 0)
+            continue;
+
+        if(NativeSocket::isReadable(fds.at(0)))
+        {
+            quint32 sender;
+            quint16 senderPort;
+            while(NativeSocket::receive(m_wakeHandle, drain, sizeof(drain), &sender, &senderPort) >= 0)
+                ;
+        }
+
+        // Sessions removed while polling are skipped
+        QMutexLocker lock(&m_mutex);
+        for(int i=0; i<polled.count(); i++)
+        {
+            Session *session = polled.at(i);
+            if(!NativeSocket::isReadable(fds.at(i + 1)) || !m_sessions.contains(session))
+                continue;
+            session->m_busy.store(true, std::memory_order_release);
+            m_pool->submit(session);
+        }
+    }
+}
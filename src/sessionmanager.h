@@ -0,0 +1,73 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SESSIONMANAGER_H
+#define SESSIONMANAGER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+#include "nativesocket.h"
+#include "session.h"
+#include "workstealingpool.h"
+
+// Runs any number of receive sessions on a shared work stealing pool
+// A single poller thread waits on every idle session's socket and submits
+// the readable ones; a session is out of the poll set while it runs, so it
+// never runs on two workers at once. A loopback wake socket brings the
+// poller back when a session finishes or the set changes.
+class SessionManager : public QThread
+{
+    Q_OBJECT
+
+public:
+    static const int POLL_INTERVAL_MS = 50;
+
+    explicit SessionManager(QObject *parent = Q_NULLPTR);
+    ~SessionManager();
+
+    void stop();
+
+    // GUI thread. Returns the running session, or null with error set.
+    Session *add(const Session::Config &config, QString *error);
+    // Waits for the session to finish any run in progress, then deletes it
+    void remove(Session *session);
+
+    // Any thread
+    void wake();
+
+    int threadCount() const { return m_pool->threadCount(); }
+    quint64 steals() const { return m_pool->steals(); }
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    WorkStealingPool *m_pool;
+    NativeSocket::Handle m_wakeHandle;
+    quint16 m_wakePort;
+    std::atomic<bool> m_stop;
+
+    QMutex m_mutex;
+    QVector<Session *> m_sessions;
+};
+
+#endif // SESSIONMANAGER_H
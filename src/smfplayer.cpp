@@ -0,0 +1,103 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "smfplayer.h"
+#include "txscheduler.h"
+#include "preciseclock.h"
+#include <QMutexLocker>
+
+SmfPlayer::SmfPlayer(const MidiFile &file, TxScheduler *scheduler, double speed, QObject *parent) :
+    QThread(parent),
+    m_file(file),
+    m_scheduler(scheduler),
+    m_speed(qMax(speed, 1.0 / 64)),
+    m_source(TxScheduler::newSource())
+{
+    Progress progress;
+    progress.playing = false;
+    progress.eventsScheduled = 0;
+    progress.eventCount = m_file.events().count();
+    progress.positionNs = 0;
+    progress.durationNs = m_file.duration();
+    progress.dropped = 0;
+    m_published.store(progress);
+}
+
+SmfPlayer::~SmfPlayer()
+{
+    stop();
+    wait();
+}
+
+void SmfPlayer::stop()
+{
+    QMutexLocker lock(&m_mutex);
+    m_stop = true;
+    m_wake.wakeOne();
+}
+
+bool SmfPlayer::waitUntil(qint64 time)
+{
+    QMutexLocker lock(&m_mutex);
+    forever
+    {
+        if(m_stop)
+            return false;
+        qint64 remaining = time - PreciseClock::nowNs();
+        if(remaining <= 0)
+            return true;
+        m_wake.wait(&m_mutex, static_cast<unsigned long>(remaining / 1000000 + 1));
+    }
+}
+
+void SmfPlayer::run()
+{
+    Progress progress = m_published.load();
+    progress.playing = true;
+    m_published.store(progress);
+
+    const QVector<MidiFile::Event> &events = m_file.events();
+    const qint64 origin = PreciseClock::nowNs() + START_DELAY_NS;
+    qint64 sendTime = origin;
+    bool stopped = false;
+    for(int i=0; i<events.count(); i++)
+    {
+        const MidiFile::Event &event = events[i];
+        sendTime = origin + static_cast<qint64>(event.time / m_speed);
+        if(!waitUntil(sendTime - LOOKAHEAD_NS))
+        {
+            stopped = true;
+            break;
+        }
+
+        if(!m_scheduler->schedule(sendTime, m_file.message(event), event.length, m_source))
+            progress.dropped++;
+        progress.eventsScheduled = i + 1;
+        progress.positionNs = event.time;
+        m_published.store(progress);
+    }
+
+    // Playing until the last event has actually gone out
+    if(stopped || !waitUntil(sendTime + TxScheduler::LATE_NS))
+        m_scheduler->cancel(m_source);
+
+    progress.playing = false;
+    m_published.store(progress);
+}
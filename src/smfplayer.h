@@ -0,0 +1,82 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SMFPLAYER_H
+#define SMFPLAYER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include "midifile.h"
+#include "seqlock.h"
+
+class TxScheduler;
+
+// Plays a parsed MIDI file through the transmit scheduler
+// Events are handed to the scheduler a short lookahead before they are due,
+// tagged with their own source, so the scheduler thread does the precise
+// timing and keeps lateness figures for this playback alone.
+class SmfPlayer : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Progress
+    {
+        bool playing;
+        int eventsScheduled;
+        int eventCount;
+        qint64 positionNs;          // File time of the last event handed over
+        qint64 durationNs;
+        quint64 dropped;            // Refused by a full scheduler
+    };
+
+    static const qint64 LOOKAHEAD_NS = Q_INT64_C(200000000);
+    static const qint64 START_DELAY_NS = Q_INT64_C(50000000);
+
+    // speed 1 plays in real time, 2 twice as fast
+    SmfPlayer(const MidiFile &file, TxScheduler *scheduler, double speed, QObject *parent = Q_NULLPTR);
+    ~SmfPlayer();
+
+    // Stops feeding and cancels anything already scheduled
+    void stop();
+
+    quint32 source() const { return m_source; }
+    Progress progress() const { return m_published.load(); }
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    bool waitUntil(qint64 time);
+
+    const MidiFile m_file;
+    TxScheduler *m_scheduler;
+    const double m_speed;
+    const quint32 m_source;
+
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    bool m_stop = false;
+
+    SeqLock<Progress> m_published;
+};
+
+#endif // SMFPLAYER_H
@@ -0,0 +1,139 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "smfrecorder.h"
+#include "midifilewriter.h"
+#include "metrics.h"
+#include "preciseclock.h"
+#include <QMutexLocker>
+#include <cstring>
+
+// Beyond this much unwritten data the newest messages are dropped
+static const int MAX_PENDING_BYTES = 16 * 1024 * 1024;
+static const int BUFFER_RESERVE = 64 * 1024;
+
+// Each queued message is its receive time and length, then the bytes
+struct RecordHeader
+{
+    qint64 timestamp;
+    qint32 length;
+};
+
+SmfRecorder::SmfRecorder(const QString &fileName, Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_fileName(fileName),
+    m_metrics(metrics),
+    m_startTime(PreciseClock::nowNs()),
+    m_recorded(0)
+{
+    m_pending.reserve(BUFFER_RESERVE);
+}
+
+SmfRecorder::~SmfRecorder()
+{
+    stop();
+    wait();
+}
+
+void SmfRecorder::record(qint64 timestamp, const quint8 *msg, int length)
+{
+    RecordHeader header;
+    header.timestamp = timestamp;
+    header.length = length;
+    {
+        QMutexLocker lock(&m_mutex);
+        if(m_pending.size() + int(sizeof(header)) + length > MAX_PENDING_BYTES)
+        {
+            if(m_metrics)
+                m_metrics->add(Metrics::RECORD_DROPS);
+            return;
+        }
+        m_pending.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        m_pending.append(reinterpret_cast<const char *>(msg), length);
+    }
+    m_wake.wakeOne();
+}
+
+void SmfRecorder::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stop = true;
+    }
+    m_wake.wakeOne();
+}
+
+void SmfRecorder::run()
+{
+    MidiFileWriter writer;
+    if(!writer.open(m_fileName, TICKS_PER_QUARTER_NOTE, TEMPO))
+    {
+        emit error(tr("Unable to record to %1 : %2").arg(m_fileName).arg(writer.errorString()));
+        return;
+    }
+
+    // Nanoseconds per tick is TEMPO * 1000 / TICKS_PER_QUARTER_NOTE
+    const qint64 tickNumerator = TICKS_PER_QUARTER_NOTE;
+    const qint64 tickDenominator = TEMPO * 1000;
+
+    QByteArray batch;
+    batch.reserve(BUFFER_RESERVE);
+    forever
+    {
+        bool stopping;
+        {
+            QMutexLocker lock(&m_mutex);
+            while(m_pending.isEmpty() && !m_stop)
+                m_wake.wait(&m_mutex);
+            batch.swap(m_pending);
+            stopping = m_stop;
+        }
+
+        const char *p = batch.constData();
+        const char *end = p + batch.size();
+        while(p < end)
+        {
+            RecordHeader header;
+            memcpy(&header, p, sizeof(header));
+            p += sizeof(header);
+
+            const qint64 elapsed = qMax<qint64>(0, header.timestamp - m_startTime);
+            const qint64 tick = (elapsed / tickDenominator) * tickNumerator
+                    + (elapsed % tickDenominator) * tickNumerator / tickDenominator;
+            if(!writer.write(tick, reinterpret_cast<const quint8 *>(p), header.length))
+            {
+                emit error(tr("Error writing %1 : %2").arg(m_fileName).arg(writer.errorString()));
+                writer.close();
+                return;
+            }
+            p += header.length;
+            m_recorded.fetch_add(1, std::memory_order_relaxed);
+            if(m_metrics)
+                m_metrics->add(Metrics::RECORD_MESSAGES);
+        }
+        batch.resize(0);
+
+        if(stopping)
+            break;
+    }
+
+    if(!writer.close())
+        emit error(tr("Error closing %1 : %2").arg(m_fileName).arg(writer.errorString()));
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SMFRECORDER_H
+#define SMFRECORDER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <atomic>
+
+class Metrics;
+
+// Records received MIDI to a Standard MIDI File on a dedicated thread
+// The receive thread appends messages with their PreciseClock receive time
+// to a buffer; this thread converts the times into ticks from the start of
+// the recording and streams them into a MidiFileWriter.
+class SmfRecorder : public QThread
+{
+    Q_OBJECT
+
+public:
+    // 960 PPQN at 120 BPM, one tick is about 521 microseconds
+    static const int TICKS_PER_QUARTER_NOTE = 960;
+    static const qint64 TEMPO = 500000;
+
+    explicit SmfRecorder(const QString &fileName, Metrics *metrics = Q_NULLPTR, QObject *parent = Q_NULLPTR);
+    ~SmfRecorder();
+
+    // Thread safe, never blocks on file IO
+    void record(qint64 timestamp, const quint8 *msg, int length);
+
+    // Writes anything still queued and closes the file
+    void stop();
+
+    QString fileName() const { return m_fileName; }
+    quint64 messagesRecorded() const { return m_recorded.load(std::memory_order_relaxed); }
+
+signals:
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    const QString m_fileName;
+    Metrics *m_metrics;
+    const qint64 m_startTime;
+
+    // Shared with the receive thread
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QByteArray m_pending;
+    bool m_stop = false;
+
+    std::atomic<quint64> m_recorded;
+};
+
+#endif // SMFRECORDER_H
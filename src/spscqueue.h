@@ -0,0 +1,87 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <atomic>
+
+// Bounded lock free queue for exactly one producer and one consumer thread
+// Capacity is rounded up to a power of two. push() fails rather than blocks
+// when full, so the producer decides what to drop.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacity) :
+        m_head(0),
+        m_tail(0)
+    {
+        int size = 1;
+        while(size < capacity)
+            size <<= 1;
+        m_buffer.resize(size);
+        m_data = m_buffer.data();
+        m_mask = static_cast<quint32>(size - 1);
+    }
+
+    // Producer side
+    bool push(const T &item)
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false;
+        m_data[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T &item)
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire))
+            return false;
+        item = m_data[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate from either side
+    int size() const
+    {
+        return static_cast<int>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+    }
+
+    int capacity() const { return static_cast<int>(m_mask + 1); }
+
+private:
+    QVector<T> m_buffer;
+    T *m_data;
+    quint32 m_mask;
+    alignas(64) std::atomic<quint32> m_head;
+    alignas(64) std::atomic<quint32> m_tail;
+
+    Q_DISABLE_COPY(SpscQueue)
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,130 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef TIMECODE_H
+#define TIMECODE_H
+
+#include <QtGlobal>
+#include <QString>
+
+// SMPTE timecode value as carried by MTC
+// Frame numbers count real frames since 00:00:00:00, so 29.97 drop frame
+// labels convert correctly in both directions.
+struct Timecode
+{
+    // Values match the rr bits of the MTC hours byte
+    enum Rate {
+        RATE_24 = 0,
+        RATE_25 = 1,
+        RATE_29_97_DF = 2,
+        RATE_30 = 3
+    };
+
+    quint8 hours = 0;
+    quint8 minutes = 0;
+    quint8 seconds = 0;
+    quint8 frames = 0;
+    Rate rate = RATE_25;
+
+    static int nominalFps(Rate rate)
+    {
+        static const int FPS[] = {24, 25, 30, 30};
+        return FPS[rate & 3];
+    }
+
+    // Exact frame rate as numerator / denominator frames per second
+    static qint64 rateNumerator(Rate rate)
+    {
+        static const qint64 NUM[] = {24, 25, 30000, 30};
+        return NUM[rate & 3];
+    }
+    static qint64 rateDenominator(Rate rate) { return rate == RATE_29_97_DF ? 1001 : 1; }
+
+    static double fps(Rate rate) { return double(rateNumerator(rate)) / rateDenominator(rate); }
+
+    // Time of frame number n on the exact rate
+    static qint64 frameTimeNs(qint64 n, Rate rate)
+    {
+        return n * rateDenominator(rate) * Q_INT64_C(1000000000) / rateNumerator(rate);
+    }
+
+    static qint64 framesPerDay(Rate rate)
+    {
+        return rate == RATE_29_97_DF ? Q_INT64_C(2589408) : Q_INT64_C(86400) * nominalFps(rate);
+    }
+
+    qint64 toFrameNumber() const
+    {
+        qint64 fps = nominalFps(rate);
+        qint64 n = ((hours * 60 + minutes) * 60 + seconds) * fps + frames;
+        if(rate == RATE_29_97_DF)
+        {
+            // A dropped label, 00 or 01 opening a minute, stands for the 02 after it
+            if(seconds == 0 && frames < 2 && minutes % 10 != 0)
+                n += 2 - frames;
+            qint64 totalMinutes = hours * 60 + minutes;
+            n -= 2 * (totalMinutes - totalMinutes / 10);
+        }
+        return n;
+    }
+
+    static Timecode fromFrameNumber(qint64 n, Rate rate)
+    {
+        qint64 perDay = framesPerDay(rate);
+        n %= perDay;
+        if(n < 0)
+            n += perDay;
+
+        if(rate == RATE_29_97_DF)
+        {
+            // Put the dropped labels back in: 2 per minute except every tenth
+            qint64 tens = n / 17982;
+            qint64 rest = n % 17982;
+            n += 18 * tens + (rest > 1 ? 2 * ((rest - 2) / 1798) : 0);
+        }
+
+        qint64 fps = nominalFps(rate);
+        Timecode tc;
+        tc.rate = rate;
+        tc.frames = static_cast<quint8>(n % fps);
+        tc.seconds = static_cast<quint8>((n / fps) % 60);
+        tc.minutes = static_cast<quint8>((n / (fps * 60)) % 60);
+        tc.hours = static_cast<quint8>((n / (fps * 3600)) % 24);
+        return tc;
+    }
+
+    QString toString() const
+    {
+        return QString("%1:%2:%3%4%5")
+                .arg(hours, 2, 10, QLatin1Char('0'))
+                .arg(minutes, 2, 10, QLatin1Char('0'))
+                .arg(seconds, 2, 10, QLatin1Char('0'))
+                .arg(rate == RATE_29_97_DF ? QLatin1Char(';') : QLatin1Char(':'))
+                .arg(frames, 2, 10, QLatin1Char('0'));
+    }
+
+    static QString rateName(Rate rate)
+    {
+        static const char *NAMES[] = {"24", "25", "29.97 DF", "30"};
+        return QString::fromLatin1(NAMES[rate & 3]);
+    }
+};
+
+#endif // TIMECODE_H
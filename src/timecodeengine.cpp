@@ -0,0 +1,225 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "timecodeengine.h"
+#include "mididata.h"
+#include "metrics.h"
+#include <cstring>
+
+// Weight of each new sample in the running averages
+static const double AVERAGE_WEIGHT = 1.0 / 32;
+
+static inline qint64 floorDiv4(qint64 value)
+{
+    return value >= 0 ? value / 4 : (value - 3) / 4;
+}
+
+TimecodeEngine::TimecodeEngine(Metrics *metrics) :
+    m_metrics(metrics)
+{
+    m_state.position = Timecode();
+    m_state.direction = DIRECTION_STOPPED;
+    m_state.locked = false;
+    m_state.lastMessageTime = 0;
+    m_state.measuredFps = 0;
+    m_state.jitterMeanNs = 0;
+    m_state.jitterMaxNs = 0;
+    m_state.driftNs = 0;
+    m_state.driftPpm = 0;
+    m_state.quarterFrames = 0;
+    m_state.fullFrames = 0;
+    m_state.discontinuities = 0;
+    memset(m_pieces, 0, sizeof(m_pieces));
+    m_published.store(m_state);
+}
+
+bool TimecodeEngine::process(const quint8 *msg, int length, qint64 timestamp)
+{
+    if(length >= 2 && msg[0] == 0xF1)
+    {
+        quarterFrame(msg[1], timestamp);
+        return true;
+    }
+
+    if(length >= int(sizeof(MidiData::TIMECODE_START)) + 4
+            && memcmp(msg, MidiData::TIMECODE_START, sizeof(MidiData::TIMECODE_START)) == 0)
+    {
+        fullFrame(msg, timestamp);
+        return true;
+    }
+
+    return false;
+}
+
+qint64 TimecodeEngine::quarterFrameNs() const
+{
+    return Timecode::frameTimeNs(1, m_state.position.rate) / 4;
+}
+
+void TimecodeEngine::loseLock()
+{
+    m_state.locked = false;
+    m_receivedPieces = 0;
+    m_driftValid = false;
+}
+
+void TimecodeEngine::resetDrift(qint64 timestamp)
+{
+    m_driftReferenceQf = m_positionQf;
+    m_driftReferenceTime = timestamp;
+    m_driftValid = true;
+    m_state.driftNs = 0;
+    m_state.driftPpm = 0;
+    m_state.jitterMaxNs = 0;
+}
+
+void TimecodeEngine::quarterFrame(quint8 data, qint64 timestamp)
+{
+    const int piece = (data >> 4) & 0x07;
+    m_state.quarterFrames++;
+    if(m_metrics)
+        m_metrics->add(Metrics::MTC_QUARTER_FRAMES);
+
+    bool continuous = m_lastPiece >= 0 && timestamp - m_lastQuarterFrameTime < TIMEOUT_NS;
+    if(!continuous)
+    {
+        // Starting up, or restarting after a pause
+        loseLock();
+        m_state.direction = DIRECTION_STOPPED;
+        m_intervalAverageNs = 0;
+    }
+    else
+    {
+        Direction direction = DIRECTION_STOPPED;
+        if(piece == ((m_lastPiece + 1) & 7))
+            direction = DIRECTION_FORWARD;
+        else if(piece == ((m_lastPiece + 7) & 7))
+            direction = DIRECTION_REVERSE;
+
+        if(direction == DIRECTION_STOPPED
+                || (m_state.direction != DIRECTION_STOPPED && direction != m_state.direction))
+        {
+            // Lost pieces or changed direction, the partial set is useless
+            m_state.discontinuities++;
+            if(m_metrics)
+                m_metrics->add(Metrics::MTC_DISCONTINUITIES);
+            loseLock();
+        }
+        m_state.direction = direction;
+
+        if(direction != DIRECTION_STOPPED)
+        {
+            const qint64 interval = timestamp - m_lastQuarterFrameTime;
+            m_intervalAverageNs = m_intervalAverageNs == 0 ? interval
+                    : m_intervalAverageNs + (interval - m_intervalAverageNs) * AVERAGE_WEIGHT;
+
+            if(m_state.locked)
+            {
+                qint64 jitter = qAbs(interval - quarterFrameNs());
+                m_jitterAverageNs += (jitter - m_jitterAverageNs) * AVERAGE_WEIGHT;
+                m_state.jitterMeanNs = static_cast<qint64>(m_jitterAverageNs);
+                m_state.jitterMaxNs = qMax(m_state.jitterMaxNs, jitter);
+                if(m_metrics)
+                    m_metrics->record(Metrics::MTC_QUARTER_FRAME_JITTER, jitter);
+
+                m_positionQf += direction == DIRECTION_FORWARD ? 1 : -1;
+            }
+        }
+    }
+
+    m_pieces[piece] = data & 0x0F;
+    m_receivedPieces |= 1 << piece;
+    m_lastPiece = piece;
+    m_lastQuarterFrameTime = timestamp;
+    m_state.lastMessageTime = timestamp;
+
+    // The set is complete on piece 7 going forward, piece 0 in reverse
+    bool complete = m_receivedPieces == 0xFF
+            && ((m_state.direction == DIRECTION_FORWARD && piece == 7)
+                || (m_state.direction == DIRECTION_REVERSE && piece == 0));
+    if(complete)
+    {
+        Timecode tc;
+        tc.frames = static_cast<quint8>(m_pieces[0] | ((m_pieces[1] & 0x01) << 4));
+        tc.seconds = static_cast<quint8>(m_pieces[2] | ((m_pieces[3] & 0x03) << 4));
+        tc.minutes = static_cast<quint8>(m_pieces[4] | ((m_pieces[5] & 0x03) << 4));
+        tc.hours = static_cast<quint8>(m_pieces[6] | ((m_pieces[7] & 0x01) << 4));
+        tc.rate = static_cast<Timecode::Rate>((m_pieces[7] >> 1) & 0x03);
+
+        // The encoded frame was current when the first piece of the set went out
+        qint64 assembled = tc.toFrameNumber() * 4 + (m_state.direction == DIRECTION_FORWARD ? 7 : 0);
+        qint64 dayQf = Timecode::framesPerDay(tc.rate) * 4;
+        bool rateChanged = tc.rate != m_state.position.rate;
+        if(m_state.locked && (rateChanged || (assembled - m_positionQf) % dayQf != 0))
+        {
+            m_state.discontinuities++;
+            if(m_metrics)
+                m_metrics->add(Metrics::MTC_DISCONTINUITIES);
+            m_driftValid = false;
+        }
+
+        m_positionQf = assembled;
+        m_state.position.rate = tc.rate;
+        m_state.locked = true;
+        if(!m_driftValid)
+            resetDrift(timestamp);
+    }
+
+    if(m_state.locked)
+    {
+        m_state.position = Timecode::fromFrameNumber(floorDiv4(m_positionQf), m_state.position.rate);
+
+        qint64 localElapsed = timestamp - m_driftReferenceTime;
+        if(m_driftValid && localElapsed > 0)
+        {
+            qint64 timecodeElapsed = qAbs(m_positionQf - m_driftReferenceQf)
+                    * Timecode::frameTimeNs(1000, m_state.position.rate) / 4000;
+            m_state.driftNs = timecodeElapsed - localElapsed;
+            m_state.driftPpm = m_state.driftNs * 1e6 / localElapsed;
+        }
+    }
+
+    if(m_intervalAverageNs > 0)
+        m_state.measuredFps = 1e9 / (4 * m_intervalAverageNs);
+
+    m_published.store(m_state);
+}
+
+void TimecodeEngine::fullFrame(const quint8 *msg, qint64 timestamp)
+{
+    int index = sizeof(MidiData::TIMECODE_START);
+    Timecode tc;
+    tc.rate = static_cast<Timecode::Rate>((msg[index] >> 5) & 0x03);
+    tc.hours = msg[index] & 0x1F;
+    tc.minutes = msg[index + 1] & 0x3F;
+    tc.seconds = msg[index + 2] & 0x3F;
+    tc.frames = msg[index + 3] & 0x1F;
+
+    m_state.fullFrames++;
+    if(m_metrics)
+        m_metrics->add(Metrics::MTC_FULL_FRAMES);
+
+    // A locate: quarter frames have to run again before drift means anything
+    loseLock();
+    m_state.position = tc;
+    m_state.lastMessageTime = timestamp;
+    m_positionQf = tc.toFrameNumber() * 4;
+    m_published.store(m_state);
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef TIMECODEENGINE_H
+#define TIMECODEENGINE_H
+
+#include <QtGlobal>
+#include "timecode.h"
+#include "seqlock.h"
+
+class Metrics;
+
+// Reconstructs running MIDI timecode from received messages
+// Quarter frames (F1) are assembled into full positions, the frame rate and
+// direction are detected, and arrival times are compared against the local
+// monotonic clock for jitter and drift. Full frame SysEx locates directly.
+// process() runs on the receive thread; state() can be sampled from any
+// thread, normally once per display frame.
+class TimecodeEngine
+{
+public:
+    enum Direction {
+        DIRECTION_STOPPED,
+        DIRECTION_FORWARD,
+        DIRECTION_REVERSE
+    };
+
+    struct State
+    {
+        Timecode position;
+        Direction direction;
+        bool locked;                // A full set of quarter frames has been assembled
+        qint64 lastMessageTime;     // PreciseClock time of the last timecode message
+        double measuredFps;         // From quarter frame spacing
+        qint64 jitterMeanNs;        // Mean absolute deviation from the nominal spacing
+        qint64 jitterMaxNs;
+        qint64 driftNs;             // Timecode elapsed minus local elapsed since lock
+        double driftPpm;
+        quint64 quarterFrames;
+        quint64 fullFrames;
+        quint64 discontinuities;
+    };
+
+    // Without timecode for this long the source is considered stopped
+    static const qint64 TIMEOUT_NS = Q_INT64_C(200000000);
+
+    explicit TimecodeEngine(Metrics *metrics = Q_NULLPTR);
+
+    // Returns true if the message was timecode
+    bool process(const quint8 *msg, int length, qint64 timestamp);
+
+    State state(quint32 *version = Q_NULLPTR) const { return m_published.load(version); }
+    quint32 version() const { return m_published.version(); }
+
+    static bool isRunning(const State &state, qint64 now)
+    {
+        return state.direction != DIRECTION_STOPPED && now - state.lastMessageTime < TIMEOUT_NS;
+    }
+
+private:
+    void quarterFrame(quint8 data, qint64 timestamp);
+    void fullFrame(const quint8 *msg, qint64 timestamp);
+    void loseLock();
+    void resetDrift(qint64 timestamp);
+    qint64 quarterFrameNs() const;
+
+    Metrics *m_metrics;
+
+    // Receive thread only
+    State m_state;
+    quint8 m_pieces[8];
+    quint8 m_receivedPieces = 0;
+    int m_lastPiece = -1;
+    qint64 m_lastQuarterFrameTime = 0;
+    qint64 m_positionQf = 0;            // Quarter frames since midnight
+    double m_intervalAverageNs = 0;
+    double m_jitterAverageNs = 0;
+    qint64 m_driftReferenceQf = 0;
+    qint64 m_driftReferenceTime = 0;
+    bool m_driftValid = false;
+
+    SeqLock<State> m_published;
+};
+
+#endif // TIMECODEENGINE_H
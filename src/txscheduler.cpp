@@ -0,0 +1,318 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "txscheduler.h"
+#include "txsocket.h"
+#include "metrics.h"
+#include "preciseclock.h"
+#include "miditransform.h"
+#include "realtime.h"
+#include "nativesocket.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+static const double AVERAGE_WEIGHT = 1.0 / 32;
+
+static TxScheduler::SourceReport emptyReport()
+{
+    TxScheduler::SourceReport report;
+    report.sent = 0;
+    report.late = 0;
+    report.latenessMaxNs = 0;
+    report.lateness.clear();
+    report.traced = false;
+    return report;
+}
+
+TxScheduler::TxScheduler(Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_metrics(metrics),
+    m_pending(0)
+{
+    Stats stats;
+    stats.sent = 0;
+    stats.cancelled = 0;
+    stats.pending = 0;
+    stats.latenessMeanNs = 0;
+    stats.latenessMaxNs = 0;
+    m_published.store(stats);
+}
+
+TxScheduler::~TxScheduler()
+{
+    stop();
+    wait();
+}
+
+void TxScheduler::setDestination(const QHostAddress &localAddress, const QNetworkInterface &interface,
+                                 const QHostAddress &address, quint16 port)
+{
+    m_localAddress = localAddress;
+    m_interface = interface;
+    m_address = address;
+    m_port = port;
+}
+
+bool TxScheduler::schedule(qint64 sendTime, const quint8 *msg, int length, quint32 source)
+{
+    Entry entry;
+    // Late messages are measured from when they were handed over
+    entry.time = qMax(sendTime, PreciseClock::nowNs());
+    entry.origin = 0;
+    entry.source = source;
+    return enqueue(entry, msg, length);
+}
+
+bool TxScheduler::forward(qint64 origin, const quint8 *msg, int length, quint32 source)
+{
+    Entry entry;
+    entry.time = PreciseClock::nowNs();
+    entry.origin = qMin(origin, entry.time);
+    entry.source = source;
+    return enqueue(entry, msg, length);
+}
+
+bool TxScheduler::enqueue(Entry &entry, const quint8 *msg, int length)
+{
+    if(length <= 0)
+        return false;
+    if(m_pending.load(std::memory_order_relaxed) >= MAX_PENDING)
+    {
+        m_metrics->add(Metrics::TX_SCHEDULE_DROPS);
+        return false;
+    }
+
+    entry.length = length;
+    if(length <= INLINE_LENGTH)
+        memcpy(entry.data, msg, length);
+    else
+        entry.extended = QByteArray(reinterpret_cast<const char *>(msg), length);
+
+    QMutexLocker lock(&m_mutex);
+    entry.sequence = m_sequence++;
+    m_incoming.append(entry);
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    if(m_sleepingUntil != 0 && entry.time < m_sleepingUntil)
+        m_wake.wakeOne();
+    return true;
+}
+
+void TxScheduler::setTransform(const QSharedPointer<const MidiTransform> &transform)
+{
+    QMutexLocker lock(&m_mutex);
+    m_pendingTransform = transform;
+    m_transformChanged = true;
+}
+
+void TxScheduler::cancel(quint32 source)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cancelled.append(source);
+    m_wake.wakeOne();
+}
+
+quint32 TxScheduler::newSource()
+{
+    static std::atomic<quint32> next(1);
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+TxScheduler::SourceReport TxScheduler::sourceReport(quint32 source) const
+{
+    QMutexLocker lock(&m_reportMutex);
+    QHash<quint32, SourceReport>::const_iterator i = m_reports.constFind(source);
+    return i != m_reports.constEnd() ? i.value() : emptyReport();
+}
+
+void TxScheduler::traceSource(quint32 source)
+{
+    QMutexLocker lock(&m_reportMutex);
+    QHash<quint32, SourceReport>::iterator i = m_reports.find(source);
+    if(i == m_reports.end())
+        i = m_reports.insert(source, emptyReport());
+    i.value().traced = true;
+}
+
+void TxScheduler::releaseSource(quint32 source)
+{
+    cancel(source);
+    QMutexLocker lock(&m_reportMutex);
+    m_reports.remove(source);
+}
+
+void TxScheduler::stop()
+{
+    QMutexLocker lock(&m_mutex);
+    m_stop = true;
+    m_wake.wakeOne();
+}
+
+void TxScheduler::takeIncoming()
+{
+    for(int i=0; i<m_incoming.count(); i++)
+    {
+        m_heap.append(m_incoming[i]);
+        std::push_heap(m_heap.begin(), m_heap.end(), Later());
+    }
+    m_incoming.resize(0);
+
+    if(m_cancelled.isEmpty())
+        return;
+
+    int kept = 0;
+    for(int i=0; i<m_heap.count(); i++)
+    {
+        if(!m_cancelled.contains(m_heap[i].source))
+        {
+            if(kept != i)
+                m_heap[kept] = m_heap[i];
+            kept++;
+        }
+    }
+    const int dropped = m_heap.count() - kept;
+    m_heap.resize(kept);
+    std::make_heap(m_heap.begin(), m_heap.end(), Later());
+    m_cancelled.resize(0);
+
+    m_pending.fetch_sub(dropped, std::memory_order_relaxed);
+    Stats stats = m_published.load();
+    stats.cancelled += dropped;
+    stats.pending = m_pending.load(std::memory_order_relaxed);
+    m_published.store(stats);
+}
+
+void TxScheduler::reportSent(quint32 source, qint64 lateness)
+{
+    QMutexLocker lock(&m_reportMutex);
+    QHash<quint32, SourceReport>::iterator i = m_reports.find(source);
+    if(i == m_reports.end())
+    {
+        i = m_reports.insert(source, emptyReport());
+    }
+    SourceReport &report = i.value();
+    report.sent++;
+    if(lateness > LATE_NS)
+        report.late++;
+    report.latenessMaxNs = qMax(report.latenessMaxNs, lateness);
+    report.lateness.add(lateness);
+    if(report.traced)
+        report.trace.append(lateness);
+}
+
+void TxScheduler::run()
+{
+    QString refused;
+    if(!Realtime::apply(Realtime::ROLE_SCHEDULER, &refused))
+        emit error(refused);
+
+    TxSocket socket(m_metrics);
+    if(!socket.bind(m_localAddress, m_interface))
+    {
+        emit error(tr("Error binding TX socket : %1").arg(socket.errorString()));
+        return;
+    }
+    qDebug() << "TX Socket : Bound to IP:" << m_localAddress.toString();
+    socket.setDestination(m_address, m_port);
+    if(m_expectedRate > 0)
+    {
+        const int bytes = NativeSocket::bufferSizeFor(m_expectedRate);
+        const int granted = socket.setSendBufferSize(bytes);
+        if(granted < bytes)
+            emit error(tr("TX socket buffer limited to %1 KB of %2 KB").arg(granted / 1024).arg(bytes / 1024));
+    }
+
+    double latenessAverage = 0;
+
+    forever
+    {
+        qint64 next;
+        {
+            QMutexLocker lock(&m_mutex);
+            takeIncoming();
+            if(m_stop)
+                break;
+            if(m_transformChanged)
+            {
+                m_transform = m_pendingTransform;
+                m_transformChanged = false;
+            }
+
+            if(m_heap.isEmpty())
+            {
+                m_sleepingUntil = Q_INT64_C(0x7FFFFFFFFFFFFFFF);
+                m_wake.wait(&m_mutex);
+                m_sleepingUntil = 0;
+                continue;
+            }
+
+            next = m_heap.first().time;
+            const qint64 coarse = next - PreciseClock::nowNs() - COARSE_MARGIN_NS;
+            if(coarse >= 1000000)
+            {
+                // Anything scheduled ahead of next wakes this early
+                m_sleepingUntil = next;
+                m_wake.wait(&m_mutex, static_cast<unsigned long>(coarse / 1000000));
+                m_sleepingUntil = 0;
+                continue;
+            }
+        }
+
+        // Within the margin, the precise part of the wait
+        qint64 now = PreciseClock::waitUntilNs(next, SPIN_NS);
+
+        Stats stats = m_published.load();
+        int released = 0;
+        while(!m_heap.isEmpty() && m_heap.first().time <= now)
+        {
+            std::pop_heap(m_heap.begin(), m_heap.end(), Later());
+            Entry &entry = m_heap.last();
+
+            const qint64 lateness = PreciseClock::nowNs() - entry.time;
+            if(m_transform && entry.length <= INLINE_LENGTH)
+                m_transform->apply(entry.data, entry.length);
+            socket.send(entry.message(), entry.length);
+
+            m_metrics->record(Metrics::TX_SCHEDULE_LATENESS, lateness);
+            if(entry.origin)
+            {
+                // Forwarded messages are on the wire once the socket has them
+                const qint64 latency = PreciseClock::nowNs() - entry.origin;
+                m_metrics->record(Metrics::INPUT_TO_WIRE_LATENCY, latency);
+                if(entry.source)
+                    reportSent(entry.source, latency);
+            }
+            else if(entry.source)
+                reportSent(entry.source, lateness);
+            latenessAverage += (lateness - latenessAverage) * AVERAGE_WEIGHT;
+            stats.latenessMeanNs = static_cast<qint64>(latenessAverage);
+            stats.latenessMaxNs = qMax(stats.latenessMaxNs, lateness);
+            stats.sent++;
+            released++;
+
+            m_heap.removeLast();
+            now = PreciseClock::nowNs();
+        }
+        stats.pending = m_pending.fetch_sub(released, std::memory_order_relaxed) - released;
+        m_metrics->setGauge(Metrics::TX_SCHEDULE_PENDING, stats.pending);
+        m_published.store(stats);
+    }
+}
@@ -0,0 +1,180 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef TXSCHEDULER_H
+#define TXSCHEDULER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QNetworkInterface>
+#include <QHash>
+#include <QSharedPointer>
+#include <atomic>
+#include "metrics.h"
+#include "seqlock.h"
+
+class MidiTransform;
+
+// Releases messages to the gateway at absolute PreciseClock times
+// Producers on any thread hand over messages with a send time; one real
+// time thread keeps them in a binary heap and sleeps to the earliest
+// deadline, so any number of pending messages costs one wait rather than a
+// timer each. Messages due at the same time go out in the order scheduled.
+class TxScheduler : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Stats
+    {
+        quint64 sent;
+        quint64 cancelled;
+        int pending;
+        qint64 latenessMeanNs;      // Send time minus scheduled time
+        qint64 latenessMaxNs;
+    };
+
+    // Lateness of everything sent for one source, e.g. a file being played
+    struct SourceReport
+    {
+        quint64 sent;
+        quint64 late;               // More than LATE_NS after the scheduled time
+        qint64 latenessMaxNs;
+        Metrics::HistogramSnapshot lateness;
+        bool traced;
+        QVector<qint64> trace;      // Lateness of each message in send order, when traced
+    };
+
+    static const qint64 LATE_NS = Q_INT64_C(1000000);
+
+    // Messages this short are stored inline; longer ones (SysEx) in a QByteArray
+    static const int INLINE_LENGTH = 12;
+    static const int MAX_PENDING = 1000000;
+
+    // Waits on the condition variable stop this far short of a deadline, the
+    // rest is slept on the monotonic clock and the last stretch spun
+    static const qint64 COARSE_MARGIN_NS = Q_INT64_C(2000000);
+    static const qint64 SPIN_NS = Q_INT64_C(200000);
+
+    TxScheduler(Metrics *metrics, QObject *parent = Q_NULLPTR);
+    ~TxScheduler();
+
+    // Set before start()
+    void setDestination(const QHostAddress &localAddress, const QNetworkInterface &interface,
+                        const QHostAddress &address, quint16 port);
+    // Set before start(). Sizes the send buffer for bursts at this many datagrams/s, 0 for the OS default.
+    void setExpectedRate(int datagramsPerSecond) { m_expectedRate = datagramsPerSecond; }
+
+    // Thread safe. A time in the past sends as soon as possible. Messages can
+    // be tagged with a source so a sequence can later be cancelled as a whole.
+    // Returns false if too many messages are already pending.
+    bool schedule(qint64 sendTime, const quint8 *msg, int length, quint32 source = 0);
+    bool sendNow(const quint8 *msg, int length) { return schedule(0, msg, length); }
+    // Thread safe, sends as soon as possible but measures lateness, including in
+    // the source report, from origin, e.g. when a local MIDI input delivered it
+    bool forward(qint64 origin, const quint8 *msg, int length, quint32 source);
+
+    // Thread safe, rewrites channel messages as they are sent; null for none
+    void setTransform(const QSharedPointer<const MidiTransform> &transform);
+
+    // Thread safe, drops every pending message from source
+    void cancel(quint32 source);
+
+    // A source tag no one else uses, reported on until released
+    static quint32 newSource();
+    SourceReport sourceReport(quint32 source) const;
+    // Also keep the lateness of every message, for short sequences such as a cue script
+    void traceSource(quint32 source);
+    void releaseSource(quint32 source);
+
+    void stop();
+
+    Stats stats() const { return m_published.load(); }
+
+signals:
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    struct Entry
+    {
+        qint64 time;
+        qint64 origin;          // Of forwarded messages, otherwise 0
+        quint64 sequence;
+        quint32 source;
+        int length;
+        quint8 data[INLINE_LENGTH];
+        QByteArray extended;
+
+        const quint8 *message() const
+        {
+            return length <= INLINE_LENGTH ? data : reinterpret_cast<const quint8 *>(extended.constData());
+        }
+    };
+
+    // Heap order, earliest time then earliest scheduled at the top
+    struct Later
+    {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+        }
+    };
+
+    bool enqueue(Entry &entry, const quint8 *msg, int length);
+    void takeIncoming();
+    void reportSent(quint32 source, qint64 lateness);
+
+    Metrics *m_metrics;
+    QHostAddress m_localAddress;
+    QNetworkInterface m_interface;
+    QHostAddress m_address;
+    quint16 m_port = 0;
+    int m_expectedRate = 0;
+
+    // Shared with producers
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QVector<Entry> m_incoming;
+    QVector<quint32> m_cancelled;
+    quint64 m_sequence = 0;
+    QSharedPointer<const MidiTransform> m_pendingTransform;
+    bool m_transformChanged = false;
+    qint64 m_sleepingUntil = 0;     // Deadline the thread is waiting for, 0 when busy
+    bool m_stop = false;
+    std::atomic<int> m_pending;
+
+    // Scheduler thread only
+    QVector<Entry> m_heap;
+    QSharedPointer<const MidiTransform> m_transform;
+
+    mutable QMutex m_reportMutex;
+    QHash<quint32, SourceReport> m_reports;
+
+    SeqLock<Stats> m_published;
+};
+
+#endif // TXSCHEDULER_H
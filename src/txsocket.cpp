@@ -0,0 +1,67 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "txsocket.h"
+#include "metrics.h"
+#include "udpmidi.h"
+#include "nativesocket.h"
+
+TxSocket::TxSocket(Metrics *metrics) :
+    m_metrics(metrics)
+{
+}
+
+bool TxSocket::bind(const QHostAddress &localAddress, const QNetworkInterface &interface)
+{
+    if(!m_socket.bind(localAddress))
+        return false;
+    if(interface.isValid())
+    {
+        m_socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, QVariant(1));
+        m_socket.setMulticastInterface(interface);
+    }
+    return true;
+}
+
+void TxSocket::setDestination(const QHostAddress &address, quint16 port)
+{
+    m_address = address;
+    m_port = port;
+}
+
+int TxSocket::setSendBufferSize(int bytes)
+{
+    return NativeSocket::setSendBufferSize(static_cast<NativeSocket::Handle>(m_socket.socketDescriptor()), bytes);
+}
+
+bool TxSocket::send(const quint8 *msg, int length)
+{
+    char datagram[UdpMidi::encodedLength(UdpMidi::MAX_MESSAGE_LENGTH)];
+    int datagramLength = UdpMidi::encode(msg, length, datagram, sizeof(datagram));
+    qint64 sent = datagramLength > 0 ? m_socket.writeDatagram(datagram, datagramLength, m_address, m_port) : -1;
+    if(sent < 0)
+    {
+        m_metrics->add(Metrics::TX_ERRORS);
+        return false;
+    }
+    m_metrics->add(Metrics::TX_SENDS);
+    m_metrics->add(Metrics::TX_BYTES, sent);
+    return true;
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef TXSOCKET_H
+#define TXSOCKET_H
+
+#include <QUdpSocket>
+#include <QNetworkInterface>
+
+class Metrics;
+
+// Sends MIDI messages to the gateway from whichever thread owns it
+// Encodes into a stack buffer and counts every send, so each transmitting
+// thread can own one without sharing the GUI's socket.
+class TxSocket
+{
+public:
+    explicit TxSocket(Metrics *metrics);
+
+    // Binds to the local address, routing multicast through interface if valid
+    bool bind(const QHostAddress &localAddress, const QNetworkInterface &interface = QNetworkInterface());
+    void setDestination(const QHostAddress &address, quint16 port);
+    // After bind(), returns the size granted
+    int setSendBufferSize(int bytes);
+
+    bool send(const quint8 *msg, int length);
+
+    QString errorString() const { return m_socket.errorString(); }
+
+private:
+    Metrics *m_metrics;
+    QUdpSocket m_socket;
+    QHostAddress m_address;
+    quint16 m_port = 0;
+
+    Q_DISABLE_COPY(TxSocket)
+};
+
+#endif // TXSOCKET_H
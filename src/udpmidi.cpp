@@ -0,0 +1,92 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "udpmidi.h"
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static inline int hexValue(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+int UdpMidi::decode(const char *text, int length, quint8 *out, int capacity, int *invalidTokens)
+{
+    if(length < HEADER_LENGTH
+            || text[0] != 'M' || text[1] != 'I' || text[2] != 'D' || text[3] != 'I')
+        return -1;
+
+    int count = 0;
+    int pos = HEADER_LENGTH;
+    while(pos < length)
+    {
+        if(text[pos] == ' ')
+        {
+            pos++;
+            continue;
+        }
+
+        // Accumulate one token, anything but one or two hex digits invalidates just that token
+        int value = 0;
+        int digits = 0;
+        bool ok = true;
+        while(pos < length && text[pos] != ' ')
+        {
+            int digit = hexValue(text[pos]);
+            if(digit < 0 || ++digits > 2)
+                ok = false;
+            else
+                value = (value << 4) | digit;
+            pos++;
+        }
+
+        if(ok)
+        {
+            if(count < capacity)
+                out[count] = static_cast<quint8>(value);
+            count++;
+        }
+        else if(invalidTokens)
+            (*invalidTokens)++;
+    }
+
+    return count;
+}
+
+int UdpMidi::encode(const quint8 *msg, int length, char *out, int capacity)
+{
+    if(encodedLength(length) > capacity)
+        return -1;
+
+    char *p = out;
+    for(int i=0; i<HEADER_LENGTH; i++)
+        *p++ = HEADER[i];
+    for(int i=0; i<length; i++)
+    {
+        *p++ = ' ';
+        *p++ = HEX_DIGITS[msg[i] >> 4];
+        *p++ = HEX_DIGITS[msg[i] & 0x0F];
+    }
+
+    return static_cast<int>(p - out);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef UDPMIDI_H
+#define UDPMIDI_H
+
+#include <QtGlobal>
+
+// Codec for the gateway's UDP string format
+// Each datagram carries "MIDI" followed by space separated hex bytes, e.g. "MIDI 90 3C 40"
+namespace UdpMidi
+{
+    static const char HEADER[] = "MIDI";
+    static const int HEADER_LENGTH = 4;
+
+    // Longest message kept from a single datagram
+    static const int MAX_MESSAGE_LENGTH = 2048;
+
+    // Space needed to encode length bytes
+    Q_DECL_CONSTEXPR inline int encodedLength(int length) { return HEADER_LENGTH + length * 3; }
+
+    // Decodes the hex bytes of a datagram into out, storing at most capacity bytes
+    // Returns the total number of bytes in the message, or -1 if it is not MIDI
+    // Tokens that aren't one or two hex digits are skipped and added to invalidTokens
+    int decode(const char *text, int length, quint8 *out, int capacity, int *invalidTokens = Q_NULLPTR);
+
+    // Encodes a message into out, returns the encoded length or -1 if it doesn't fit
+    int encode(const quint8 *msg, int length, char *out, int capacity);
+}
+
+#endif // UDPMIDI_H
@@ -0,0 +1,584 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "udpreceiver.h"
+#include "logwriter.h"
+#include "smfrecorder.h"
+#include "metrics.h"
+#include "preciseclock.h"
+#include "timecodeengine.h"
+#include "clockanalyzer.h"
+#include "outputdispatcher.h"
+#include "mscmessage.h"
+#include "miditransform.h"
+#include "realtime.h"
+#include "nativesocket.h"
+#include <QUdpSocket>
+#include <QNetworkDatagram>
+#include <QMutexLocker>
+#include <QTime>
+#include <QRegExp>
+#include <QStringList>
+#include <cstring>
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <time.h>
+#include <cerrno>
+#endif
+
+// How often the thread looks at the stop flag and configuration while idle
+static const int POLL_INTERVAL_MS = 50;
+
+// Batched reads, each slot large enough for any datagram
+static const int BATCH_SIZE = 16;
+static const int BATCH_DATAGRAM_CAPACITY = 65536;
+
+// Kernel drops are warned about at most this often
+static const qint64 DROP_WARNING_INTERVAL_NS = Q_INT64_C(1000000000);
+
+#ifdef Q_OS_LINUX
+// Kernel arrival timestamps are wall clock time
+static inline qint64 toNs(const timespec &ts)
+{
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static inline qint64 realtimeNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return toNs(ts);
+}
+#endif
+
+UdpReceiver::UdpReceiver(const QHostAddress &address, quint16 port, Metrics *metrics, QObject *parent) :
+    QThread(parent),
+    m_address(address),
+    m_port(port),
+    m_metrics(metrics),
+    m_receiveBufferSize(0),
+    m_stop(false),
+    m_displayEnabled(false),
+    m_notified(false),
+    m_queue(QUEUE_CAPACITY),
+    m_configGeneration(0)
+{
+    m_logLine.reserve(UdpMidi::encodedLength(UdpMidi::MAX_MESSAGE_LENGTH) + 64);
+}
+
+UdpReceiver::~UdpReceiver()
+{
+    stop();
+    wait();
+}
+
+void UdpReceiver::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+}
+
+void UdpReceiver::setFilter(const RxFilter &filter)
+{
+    QMutexLocker lock(&m_configMutex);
+    m_pendingFilter = filter;
+    m_configGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void UdpReceiver::setLogWriter(const QSharedPointer<LogWriter> &writer)
+{
+    QMutexLocker lock(&m_configMutex);
+    m_pendingLogWriter = writer;
+    m_configGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void UdpReceiver::setRecorder(const QSharedPointer<SmfRecorder> &recorder)
+{
+    QMutexLocker lock(&m_configMutex);
+    m_pendingRecorder = recorder;
+    m_configGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void UdpReceiver::setRelay(const QVector<RelayTarget> &targets, bool filtered)
+{
+    QMutexLocker lock(&m_configMutex);
+    m_pendingRelayTargets = targets;
+    m_pendingRelayFiltered = filtered;
+    m_configGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void UdpReceiver::setRelayTransform(const QSharedPointer<const MidiTransform> &transform)
+{
+    QMutexLocker lock(&m_configMutex);
+    m_pendingRelayTransform = transform;
+    m_configGeneration.fetch_add(1, std::memory_order_release);
+}
+
+bool UdpReceiver::parseRelayTargets(const QString &text, QVector<RelayTarget> *targets, QString *error)
+{
+    targets->clear();
+    const QStringList entries = text.split(QRegExp("[,\\s]+"), QString::SkipEmptyParts);
+    foreach(const QString &entry, entries)
+    {
+        const int colon = entry.lastIndexOf(QChar(':'));
+        bool ok = colon > 0;
+        RelayTarget target;
+        if(ok)
+            target.port = entry.mid(colon + 1).toUShort(&ok);
+        if(ok)
+            ok = target.address.setAddress(entry.left(colon)) && target.port != 0;
+        if(!ok)
+        {
+            if(error)
+                *error = tr("\"%1\" is not an address:port").arg(entry);
+            targets->clear();
+            return false;
+        }
+        targets->append(target);
+    }
+    return true;
+}
+
+void UdpReceiver::refreshConfig()
+{
+    int generation = m_configGeneration.load(std::memory_order_acquire);
+    if(generation == m_appliedGeneration)
+        return;
+
+    QMutexLocker lock(&m_configMutex);
+    m_filter = m_pendingFilter;
+    m_logWriter = m_pendingLogWriter;
+    m_recorder = m_pendingRecorder;
+    m_relayTargets = m_pendingRelayTargets;
+    m_relayFiltered = m_pendingRelayFiltered;
+    m_relayTransform = m_pendingRelayTransform;
+    m_appliedGeneration = m_configGeneration.load(std::memory_order_relaxed);
+}
+
+void UdpReceiver::run()
+{
+    QString refused;
+    if(!Realtime::apply(Realtime::ROLE_RECEIVE, &refused))
+        emit error(refused);
+
+    QUdpSocket socket;
+    if(!socket.bind(m_address, m_port, QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint))
+    {
+        emit error(tr("Error binding RX socket : %1").arg(socket.errorString()));
+        return;
+    }
+
+    const NativeSocket::Handle handle = static_cast<NativeSocket::Handle>(socket.socketDescriptor());
+    if(m_expectedRate > 0)
+    {
+        const int bytes = NativeSocket::bufferSizeFor(m_expectedRate);
+        const int granted = NativeSocket::setReceiveBufferSize(handle, bytes);
+        if(granted < bytes)
+            emit error(tr("RX socket buffer limited to %1 KB of %2 KB").arg(granted / 1024).arg(bytes / 1024));
+    }
+    m_receiveBufferSize.store(NativeSocket::receiveBufferSize(handle), std::memory_order_relaxed);
+    m_metrics->setGauge(Metrics::RX_SOCKET_BUFFER_BYTES, m_receiveBufferSize.load(std::memory_order_relaxed));
+
+#ifdef Q_OS_LINUX
+    // Batch reads bring each datagram's arrival time and the kernel's drop count
+    receiveBatches(socket);
+#else
+    if(m_busyPoll)
+        emit error(tr("Busy poll receive needs Linux, waiting for datagrams instead"));
+    receiveDatagrams(socket);
+#endif
+}
+
+#ifndef Q_OS_LINUX
+// One datagram per read, timestamped when Qt hands it over
+void UdpReceiver::receiveDatagrams(QUdpSocket &socket)
+{
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        refreshConfig();
+        if(!socket.waitForReadyRead(POLL_INTERVAL_MS))
+            continue;
+
+        bool pushed = false;
+        while(socket.hasPendingDatagrams())
+        {
+            const qint64 timestamp = PreciseClock::nowNs();
+
+            QNetworkDatagram datagram = socket.receiveDatagram();
+            m_metrics->add(Metrics::RX_SYSCALLS);
+
+            const QByteArray payload = datagram.data();
+            if(processDatagram(socket, payload.constData(), payload.size(), datagram.senderAddress(),
+                               static_cast<quint16>(datagram.senderPort()), timestamp))
+                pushed = true;
+        }
+
+        m_metrics->setGauge(Metrics::RX_QUEUE_DEPTH, m_queue.size());
+        if(pushed && !m_notified.exchange(true, std::memory_order_acq_rel))
+            emit eventsAvailable();
+    }
+}
+#endif
+
+#ifdef Q_OS_LINUX
+void UdpReceiver::receiveBatches(QUdpSocket &socket)
+{
+    const int fd = static_cast<int>(socket.socketDescriptor());
+    // Arrival times and drop counts come with each datagram
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    if(setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) != 0)
+        emit error(tr("Kernel drop counts unavailable : %1").arg(QString::fromLocal8Bit(strerror(errno))));
+    if(m_busyPoll && m_kernelBusyPollUs > 0
+            && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &m_kernelBusyPollUs, sizeof(m_kernelBusyPollUs)) != 0)
+        emit error(tr("SO_BUSY_POLL refused : %1").arg(QString::fromLocal8Bit(strerror(errno))));
+
+    // One batch of datagrams per syscall, each with its sender, arrival time and drop count
+    QVector<char> buffers(BATCH_SIZE * BATCH_DATAGRAM_CAPACITY);
+    mmsghdr messages[BATCH_SIZE];
+    iovec vectors[BATCH_SIZE];
+    sockaddr_in senders[BATCH_SIZE];
+    alignas(cmsghdr) char controls[BATCH_SIZE][CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(quint32))];
+    for(int i=0; i<BATCH_SIZE; i++)
+    {
+        vectors[i].iov_base = buffers.data() + i * BATCH_DATAGRAM_CAPACITY;
+        vectors[i].iov_len = BATCH_DATAGRAM_CAPACITY;
+        memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_name = &senders[i];
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = controls[i];
+    }
+
+    // Without busy polling every batch is read after sleeping in poll()
+    const qint64 idleNs = qint64(m_spinIdleUs) * 1000;
+    qint64 lastDatagram = PreciseClock::nowNs();
+    bool spinning = m_busyPoll;
+
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        refreshConfig();
+
+        // Sleep until readable, unless busy polling and traffic has been seen within the idle period
+        if(!spinning)
+        {
+            pollfd readable;
+            readable.fd = fd;
+            readable.events = POLLIN;
+            readable.revents = 0;
+            if(poll(&readable, 1, POLL_INTERVAL_MS) <= 0)
+                continue;
+        }
+
+        for(int i=0; i<BATCH_SIZE; i++)
+        {
+            messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            messages[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+        }
+        const int count = recvmmsg(fd, messages, BATCH_SIZE, MSG_DONTWAIT, Q_NULLPTR);
+        if(count <= 0)
+        {
+            if(spinning && PreciseClock::nowNs() - lastDatagram > idleNs)
+                spinning = false;
+            continue;
+        }
+
+        const qint64 timestamp = PreciseClock::nowNs();
+        const qint64 now = realtimeNs();
+        const Metrics::Histogram wakeup = spinning ? Metrics::RX_SPIN_LATENCY : Metrics::RX_WAKEUP_LATENCY;
+        m_metrics->add(Metrics::RX_SYSCALLS);
+
+        bool pushed = false;
+        quint32 kernelDrops = m_kernelDrops;
+        for(int i=0; i<count; i++)
+        {
+            msghdr &header = messages[i].msg_hdr;
+            for(cmsghdr *c = CMSG_FIRSTHDR(&header); c; c = CMSG_NXTHDR(&header, c))
+            {
+                if(c->cmsg_level != SOL_SOCKET)
+                    continue;
+                if(c->cmsg_type == SCM_TIMESTAMPNS)
+                {
+                    timespec arrival;
+                    memcpy(&arrival, CMSG_DATA(c), sizeof(arrival));
+                    m_metrics->record(wakeup, now - toNs(arrival));
+                }
+                else if(c->cmsg_type == SO_RXQ_OVFL)
+                {
+                    quint32 drops;
+                    memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+                    kernelDrops = drops;
+                }
+            }
+
+            const sockaddr_in &sender = senders[i];
+            if(processDatagram(socket, static_cast<const char *>(vectors[i].iov_base), static_cast<int>(messages[i].msg_len),
+                               QHostAddress(ntohl(sender.sin_addr.s_addr)), ntohs(sender.sin_port), timestamp))
+                pushed = true;
+        }
+        lastDatagram = timestamp;
+        spinning = m_busyPoll;
+
+        // The count is the socket's total so far, carried by datagrams queued after a drop
+        if(kernelDrops != m_kernelDrops)
+        {
+            handleKernelDrops(fd, kernelDrops - m_kernelDrops, timestamp);
+            m_kernelDrops = kernelDrops;
+        }
+
+        m_metrics->setGauge(Metrics::RX_QUEUE_DEPTH, m_queue.size());
+        if(pushed && !m_notified.exchange(true, std::memory_order_acq_rel))
+            emit eventsAvailable();
+    }
+}
+
+void UdpReceiver::handleKernelDrops(int fd, quint32 drops, qint64 timestamp)
+{
+    m_metrics->add(Metrics::RX_KERNEL_DROPS, drops);
+    m_unreportedDrops += drops;
+
+    // Room for twice the burst next time, up to the limit
+    int size = m_receiveBufferSize.load(std::memory_order_relaxed);
+    bool grown = false;
+    if(m_bufferGrowLimit > size)
+    {
+        int granted = NativeSocket::setReceiveBufferSize(fd, static_cast<int>(qMin<qint64>(qint64(size) * 2, m_bufferGrowLimit)));
+        if(granted > size)
+        {
+            size = granted;
+            grown = true;
+            m_receiveBufferSize.store(size, std::memory_order_relaxed);
+            m_metrics->setGauge(Metrics::RX_SOCKET_BUFFER_BYTES, size);
+        }
+    }
+
+    if(grown || timestamp - m_lastDropWarning >= DROP_WARNING_INTERVAL_NS)
+    {
+        emit error(grown ? tr("Kernel dropped %1 datagrams, RX socket buffer grown to %2 KB").arg(m_unreportedDrops).arg(size / 1024)
+                         : tr("Kernel dropped %1 datagrams, RX socket buffer is %2 KB").arg(m_unreportedDrops).arg(size / 1024));
+        m_unreportedDrops = 0;
+        m_lastDropWarning = timestamp;
+    }
+}
+#endif
+
+bool UdpReceiver::processDatagram(QUdpSocket &socket, const char *payload, int payloadLength, const QHostAddress &senderAddress, quint16 senderPort, qint64 timestamp)
+{
+    quint8 midi[UdpMidi::MAX_MESSAGE_LENGTH];
+    int invalidTokens = 0;
+    int midiLength = UdpMidi::decode(payload, payloadLength, midi, sizeof(midi), &invalidTokens);
+    int storedLength = qMin(midiLength, UdpMidi::MAX_MESSAGE_LENGTH);
+    quint32 sender = senderAddress.toIPv4Address();
+    const bool displayEnabled = m_displayEnabled.load(std::memory_order_relaxed);
+    bool pushed = false;
+
+    m_metrics->add(Metrics::RX_DATAGRAMS);
+    m_metrics->add(Metrics::RX_BYTES, payloadLength);
+    if(invalidTokens > 0)
+        m_metrics->add(Metrics::RX_PARSE_ERRORS, invalidTokens);
+
+    // Unless it has to pass the filter or be rewritten first, relay before any parsing
+    const bool relaying = !m_relayTargets.isEmpty();
+    const bool relayAfterFilter = m_relayFiltered && !m_filter.isEmpty();
+    const bool rewrite = relaying && m_relayTransform && midiLength > 0;
+    if(relaying && !relayAfterFilter && !rewrite)
+        relay(socket, payload, payloadLength, senderAddress, senderPort, timestamp);
+
+    if(midiLength > 0)
+    {
+        // A datagram may hold several messages or part of one, so it is
+        // parsed as the continuation of everything its sender sent before
+        MidiStreamParser &parser = m_parsers.parserFor(sender, senderPort);
+        const quint64 errors = parser.errors();
+        bool logged = false;
+        bool passed = false;
+        int rewrittenLength = 0;
+
+        auto handleMessage = [&](const quint8 *msg, int length)
+        {
+            m_metrics->add(Metrics::RX_MESSAGES);
+            if(rewrite && rewrittenLength + length <= REWRITE_CAPACITY)
+            {
+                memcpy(m_rewritten + rewrittenLength, msg, length);
+                m_relayTransform->apply(m_rewritten + rewrittenLength, length);
+                rewrittenLength += length;
+            }
+            // Played before anything else is done with it, never behind the GUI
+            if(m_outputDispatcher)
+                m_outputDispatcher->playReceived(msg, length, timestamp);
+            if(m_timecodeEngine)
+                m_timecodeEngine->process(msg, length, timestamp);
+            if(m_clockAnalyzer)
+                m_clockAnalyzer->process(msg, length, timestamp);
+
+            // Show Control is decoded once for the filter, the log and the display
+            MscMessage msc;
+            const MscMessage *decodedMsc = MscMessage::decode(msg, length, msc) ? &msc : Q_NULLPTR;
+
+            // Filter before anything is formatted
+            const bool pass = m_filter.isEmpty() || m_filter.matches(sender, msg, length, decodedMsc);
+            if(!pass)
+                m_metrics->add(Metrics::RX_FILTERED);
+            else
+            {
+                passed = true;
+                // The log keeps whole datagrams, written once if anything in them passes
+                if(m_logWriter && !logged)
+                {
+                    logDatagram(sender, payload, payloadLength, decodedMsc);
+                    logged = true;
+                }
+                if(m_recorder)
+                    m_recorder->record(timestamp, msg, length);
+            }
+
+            Event event;
+            event.timestamp = timestamp;
+            event.record.address = sender;
+            event.record.port = senderPort;
+            event.record.set(msg, length, MessageRecord::FLAG_MIDI);
+            if(pass && displayEnabled)
+                event.record.flags |= MessageRecord::FLAG_DISPLAY;
+            if(decodedMsc)
+                event.record.flags |= MessageRecord::FLAG_MSC;
+
+            if(m_queue.push(event))
+                pushed = true;
+            else
+                m_metrics->add(Metrics::RX_QUEUE_DROPS);
+        };
+        parser.parse(midi, storedLength, handleMessage);
+
+        // Whatever was cut off can't be continued by the next datagram
+        if(midiLength > storedLength)
+        {
+            parser.reset();
+            m_metrics->add(Metrics::RX_PARSE_ERRORS);
+        }
+        m_metrics->add(Metrics::RX_PARSE_ERRORS, parser.errors() - errors);
+
+        if(relaying && (passed || !relayAfterFilter))
+        {
+            if(rewrite)
+            {
+                int textLength = UdpMidi::encode(m_rewritten, rewrittenLength, m_rewrittenText, sizeof(m_rewrittenText));
+                if(rewrittenLength > 0 && textLength > 0)
+                    relay(socket, m_rewrittenText, textLength, senderAddress, senderPort, timestamp);
+            }
+            else if(relayAfterFilter)
+                relay(socket, payload, payloadLength, senderAddress, senderPort, timestamp);
+        }
+    }
+    else
+    {
+        m_metrics->add(Metrics::RX_PARSE_ERRORS);
+
+        // Anything that isn't MIDI only gets through an empty filter, as text
+        if(m_filter.isEmpty())
+        {
+            if(m_logWriter)
+                logDatagram(sender, payload, payloadLength, Q_NULLPTR);
+            if(displayEnabled)
+            {
+                Event event;
+                event.timestamp = timestamp;
+                event.record.address = sender;
+                event.record.port = senderPort;
+                event.record.set(payload, payloadLength, MessageRecord::FLAG_DISPLAY);
+                if(m_queue.push(event))
+                    pushed = true;
+                else
+                    m_metrics->add(Metrics::RX_QUEUE_DROPS);
+            }
+        }
+        else
+            m_metrics->add(Metrics::RX_FILTERED);
+    }
+
+    m_metrics->record(Metrics::RX_PROCESSING_TIME, PreciseClock::nowNs() - timestamp);
+    return pushed;
+}
+
+void UdpReceiver::relay(QUdpSocket &socket, const char *data, int length, const QHostAddress &sender, quint16 senderPort, qint64 timestamp)
+{
+    for(int i=0; i<m_relayTargets.count(); i++)
+    {
+        const RelayTarget &target = m_relayTargets.at(i);
+        // Never back to where it came from, so two relays can't loop
+        if(target.port == senderPort && target.address == sender)
+            continue;
+        if(socket.writeDatagram(data, length, target.address, target.port) == length)
+            m_metrics->add(Metrics::RELAY_DATAGRAMS);
+        else
+            m_metrics->add(Metrics::RELAY_ERRORS);
+    }
+    m_metrics->record(Metrics::RELAY_LATENCY, PreciseClock::nowNs() - timestamp);
+}
+
+static inline char *appendDecimal(char *p, int value, int digits)
+{
+    for(int i=digits-1; i>=0; i--)
+    {
+        p[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return p + digits;
+}
+
+void UdpReceiver::logDatagram(quint32 sender, const char *payload, int length, const MscMessage *msc)
+{
+    formatLogLine(m_logLine, sender, payload, length, msc);
+    m_logWriter->append(m_logLine);
+}
+
+void UdpReceiver::formatLogLine(QByteArray &line, quint32 sender, const char *payload, int length, const MscMessage *msc)
+{
+    // hh:mm:ss:zzz,a.b.c.d,payload[,show control description]
+    char prefix[32];
+    char *p = prefix;
+    int msecs = QTime::currentTime().msecsSinceStartOfDay();
+    p = appendDecimal(p, msecs / 3600000, 2);
+    *p++ = ':';
+    p = appendDecimal(p, (msecs / 60000) % 60, 2);
+    *p++ = ':';
+    p = appendDecimal(p, (msecs / 1000) % 60, 2);
+    *p++ = ':';
+    p = appendDecimal(p, msecs % 1000, 3);
+    *p++ = ',';
+    for(int shift=24; shift>=0; shift-=8)
+    {
+        int octet = (sender >> shift) & 0xFF;
+        p = appendDecimal(p, octet, octet >= 100 ? 3 : octet >= 10 ? 2 : 1);
+        *p++ = shift ? '.' : ',';
+    }
+
+    line.resize(0);
+    line.append(prefix, static_cast<int>(p - prefix));
+    line.append(payload, length);
+    if(msc)
+    {
+        char description[256];
+        line.append(',');
+        line.append(description, msc->describe(description, sizeof(description)));
+    }
+    line.append("\r\n", 2);
+}
@@ -0,0 +1,191 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef UDPRECEIVER_H
+#define UDPRECEIVER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QHostAddress>
+#include <QSharedPointer>
+#include <QVector>
+#include <atomic>
+#include "messagerecord.h"
+#include "rxfilter.h"
+#include "spscqueue.h"
+#include "udpmidi.h"
+#include "midistreamparser.h"
+
+class LogWriter;
+class SmfRecorder;
+class Metrics;
+class TimecodeEngine;
+class ClockAnalyzer;
+class OutputDispatcher;
+struct MscMessage;
+class QUdpSocket;
+class MidiTransform;
+
+// Receives gateway datagrams on a dedicated thread
+// Each datagram is decoded and parsed as part of its sender's MIDI stream.
+// Every complete message is counted, run through the receive filter and,
+// if it passes, logged before anything is formatted for display. Results are
+// handed to the GUI thread as compact events through a lock free queue.
+// Datagrams can also be relayed to other destinations, byte for byte unless
+// a transform has to rewrite them.
+class UdpReceiver : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Event
+    {
+        qint64 timestamp;       // PreciseClock receive time
+        MessageRecord record;
+    };
+
+    // Where relayed datagrams are sent
+    struct RelayTarget
+    {
+        QHostAddress address;
+        quint16 port;
+    };
+
+    static const int QUEUE_CAPACITY = 65536;
+
+    UdpReceiver(const QHostAddress &address, quint16 port, Metrics *metrics, QObject *parent = Q_NULLPTR);
+    ~UdpReceiver();
+
+    void stop();
+
+    // Thread safe, picked up by the receive thread before its next datagram
+    void setFilter(const RxFilter &filter);
+    void setLogWriter(const QSharedPointer<LogWriter> &writer);
+    void setRecorder(const QSharedPointer<SmfRecorder> &recorder);
+    // Relays every datagram, or with filtered only those with a message the
+    // filter passes, to each target from the receive socket
+    void setRelay(const QVector<RelayTarget> &targets, bool filtered);
+
+    // Relayed MIDI is rewritten, and so re-encoded, while a transform is set
+    void setRelayTransform(const QSharedPointer<const MidiTransform> &transform);
+
+    // "address:port" entries separated by commas or spaces
+    static bool parseRelayTargets(const QString &text, QVector<RelayTarget> *targets, QString *error);
+
+    // One log file line: "hh:mm:ss:zzz,a.b.c.d,payload[,show control description]"
+    static void formatLogLine(QByteArray &line, quint32 sender, const char *payload, int length, const MscMessage *msc);
+
+    void setDisplayEnabled(bool enabled) { m_displayEnabled.store(enabled, std::memory_order_relaxed); }
+
+    // Set before start(), fed with every message at its receive time
+    void setTimecodeEngine(TimecodeEngine *engine) { m_timecodeEngine = engine; }
+    void setClockAnalyzer(ClockAnalyzer *analyzer) { m_clockAnalyzer = analyzer; }
+    // Set before start(), offered every message straight away for local playback
+    void setOutputDispatcher(OutputDispatcher *dispatcher) { m_outputDispatcher = dispatcher; }
+    // Set before start(). Linux only: spin on non-blocking batch reads instead of
+    // sleeping until a datagram arrives, and sleep again after idleUs without one.
+    // kernelBusyPollUs sets SO_BUSY_POLL, 0 leaves it off.
+    void setBusyPoll(bool enabled, int idleUs, int kernelBusyPollUs)
+    {
+        m_busyPoll = enabled;
+        m_spinIdleUs = idleUs;
+        m_kernelBusyPollUs = kernelBusyPollUs;
+    }
+    // Set before start(). Sizes the socket buffer for expectedRate datagrams/s,
+    // 0 for the OS default. On Linux kernel drops are counted and warned about,
+    // and the buffer doubles after each drop up to growLimit bytes, 0 to stay put.
+    void setBufferPolicy(int expectedRate, int growLimit)
+    {
+        m_expectedRate = expectedRate;
+        m_bufferGrowLimit = growLimit;
+    }
+    int receiveBufferSize() const { return m_receiveBufferSize.load(std::memory_order_relaxed); }
+
+    // Consumer side, call beginDrain() then takeEvent() until it returns false
+    void beginDrain() { m_notified.store(false, std::memory_order_release); }
+    bool takeEvent(Event &event) { return m_queue.pop(event); }
+
+signals:
+    // Emitted once until the consumer calls beginDrain()
+    void eventsAvailable();
+    void error(const QString &message);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void refreshConfig();
+    void receiveBatches(QUdpSocket &socket);
+    void receiveDatagrams(QUdpSocket &socket);
+    void handleKernelDrops(int fd, quint32 drops, qint64 timestamp);
+    // Returns whether an event was queued
+    bool processDatagram(QUdpSocket &socket, const char *payload, int payloadLength,
+                         const QHostAddress &senderAddress, quint16 senderPort, qint64 timestamp);
+    void logDatagram(quint32 sender, const char *payload, int length, const MscMessage *msc);
+    void relay(QUdpSocket &socket, const char *data, int length, const QHostAddress &sender, quint16 senderPort, qint64 timestamp);
+
+    const QHostAddress m_address;
+    const quint16 m_port;
+    Metrics *m_metrics;
+    TimecodeEngine *m_timecodeEngine = Q_NULLPTR;
+    ClockAnalyzer *m_clockAnalyzer = Q_NULLPTR;
+    OutputDispatcher *m_outputDispatcher = Q_NULLPTR;
+    bool m_busyPoll = false;
+    int m_spinIdleUs = 0;
+    int m_kernelBusyPollUs = 0;
+    int m_expectedRate = 0;
+    int m_bufferGrowLimit = 0;
+    std::atomic<int> m_receiveBufferSize;
+    quint32 m_kernelDrops = 0;
+    quint64 m_unreportedDrops = 0;
+    qint64 m_lastDropWarning = 0;
+
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_displayEnabled;
+    std::atomic<bool> m_notified;
+    SpscQueue<Event> m_queue;
+
+    // Written by other threads under m_configMutex
+    QMutex m_configMutex;
+    std::atomic<int> m_configGeneration;
+    RxFilter m_pendingFilter;
+    QSharedPointer<LogWriter> m_pendingLogWriter;
+    QSharedPointer<SmfRecorder> m_pendingRecorder;
+    QVector<RelayTarget> m_pendingRelayTargets;
+    bool m_pendingRelayFiltered = false;
+    QSharedPointer<const MidiTransform> m_pendingRelayTransform;
+
+    // Receive thread only
+    int m_appliedGeneration = -1;
+    RxFilter m_filter;
+    QSharedPointer<LogWriter> m_logWriter;
+    QSharedPointer<SmfRecorder> m_recorder;
+    QVector<RelayTarget> m_relayTargets;
+    bool m_relayFiltered = false;
+    QSharedPointer<const MidiTransform> m_relayTransform;
+    // Running status is expanded when rewriting, so a datagram can grow by half
+    static const int REWRITE_CAPACITY = UdpMidi::MAX_MESSAGE_LENGTH * 2;
+    quint8 m_rewritten[REWRITE_CAPACITY];
+    char m_rewrittenText[UdpMidi::encodedLength(REWRITE_CAPACITY)];
+    MidiSourceParsers m_parsers;
+    QByteArray m_logLine;
+};
+
+#endif // UDPRECEIVER_H
@@ -0,0 +1,56 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "uiupdatescheduler.h"
+
+UiUpdateScheduler::UiUpdateScheduler(int refreshRate, QObject *parent) :
+    QObject(parent),
+    m_refreshRate(0),
+    m_dirty(0),
+    m_messages(0)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+    setRefreshRate(refreshRate);
+}
+
+void UiUpdateScheduler::setRefreshRate(int hz)
+{
+    m_refreshRate = qBound(1, hz, 240);
+    m_timer.start(1000 / m_refreshRate);
+}
+
+void UiUpdateScheduler::tick()
+{
+    quint32 flags = m_dirty.exchange(0, std::memory_order_relaxed);
+    int messages = m_messages.exchange(0, std::memory_order_relaxed);
+
+    // One more frame after activity stops, so counters can drop back to zero
+    if(flags == 0 && messages == 0)
+    {
+        if(m_idle)
+            return;
+        m_idle = true;
+    }
+    else
+        m_idle = false;
+
+    emit frame(flags, messages);
+}
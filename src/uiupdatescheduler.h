@@ -0,0 +1,71 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef UIUPDATESCHEDULER_H
+#define UIUPDATESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <atomic>
+
+// Collects UI state changes and applies them at most once per frame
+// Producers, on any thread, only set flags and bump counters. The frame()
+// signal is emitted on the scheduler's thread at the refresh rate, and only
+// when something changed since the previous frame.
+class UiUpdateScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum UpdateFlag {
+        UPDATE_RX_MESSAGES = 0x01,
+        UPDATE_TX_MESSAGES = 0x02,
+        UPDATE_LOG_INFO = 0x04,
+        UPDATE_TIMECODE = 0x08,
+        // Generators, players and sessions that are polled each frame
+        UPDATE_STATUS = 0x10
+    };
+
+    static const int DEFAULT_REFRESH_RATE = 30;
+
+    explicit UiUpdateScheduler(int refreshRate = DEFAULT_REFRESH_RATE, QObject *parent = Q_NULLPTR);
+
+    void setRefreshRate(int hz);
+    int refreshRate() const { return m_refreshRate; }
+
+    // Thread safe
+    void markDirty(quint32 flags) { m_dirty.fetch_or(flags, std::memory_order_relaxed); }
+    void countMessages(int count = 1) { m_messages.fetch_add(count, std::memory_order_relaxed); }
+
+signals:
+    void frame(quint32 flags, int messagesSinceLastFrame);
+
+private slots:
+    void tick();
+
+private:
+    QTimer m_timer;
+    int m_refreshRate;
+    std::atomic<quint32> m_dirty;
+    std::atomic<int> m_messages;
+    bool m_idle = true;
+};
+
+#endif // UIUPDATESCHEDULER_H
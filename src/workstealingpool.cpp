@@ -0,0 +1,146 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "workstealingpool.h"
+#include <QMutexLocker>
+
+// Upper bound on an idle worker's sleep, in case a wake up races with it
+static const unsigned long IDLE_WAIT_MS = 50;
+
+namespace
+{
+    // Which pool and deque the current thread works for, if any
+    thread_local const void *t_pool = Q_NULLPTR;
+    thread_local int t_index = -1;
+}
+
+class WorkStealingPool::Worker : public QThread
+{
+public:
+    Worker(WorkStealingPool *pool, int index) : m_pool(pool), m_index(index) {}
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        t_pool = m_pool;
+        t_index = m_index;
+        m_pool->work(m_index);
+    }
+
+private:
+    WorkStealingPool *m_pool;
+    int m_index;
+};
+
+WorkStealingPool::WorkStealingPool(int threadCount) :
+    m_queued(0),
+    m_sleeping(0),
+    m_next(0),
+    m_steals(0),
+    m_stop(false)
+{
+    threadCount = qMax(1, threadCount);
+    for(int i=0; i<threadCount; i++)
+        m_deques.append(new Deque);
+    for(int i=0; i<threadCount; i++)
+    {
+        m_workers.append(new Worker(this, i));
+        m_workers.last()->start();
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+    {
+        QMutexLocker lock(&m_sleepMutex);
+        m_wake.wakeAll();
+    }
+    foreach(Worker *worker, m_workers)
+        worker->wait();
+    qDeleteAll(m_workers);
+    qDeleteAll(m_deques);
+}
+
+void WorkStealingPool::submit(Task *task)
+{
+    const int count = m_deques.count();
+    const int index = t_pool == this ? t_index
+                                     : static_cast<int>(m_next.fetch_add(1, std::memory_order_relaxed) % count);
+    {
+        QMutexLocker lock(&m_deques[index]->mutex);
+        m_deques[index]->tasks.append(task);
+    }
+
+    // Either a worker about to sleep sees the task, or it is counted as sleeping here
+    m_queued.fetch_add(1, std::memory_order_seq_cst);
+    if(m_sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        QMutexLocker lock(&m_sleepMutex);
+        m_wake.wakeOne();
+    }
+}
+
+WorkStealingPool::Task *WorkStealingPool::take(int index)
+{
+    // Newest first from our own deque
+    {
+        Deque *own = m_deques[index];
+        QMutexLocker lock(&own->mutex);
+        if(!own->tasks.isEmpty())
+        {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return own->tasks.takeLast();
+        }
+    }
+
+    // Oldest first from the others, starting with the next one along
+    const int count = m_deques.count();
+    for(int i=1; i<count; i++)
+    {
+        Deque *victim = m_deques[(index + i) % count];
+        QMutexLocker lock(&victim->mutex);
+        if(!victim->tasks.isEmpty())
+        {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return victim->tasks.takeFirst();
+        }
+    }
+    return Q_NULLPTR;
+}
+
+void WorkStealingPool::work(int index)
+{
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        if(Task *task = take(index))
+        {
+            task->run();
+            continue;
+        }
+
+        QMutexLocker lock(&m_sleepMutex);
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if(m_queued.load(std::memory_order_seq_cst) <= 0 && !m_stop.load(std::memory_order_relaxed))
+            m_wake.wait(&m_sleepMutex, IDLE_WAIT_MS);
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QVector>
+#include <atomic>
+
+// Fixed set of worker threads that steal work from each other
+// Every worker has its own deque. Tasks submitted from a worker go to the
+// back of its own and it takes from the back, so related work stays on one
+// core; a worker with nothing to do takes from the front of another's. Tasks
+// submitted from other threads are dealt out round robin.
+class WorkStealingPool
+{
+public:
+    class Task
+    {
+    public:
+        virtual ~Task() {}
+        virtual void run() = 0;
+    };
+
+    explicit WorkStealingPool(int threadCount = QThread::idealThreadCount());
+    // Stops the workers; tasks still queued are not run
+    ~WorkStealingPool();
+
+    // Thread safe. The pool does not own tasks, which must outlive their run.
+    void submit(Task *task);
+
+    int threadCount() const { return m_workers.count(); }
+    quint64 steals() const { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+    class Worker;
+
+    struct Deque
+    {
+        QMutex mutex;
+        QList<Task *> tasks;
+    };
+
+    Task *take(int index);
+    void work(int index);
+
+    QVector<Worker *> m_workers;
+    QVector<Deque *> m_deques;
+    std::atomic<int> m_queued;
+    std::atomic<int> m_sleeping;
+    std::atomic<unsigned> m_next;
+    std::atomic<quint64> m_steals;
+    std::atomic<bool> m_stop;
+    QMutex m_sleepMutex;
+    QWaitCondition m_wake;
+
+    Q_DISABLE_COPY(WorkStealingPool)
+};
+
+#endif // WORKSTEALINGPOOL_H
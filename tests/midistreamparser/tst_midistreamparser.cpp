@@ -0,0 +1,278 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "midistreamparser.h"
+#include "udpmidi.h"
+#include <QElapsedTimer>
+#include <QtTest>
+
+// Streams are written the way the gateway sends them, as spaced hex bytes
+class TestMidiStreamParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void runningStatus();
+    void realtimeInSysex();
+    void sysexAcrossDatagrams();
+    void strayBytes();
+    void sourceCap();
+    void benchmarkThroughput();
+};
+
+namespace
+{
+    // Most MIDI bytes one datagram carries inside a 1500 byte Ethernet MTU
+    const int DATAGRAM_BYTES = (1472 - UdpMidi::HEADER_LENGTH) / 3;
+
+    QByteArray bytes(const char *hex)
+    {
+        QByteArray text(UdpMidi::HEADER);
+        text.append(' ').append(hex);
+        QByteArray data(UdpMidi::MAX_MESSAGE_LENGTH, 0);
+        const int length = UdpMidi::decode(text.constData(), text.length(),
+                                           reinterpret_cast<quint8 *>(data.data()), data.length());
+        return data.left(length);
+    }
+
+    // Every message in hex, separated by |
+    struct Recorder
+    {
+        QByteArray messages;
+
+        void operator()(const quint8 *msg, int length)
+        {
+            static const char DIGITS[] = "0123456789ABCDEF";
+            if(!messages.isEmpty())
+                messages.append('|');
+            for(int i=0; i<length; i++)
+            {
+                if(i)
+                    messages.append(' ');
+                messages.append(DIGITS[msg[i] >> 4]).append(DIGITS[msg[i] & 0x0F]);
+            }
+        }
+    };
+
+    struct Counter
+    {
+        quint64 messages = 0;
+        quint64 bytes = 0;
+
+        void operator()(const quint8 *, int length)
+        {
+            messages++;
+            bytes += length;
+        }
+    };
+
+    template <typename Sink>
+    void parse(MidiStreamParser &parser, const QByteArray &data, Sink &sink)
+    {
+        parser.parse(reinterpret_cast<const quint8 *>(data.constData()), data.length(), sink);
+    }
+
+    // As the receiver hands them over, one datagram at a time
+    template <typename Sink>
+    void parseDatagrams(MidiStreamParser &parser, const QByteArray &data, Sink &sink)
+    {
+        const quint8 *p = reinterpret_cast<const quint8 *>(data.constData());
+        for(int offset=0; offset<data.length(); offset+=DATAGRAM_BYTES)
+            parser.parse(p + offset, qMin(DATAGRAM_BYTES, data.length() - offset), sink);
+    }
+}
+
+void TestMidiStreamParser::runningStatus()
+{
+    MidiStreamParser parser;
+    Recorder recorder;
+    parse(parser, bytes("90 3C 7F 3E 7F 40 00 B0 07 64 08 40"), recorder);
+    QCOMPARE(recorder.messages, QByteArray("90 3C 7F|90 3E 7F|90 40 00|B0 07 64|B0 08 40"));
+
+    // Carried into the next datagram, with one data byte messages too
+    Recorder next;
+    parse(parser, bytes("0A 00"), next);
+    parse(parser, bytes("C0 05 06"), next);
+    QCOMPARE(next.messages, QByteArray("B0 0A 00|C0 05|C0 06"));
+
+    // Real time bytes leave it alone, anywhere in a message
+    Recorder realtime;
+    parse(parser, bytes("90 3C F8 7F 3E FE 00"), realtime);
+    QCOMPARE(realtime.messages, QByteArray("F8|90 3C 7F|FE|90 3E 00"));
+    QCOMPARE(parser.errors(), quint64(0));
+
+    // System common messages cancel it
+    Recorder common;
+    parse(parser, bytes("F2 01 02 40"), common);
+    QCOMPARE(common.messages, QByteArray("F2 01 02"));
+    QCOMPARE(parser.errors(), quint64(1));
+}
+
+void TestMidiStreamParser::realtimeInSysex()
+{
+    MidiStreamParser parser;
+    Recorder recorder;
+    parse(parser, bytes("F0 7D 01 F8 02 FA 03 F7"), recorder);
+    QCOMPARE(recorder.messages, QByteArray("F8|FA|F0 7D 01 02 03 F7"));
+
+    // Any other status byte ends the SysEx as if F7 had come first
+    Recorder unterminated;
+    parse(parser, bytes("F0 7D 01 F8 02 90 3C 7F"), unterminated);
+    QCOMPARE(unterminated.messages, QByteArray("F8|F0 7D 01 02 F7|90 3C 7F"));
+    QCOMPARE(parser.errors(), quint64(0));
+}
+
+void TestMidiStreamParser::sysexAcrossDatagrams()
+{
+    // MSC GO 1.5 in list 1, then a note
+    const QByteArray stream = bytes("F0 7F 7F 02 01 01 31 2E 35 00 31 F7 90 3C 7F");
+    const QByteArray expected("F0 7F 7F 02 01 01 31 2E 35 00 31 F7|90 3C 7F");
+
+    for(int split=1; split<stream.length(); split++)
+    {
+        MidiStreamParser parser;
+        Recorder recorder;
+        parse(parser, stream.left(split), recorder);
+        parse(parser, stream.mid(split), recorder);
+        QVERIFY2(recorder.messages == expected, qPrintable(QString("split at %1").arg(split)));
+        QCOMPARE(parser.errors(), quint64(0));
+    }
+
+    // A byte per datagram, with clock in between
+    MidiStreamParser parser;
+    Recorder recorder;
+    const QByteArray clock = bytes("F8");
+    for(int i=0; i<stream.length(); i++)
+    {
+        parse(parser, stream.mid(i, 1), recorder);
+        parse(parser, clock, recorder);
+    }
+    QByteArray interleaved;
+    for(int i=0; i<11; i++)
+        interleaved.append("F8|");
+    interleaved.append("F0 7F 7F 02 01 01 31 2E 35 00 31 F7|F8|F8|F8|90 3C 7F|F8");
+    QCOMPARE(recorder.messages, interleaved);
+
+    // Longer than the buffer, across many datagrams: dropped and counted
+    QByteArray tooLong = bytes("F0 7D");
+    tooLong.append(QByteArray(MidiStreamParser::SYSEX_CAPACITY, 0x01));
+    tooLong.append(bytes("F7 90 3C 7F"));
+    MidiStreamParser overflowed;
+    Recorder after;
+    parseDatagrams(overflowed, tooLong, after);
+    QCOMPARE(after.messages, QByteArray("90 3C 7F"));
+    QCOMPARE(overflowed.errors(), quint64(1));
+}
+
+void TestMidiStreamParser::strayBytes()
+{
+    MidiStreamParser parser;
+    Recorder recorder;
+    // Data with no status, an undefined status, a message cut short and an F7 on its own
+    parse(parser, bytes("3C 7F F4 01 90 3C 80 3C 40 F7"), recorder);
+    QCOMPARE(recorder.messages, QByteArray("80 3C 40"));
+    QCOMPARE(parser.errors(), quint64(6));
+}
+
+void TestMidiStreamParser::sourceCap()
+{
+    MidiSourceParsers parsers;
+    Recorder recorder;
+    const QByteArray noteOn = bytes("90 3C");
+    const QByteArray velocity = bytes("7F");
+
+    // Each address and port is a stream of its own
+    parse(parsers.parserFor(1, 5000), noteOn, recorder);
+    parse(parsers.parserFor(1, 5001), velocity, recorder);
+    QVERIFY(recorder.messages.isEmpty());
+    QCOMPARE(parsers.parserFor(1, 5001).errors(), quint64(1));
+
+    // Up to the cap every sender keeps its partial message
+    for(int sender=2; sender<MidiSourceParsers::MAX_SOURCES; sender++)
+        parsers.parserFor(quint32(sender), 5000);
+    parse(parsers.parserFor(1, 5000), velocity, recorder);
+    QCOMPARE(recorder.messages, QByteArray("90 3C 7F"));
+
+    // One more sender drops them all rather than growing
+    parse(parsers.parserFor(1, 5000), noteOn, recorder);
+    parsers.parserFor(quint32(MidiSourceParsers::MAX_SOURCES), 5000);
+    MidiStreamParser &restarted = parsers.parserFor(1, 5000);
+    parse(restarted, velocity, recorder);
+    QCOMPARE(recorder.messages, QByteArray("90 3C 7F"));
+    QCOMPARE(restarted.errors(), quint64(1));
+}
+
+void TestMidiStreamParser::benchmarkThroughput()
+{
+    // Notes and controllers under running status, clock and MTC throughout,
+    // also inside SysEx, MSC and a longer manufacturer SysEx
+    QByteArray stream;
+    while(stream.length() < 1024 * 1024)
+    {
+        stream.append(bytes("90 3C 64 3E 64 40 64 F8 43 64 80 3C 40 3E 40 40 40 43 40"));
+        stream.append(bytes("B0 07 64 0B 7F 01 20 F1 12"));
+        stream.append(bytes("F0 7F 7F 02 01 01 31 F8 2E 35 00 31 F7"));
+        stream.append(bytes("F0 7D 01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F 10 11 12 13 14 F8 15 16 17 18 19 1A 1B 1C 1D 1E 1F F7"));
+        stream.append(bytes("E0 00 40 F8 C0 05 F1 23"));
+    }
+
+    // The datagram boundaries must cut through SysEx somewhere
+    bool sysexSplit = false;
+    bool inSysex = false;
+    for(int i=0; i<stream.length(); i++)
+    {
+        if(i % DATAGRAM_BYTES == 0 && inSysex)
+            sysexSplit = true;
+        const quint8 byte = static_cast<quint8>(stream.at(i));
+        if(byte == 0xF0)
+            inSysex = true;
+        else if(byte == 0xF7)
+            inSysex = false;
+    }
+    QVERIFY(sysexSplit);
+
+    // Datagram by datagram gives exactly what one pass over the whole stream does
+    MidiStreamParser whole;
+    Recorder reference;
+    parse(whole, stream, reference);
+    MidiStreamParser chunked;
+    Recorder recorder;
+    parseDatagrams(chunked, stream, recorder);
+    QVERIFY(recorder.messages == reference.messages);
+    QCOMPARE(chunked.errors(), quint64(0));
+
+    MidiStreamParser parser;
+    Counter counter;
+    qint64 parsed = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK
+    {
+        parseDatagrams(parser, stream, counter);
+        parsed += stream.length();
+    }
+    // Reported as throughput rather than time per pass
+    QTest::setBenchmarkResult(parsed * 1e9 / timer.nsecsElapsed(), QTest::BytesPerSecond);
+    QCOMPARE(parser.errors(), quint64(0));
+}
+
+QTEST_APPLESS_MAIN(TestMidiStreamParser)
+
+#include "tst_midistreamparser.moc"
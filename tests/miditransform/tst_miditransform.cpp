@@ -0,0 +1,277 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "miditransform.h"
+#include <QtTest>
+
+class TestMidiTransform : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void identity();
+    void channelRemap();
+    void transpose_data();
+    void transpose();
+    void rulesMatchIncomingChannel();
+    void velocityCurves();
+    void wholeTable();
+    void rejected_data();
+    void rejected();
+    void missingFile();
+    void benchmarkApply();
+};
+
+namespace
+{
+    // Applies the transform to a copy of the message, returned as hex
+    QByteArray applied(const MidiTransform &transform, const char *hex)
+    {
+        QByteArray msg = QByteArray::fromHex(hex);
+        transform.apply(reinterpret_cast<quint8 *>(msg.data()), msg.length());
+        return msg.toHex().toUpper();
+    }
+
+    QByteArray hex(const char *text)
+    {
+        return QByteArray::fromHex(text).toHex().toUpper();
+    }
+
+    QVector<int> velocityMap(const QString &rules)
+    {
+        MidiTransform transform;
+        QVector<int> map;
+        if(!transform.parse(rules))
+            return map;
+        for(int v=0; v<128; v++)
+        {
+            quint8 msg[] = { 0x90, 0x3C, static_cast<quint8>(v) };
+            transform.apply(msg, sizeof(msg));
+            map << msg[2];
+        }
+        return map;
+    }
+}
+
+void TestMidiTransform::identity()
+{
+    MidiTransform transform;
+    QVERIFY(transform.isIdentity());
+    QVERIFY(transform.parse("# Nothing but a comment\n\n   \n"));
+    QVERIFY(transform.isIdentity());
+
+    for(int status=0x80; status<=0xFF; status++)
+    {
+        for(int v=0; v<128; v+=7)
+        {
+            quint8 msg[] = { static_cast<quint8>(status), static_cast<quint8>(v), static_cast<quint8>(127 - v) };
+            transform.apply(msg, sizeof(msg));
+            QVERIFY(msg[0] == status && msg[1] == v && msg[2] == 127 - v);
+        }
+    }
+}
+
+void TestMidiTransform::channelRemap()
+{
+    MidiTransform transform;
+    QVERIFY(transform.parse("channel 1 3"));
+    QVERIFY(!transform.isIdentity());
+
+    // Every kind of channel message moves, nothing else does
+    QCOMPARE(applied(transform, "803C40"), hex("823C40"));
+    QCOMPARE(applied(transform, "903C7F"), hex("923C7F"));
+    QCOMPARE(applied(transform, "A03C10"), hex("A23C10"));
+    QCOMPARE(applied(transform, "B00764"), hex("B20764"));
+    QCOMPARE(applied(transform, "C005"), hex("C205"));
+    QCOMPARE(applied(transform, "D040"), hex("D240"));
+    QCOMPARE(applied(transform, "E00040"), hex("E20040"));
+    QCOMPARE(applied(transform, "913C7F"), hex("913C7F"));
+    QCOMPARE(applied(transform, "F8"), hex("F8"));
+    QCOMPARE(applied(transform, "F20102"), hex("F20102"));
+    QCOMPARE(applied(transform, "F07F7F0201013100F7"), hex("F07F7F0201013100F7"));
+}
+
+void TestMidiTransform::transpose_data()
+{
+    QTest::addColumn<QString>("rules");
+    QTest::addColumn<QByteArray>("message");
+    QTest::addColumn<QByteArray>("expected");
+
+    QTest::newRow("note on") << "transpose 2 -12" << QByteArray("913C7F") << QByteArray("91307F");
+    QTest::newRow("note off") << "transpose 2 -12" << QByteArray("813C40") << QByteArray("813040");
+    QTest::newRow("poly pressure") << "transpose 2 -12" << QByteArray("A13C10") << QByteArray("A13010");
+    QTest::newRow("other channel") << "transpose 2 -12" << QByteArray("903C7F") << QByteArray("903C7F");
+    QTest::newRow("control") << "transpose 2 -12" << QByteArray("B13C7F") << QByteArray("B13C7F");
+    QTest::newRow("all channels") << "transpose all 7" << QByteArray("9F3C7F") << QByteArray("9F437F");
+    QTest::newRow("clamped high") << "transpose all 12" << QByteArray("907A7F") << QByteArray("907F7F");
+    QTest::newRow("clamped low") << "transpose all -12" << QByteArray("90057F") << QByteArray("90007F");
+    QTest::newRow("accumulated") << "transpose all 5\ntranspose 1 -2" << QByteArray("903C7F") << QByteArray("903F7F");
+}
+
+void TestMidiTransform::transpose()
+{
+    QFETCH(QString, rules);
+    QFETCH(QByteArray, message);
+    QFETCH(QByteArray, expected);
+
+    MidiTransform transform;
+    QVERIFY(transform.parse(rules));
+    QCOMPARE(applied(transform, message.constData()), expected);
+}
+
+void TestMidiTransform::rulesMatchIncomingChannel()
+{
+    MidiTransform transform;
+    QVERIFY(transform.parse("channel 1 3\ntranspose 1 5\ntranspose 3 -5\nvelocity 3 fixed 1"));
+    QCOMPARE(applied(transform, "903C7F"), hex("92417F"));
+    QCOMPARE(applied(transform, "923C7F"), hex("923701"));
+}
+
+void TestMidiTransform::velocityCurves()
+{
+    // Fixed only touches note on, and leaves velocity 0 a note off
+    MidiTransform fixed;
+    QVERIFY(fixed.parse("velocity 10 fixed 100"));
+    QCOMPARE(applied(fixed, "993C40"), hex("993C64"));
+    QCOMPARE(applied(fixed, "993C00"), hex("993C00"));
+    QCOMPARE(applied(fixed, "893C40"), hex("893C40"));
+    QCOMPARE(applied(fixed, "903C40"), hex("903C40"));
+
+    // Range spreads 1-127 evenly over low-high
+    const QVector<int> range = velocityMap("velocity all range 40 127");
+    QCOMPARE(range.count(), 128);
+    QCOMPARE(range[0], 0);
+    QCOMPARE(range[1], 40);
+    QCOMPARE(range[127], 127);
+    for(int v=2; v<128; v++)
+        QVERIFY2(range[v] >= range[v - 1] && range[v] - range[v - 1] <= 1, qPrintable(QString::number(v)));
+
+    // Below 1 plays louder, 1 changes nothing, end points stay
+    const QVector<int> louder = velocityMap("velocity all curve 0.6");
+    const QVector<int> linear = velocityMap("velocity all curve 1");
+    QCOMPARE(louder.count(), 128);
+    QCOMPARE(linear.count(), 128);
+    QCOMPARE(louder[0], 0);
+    QCOMPARE(louder[127], 127);
+    for(int v=1; v<128; v++)
+    {
+        QVERIFY2(louder[v] >= v && louder[v] >= louder[v - 1], qPrintable(QString::number(v)));
+        QCOMPARE(linear[v], v);
+    }
+
+    // Curves apply to what earlier rules produced
+    const QVector<int> chained = velocityMap("velocity all fixed 100\nvelocity all range 1 50");
+    QCOMPARE(chained.count(), 128);
+    QCOMPARE(chained[0], 0);
+    QCOMPARE(chained[64], 40);
+}
+
+void TestMidiTransform::wholeTable()
+{
+    // Every status and data byte against the rules worked out by hand
+    MidiTransform transform;
+    QVERIFY(transform.parse("channel 2 16\ntranspose all -12\nvelocity 2 fixed 90"));
+    for(int status=0x80; status<0xF0; status++)
+    {
+        const int kind = status & 0xF0;
+        const int channel = status & 0x0F;
+        const bool note = kind == 0x80 || kind == 0x90 || kind == 0xA0;
+        const int outStatus = channel == 1 ? kind | 0x0F : status;
+        for(int d1=0; d1<128; d1++)
+        {
+            for(int d2=0; d2<128; d2++)
+            {
+                quint8 msg[] = { static_cast<quint8>(status), static_cast<quint8>(d1), static_cast<quint8>(d2) };
+                transform.apply(msg, sizeof(msg));
+                const int outD1 = note ? qMax(d1 - 12, 0) : d1;
+                const int outD2 = kind == 0x90 && channel == 1 && d2 > 0 ? 90 : d2;
+                if(msg[0] != outStatus || msg[1] != outD1 || msg[2] != outD2)
+                    QFAIL(qPrintable(QString("%1 %2 %3 became %4 %5 %6").arg(status, 0, 16).arg(d1).arg(d2)
+                                     .arg(int(msg[0]), 0, 16).arg(int(msg[1])).arg(int(msg[2]))));
+            }
+        }
+    }
+}
+
+void TestMidiTransform::rejected_data()
+{
+    QTest::addColumn<QString>("rule");
+
+    QTest::newRow("channel 0") << "channel 0 3";
+    QTest::newRow("channel 17") << "channel 1 17";
+    QTest::newRow("channel all") << "channel all 3";
+    QTest::newRow("channel short") << "channel 1";
+    QTest::newRow("channel long") << "channel 1 2 3";
+    QTest::newRow("transpose text") << "transpose 1 up";
+    QTest::newRow("transpose far") << "transpose 1 128";
+    QTest::newRow("fixed 0") << "velocity 1 fixed 0";
+    QTest::newRow("range reversed") << "velocity 1 range 50 40";
+    QTest::newRow("range short") << "velocity 1 range 50";
+    QTest::newRow("curve flat") << "velocity 1 curve 0.01";
+    QTest::newRow("curve name") << "velocity 1 loud 3";
+    QTest::newRow("unknown") << "swap 1 2";
+}
+
+void TestMidiTransform::rejected()
+{
+    QFETCH(QString, rule);
+
+    // The line is reported and no rule stays in force, even the valid one before it
+    MidiTransform transform;
+    QString error;
+    QVERIFY(!transform.parse(QString("channel 1 2\n%1 # comment\n").arg(rule), &error));
+    QVERIFY2(error.contains(QString("Line 2")) && error.contains(rule), qPrintable(error));
+    QVERIFY(transform.isIdentity());
+    QCOMPARE(applied(transform, "903C7F"), hex("903C7F"));
+}
+
+void TestMidiTransform::missingFile()
+{
+    MidiTransform transform;
+    QString error;
+    QVERIFY(!transform.load(QString("no such mapping file.txt"), &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(transform.isIdentity());
+}
+
+void TestMidiTransform::benchmarkApply()
+{
+    MidiTransform transform;
+    QVERIFY(transform.parse("channel 1 3\ntranspose all -12\nvelocity all curve 0.6\nvelocity 10 fixed 100"));
+
+    quint8 msg[3];
+    int sum = 0;
+    QBENCHMARK
+    {
+        for(int v=0; v<128; v++)
+        {
+            msg[0] = 0x90;
+            msg[1] = static_cast<quint8>(v);
+            msg[2] = static_cast<quint8>(v);
+            transform.apply(msg, sizeof(msg));
+            sum += msg[2];
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+QTEST_APPLESS_MAIN(TestMidiTransform)
+
+#include "tst_miditransform.moc"
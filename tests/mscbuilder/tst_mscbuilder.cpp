@@ -0,0 +1,254 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "mscbuilder.h"
+#include "mscmessage.h"
+#include "mididata.h"
+#include <QtTest>
+
+// Everything the builder writes is read back with MscMessage::decode
+class TestMscBuilder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fixedPoint();
+    void eosCue();
+    void rejected_data();
+    void rejected();
+    void overLong();
+    void benchmarkBuild();
+    void benchmarkDecode();
+};
+
+namespace
+{
+    const quint8 FORMAT = MidiData::MSC_COMMAND_FORMAT_LIGHTING;
+    const quint8 GO = MidiData::MSC_COMMAND_GO;
+
+    QByteArray text(const MscMessage::Span &span)
+    {
+        return QByteArray(reinterpret_cast<const char *>(span.data), span.length);
+    }
+
+    bool decode(const MscBuilder &builder, MscMessage &msc)
+    {
+        return MscMessage::decode(builder.data(), builder.length(), msc)
+                && builder.data()[builder.length() - 1] == 0xF7;
+    }
+
+    quint64 power10(int exponent)
+    {
+        quint64 value = 1;
+        while(exponent-- > 0)
+            value *= 10;
+        return value;
+    }
+
+    // Reads a decoded cue back into fixed point, false unless it is the
+    // shortest form: no leading zeros, no trailing zeros after the point
+    bool fixedPointOf(const QByteArray &cue, int decimals, quint64 &value)
+    {
+        const int point = cue.indexOf('.');
+        const QByteArray whole = point < 0 ? cue : cue.left(point);
+        const QByteArray fraction = point < 0 ? QByteArray() : cue.mid(point + 1);
+        if(whole.isEmpty() || (whole.length() > 1 && whole.startsWith('0')))
+            return false;
+        if(point >= 0 && (fraction.isEmpty() || fraction.endsWith('0') || fraction.length() > decimals))
+            return false;
+
+        value = 0;
+        foreach(char c, whole + fraction)
+        {
+            if(c < '0' || c > '9')
+                return false;
+            value = value * 10 + quint64(c - '0');
+        }
+        value *= power10(decimals - fraction.length());
+        return true;
+    }
+
+    // Boundaries around every power of ten, then a fixed pseudo random sample
+    QVector<quint32> fixedPointValues()
+    {
+        QVector<quint32> values;
+        values << 0 << 1 << 5 << 50 << 105 << 150 << 200 << 4294967294u << 4294967295u;
+        for(quint64 p=10; p<=1000000000; p*=10)
+            values << quint32(p - 1) << quint32(p) << quint32(p + 1);
+        quint32 seed = 1;
+        for(int i=0; i<2000; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            values << (i % 2 ? seed : seed % 100000);
+        }
+        return values;
+    }
+}
+
+void TestMscBuilder::fixedPoint()
+{
+    const QVector<quint32> values = fixedPointValues();
+    for(int decimals=0; decimals<=9; decimals++)
+    {
+        foreach(quint32 value, values)
+        {
+            MscBuilder builder(1, FORMAT, GO);
+            QVERIFY(builder.addNumber(value, decimals));
+            QVERIFY(builder.finish());
+
+            MscMessage msc;
+            QVERIFY(decode(builder, msc));
+            QCOMPARE(msc.deviceId, quint8(1));
+            QCOMPARE(msc.commandFormat, FORMAT);
+            QCOMPARE(msc.command, GO);
+            QVERIFY(msc.list.isEmpty());
+            QVERIFY(msc.path.isEmpty());
+
+            quint64 decoded = 0;
+            const QByteArray cue = text(msc.cue);
+            QVERIFY2(fixedPointOf(cue, decimals, decoded),
+                     qPrintable(QString("%1 with %2 decimals gave %3").arg(value).arg(decimals).arg(QString(cue))));
+            QCOMPARE(decoded, quint64(value));
+        }
+    }
+
+    // The cases that float formatting used to get wrong
+    const struct { quint32 value; int decimals; const char *cue; } exact[] = {
+        {5, 2, "0.05"}, {150, 2, "1.5"}, {200, 2, "2"}, {11, 1, "1.1"}, {0, 2, "0"}
+    };
+    for(const auto &e : exact)
+    {
+        MscBuilder builder(1, FORMAT, GO);
+        QVERIFY(builder.addNumber(e.value, e.decimals) && builder.finish());
+        MscMessage msc;
+        QVERIFY(decode(builder, msc));
+        QCOMPARE(text(msc.cue), QByteArray(e.cue));
+    }
+}
+
+void TestMscBuilder::eosCue()
+{
+    const char *lists[] = {"1", "2", "10", "999", "0.5", "12.25"};
+    const char *cues[] = {"1", "0.05", "1.5", "1.50", "2", "100", "401.123"};
+
+    for(const char *list : lists)
+    {
+        for(const char *cue : cues)
+        {
+            const QString entry = QString("%1/%2").arg(list).arg(cue);
+            MscBuilder builder(MscMessage::ALL_CALL, FORMAT, GO);
+            QVERIFY2(builder.addEosCue(entry) && builder.finish(), qPrintable(entry));
+
+            MscMessage msc;
+            QVERIFY(decode(builder, msc));
+            QCOMPARE(msc.deviceId, quint8(MscMessage::ALL_CALL));
+            QCOMPARE(text(msc.cue), QByteArray(cue));
+            QCOMPARE(text(msc.list), QByteArray(list));
+            QVERIFY(msc.path.isEmpty());
+        }
+
+        // A list on its own leaves the cue blank
+        MscBuilder builder(1, FORMAT, GO);
+        QVERIFY(builder.addEosCue(QString("%1/").arg(list)) && builder.finish());
+        MscMessage msc;
+        QVERIFY(decode(builder, msc));
+        QVERIFY(msc.cue.isEmpty());
+        QCOMPARE(text(msc.list), QByteArray(list));
+        QCOMPARE(builder.data()[6], quint8(0x00));
+    }
+
+    for(const char *cue : cues)
+    {
+        MscBuilder builder(1, FORMAT, GO);
+        QVERIFY(builder.addEosCue(QString(cue)) && builder.finish());
+        MscMessage msc;
+        QVERIFY(decode(builder, msc));
+        QCOMPARE(text(msc.cue), QByteArray(cue));
+        QVERIFY(msc.list.isEmpty());
+    }
+}
+
+void TestMscBuilder::rejected_data()
+{
+    QTest::addColumn<QString>("entry");
+
+    QTest::newRow("empty") << "";
+    QTest::newRow("slash") << "/";
+    QTest::newRow("no list") << "/5";
+    QTest::newRow("two slashes") << "1//2";
+    QTest::newRow("path") << "1/2/3";
+    QTest::newRow("two points") << "1.2.3";
+    QTest::newRow("leading point") << ".5";
+    QTest::newRow("trailing point") << "5.";
+    QTest::newRow("letter") << "1/5a";
+    QTest::newRow("space") << "1/ 5";
+}
+
+void TestMscBuilder::rejected()
+{
+    QFETCH(QString, entry);
+
+    MscBuilder builder(1, FORMAT, GO);
+    QVERIFY(!builder.addEosCue(entry));
+    QVERIFY(!builder.finish());
+    QVERIFY(!builder.isValid());
+}
+
+void TestMscBuilder::overLong()
+{
+    // 128 bytes from F0 to F7 leaves room for 121 digits
+    MscBuilder fits(1, FORMAT, GO);
+    QVERIFY(fits.addNumber(QString(121, QLatin1Char('1'))));
+    QVERIFY(fits.finish());
+    QCOMPARE(fits.length(), int(MscBuilder::MAX_LENGTH));
+
+    MscBuilder tooLong(1, FORMAT, GO);
+    QVERIFY(!tooLong.addNumber(QString(122, QLatin1Char('1'))));
+    QVERIFY(!tooLong.finish());
+}
+
+void TestMscBuilder::benchmarkBuild()
+{
+    const QString entry = QStringLiteral("12/401.05");
+    QBENCHMARK
+    {
+        MscBuilder builder(1, FORMAT, GO);
+        builder.addEosCue(entry);
+        builder.finish();
+    }
+}
+
+void TestMscBuilder::benchmarkDecode()
+{
+    MscBuilder builder(1, FORMAT, GO);
+    QVERIFY(builder.addEosCue(QStringLiteral("12/401.05")) && builder.finish());
+
+    MscMessage msc;
+    char description[128];
+    QBENCHMARK
+    {
+        MscMessage::decode(builder.data(), builder.length(), msc);
+        msc.describe(description, sizeof(description));
+    }
+}
+
+QTEST_APPLESS_MAIN(TestMscBuilder)
+
+#include "tst_mscbuilder.moc"
@@ -0,0 +1,223 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rxfilter.h"
+#include "mscmessage.h"
+#include <QHostAddress>
+#include <QtTest>
+
+class TestRxFilter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matches_data();
+    void matches();
+    void statusFolding_data();
+    void statusFolding();
+    void foldedTable();
+    void rejected_data();
+    void rejected();
+    void stackDepth();
+    void benchmarkMatch();
+};
+
+namespace
+{
+    // Matched the way the receiver does, with MSC decoded first
+    bool passes(const RxFilter &filter, const QString &sender, const QByteArray &message)
+    {
+        const quint8 *msg = reinterpret_cast<const quint8 *>(message.constData());
+        MscMessage msc;
+        const bool isMsc = MscMessage::decode(msg, message.length(), msc);
+        return filter.matches(QHostAddress(sender).toIPv4Address(), msg, message.length(), isMsc ? &msc : Q_NULLPTR);
+    }
+
+    QString nested(int terms)
+    {
+        // note 1 or (note 2 or (... note n)) keeps every term on the stack
+        QString expression = QString("note %1").arg(terms);
+        for(int i=terms - 1; i>0; i--)
+            expression = QString("note %1 or (%2)").arg(i).arg(expression);
+        return expression;
+    }
+}
+
+void TestRxFilter::matches_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<QString>("sender");
+    QTest::addColumn<QByteArray>("message");
+    QTest::addColumn<bool>("expected");
+
+    const char *go = "F0 7F 01 02 01 01 31 00 33 F7";      // GO cue 1 list 3
+
+    QTest::newRow("empty") << "" << "10.101.1.7" << QByteArray::fromHex("F8") << true;
+    QTest::newRow("status range") << "status 90-9F" << "10.101.1.7" << QByteArray::fromHex("9F 3C 7F") << true;
+    QTest::newRow("status outside") << "status 90-9F" << "10.101.1.7" << QByteArray::fromHex("80 3C 40") << false;
+    QTest::newRow("type") << "type noteon" << "10.101.1.7" << QByteArray::fromHex("95 3C 7F") << true;
+    QTest::newRow("type case") << "type Clock" << "10.101.1.7" << QByteArray::fromHex("F8") << true;
+    QTest::newRow("type other") << "type noteon" << "10.101.1.7" << QByteArray::fromHex("85 3C 40") << false;
+    QTest::newRow("channel") << "channel 2" << "10.101.1.7" << QByteArray::fromHex("B1 07 64") << true;
+    QTest::newRow("channel other") << "channel 2" << "10.101.1.7" << QByteArray::fromHex("B0 07 64") << false;
+    QTest::newRow("channel system") << "channel 1-16" << "10.101.1.7" << QByteArray::fromHex("F8") << false;
+    QTest::newRow("note") << "note 60-64" << "10.101.1.7" << QByteArray::fromHex("90 3C 7F") << true;
+    QTest::newRow("note outside") << "note 60-64" << "10.101.1.7" << QByteArray::fromHex("90 41 7F") << false;
+    QTest::newRow("note on control") << "note 60" << "10.101.1.7" << QByteArray::fromHex("B0 3C 7F") << false;
+    QTest::newRow("note hex") << "note 0x3C" << "10.101.1.7" << QByteArray::fromHex("A0 3C 10") << true;
+    QTest::newRow("sender subnet") << "sender 10.101.1.0/24" << "10.101.1.7" << QByteArray::fromHex("F8") << true;
+    QTest::newRow("sender outside") << "sender 10.101.1.0/24" << "10.101.2.7" << QByteArray::fromHex("F8") << false;
+    QTest::newRow("sender host") << "from 10.101.1.7" << "10.101.1.7" << QByteArray::fromHex("F8") << true;
+    QTest::newRow("sysex prefix") << "sysex 7F 7F 02" << "10.101.1.7" << QByteArray::fromHex("F0 7F 7F 02 01 01 31 F7") << true;
+    QTest::newRow("sysex other") << "sysex 7F 7F 02" << "10.101.1.7" << QByteArray::fromHex("F0 7D 01 F7") << false;
+    QTest::newRow("sysex any") << "sysex" << "10.101.1.7" << QByteArray::fromHex("F0 7D 01 F7") << true;
+    QTest::newRow("msc") << "msc" << "10.101.1.7" << QByteArray::fromHex(go) << true;
+    QTest::newRow("msc not sysex") << "msc" << "10.101.1.7" << QByteArray::fromHex("F0 7D 01 F7") << false;
+    QTest::newRow("msc command") << "msc go list 3" << "10.101.1.7" << QByteArray::fromHex(go) << true;
+    QTest::newRow("msc cue") << "msc go cue 1" << "10.101.1.7" << QByteArray::fromHex(go) << true;
+    QTest::newRow("msc other list") << "msc go list 2" << "10.101.1.7" << QByteArray::fromHex(go) << false;
+    QTest::newRow("msc other command") << "msc stop" << "10.101.1.7" << QByteArray::fromHex(go) << false;
+    QTest::newRow("and not") << "type noteon and not channel 10" << "10.101.1.7" << QByteArray::fromHex("99 24 7F") << false;
+    QTest::newRow("and not passes") << "type noteon and not channel 10" << "10.101.1.7" << QByteArray::fromHex("90 24 7F") << true;
+    QTest::newRow("symbols") << "!(status 90) && (note 60 || sender 10.0.0.1)" << "10.101.1.7" << QByteArray::fromHex("80 3C 40") << true;
+    QTest::newRow("symbols fail") << "!(status 90) && (note 60 || sender 10.0.0.1)" << "10.101.1.7" << QByteArray::fromHex("80 3D 40") << false;
+    QTest::newRow("precedence") << "sender 10.0.0.1 or type noteon and note 60" << "10.101.1.7" << QByteArray::fromHex("90 3C 7F") << true;
+    QTest::newRow("precedence fail") << "sender 10.0.0.1 or type noteon and note 60" << "10.101.1.7" << QByteArray::fromHex("80 3C 40") << false;
+}
+
+void TestRxFilter::matches()
+{
+    QFETCH(QString, expression);
+    QFETCH(QString, sender);
+    QFETCH(QByteArray, message);
+    QFETCH(bool, expected);
+
+    RxFilter filter;
+    QString error;
+    QVERIFY2(filter.compile(expression, &error), qPrintable(error));
+    QCOMPARE(passes(filter, sender, message), expected);
+}
+
+void TestRxFilter::statusFolding_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<int>("instructions");
+
+    QTest::newRow("range and channel") << "status 90-9F and channel 1" << 1;
+    QTest::newRow("or and not") << "type noteon or type noteoff and not channel 10" << 1;
+    QTest::newRow("not group") << "not (status 90 or status 80)" << 1;
+    QTest::newRow("symbols") << "!channel 1 && (type control || type program)" << 1;
+    QTest::newRow("note") << "status 90 and note 60" << 3;
+    QTest::newRow("sender") << "channel 1 or sender 10.0.0.1" << 3;
+    QTest::newRow("msc") << "msc go cue 1" << 3;
+}
+
+void TestRxFilter::statusFolding()
+{
+    QFETCH(QString, expression);
+    QFETCH(int, instructions);
+
+    RxFilter filter;
+    QVERIFY(filter.compile(expression));
+    QCOMPARE(filter.instructionCount(), instructions);
+}
+
+void TestRxFilter::foldedTable()
+{
+    // Folding must not change what passes
+    RxFilter folded;
+    QVERIFY(folded.compile("type noteon or type noteoff and not channel 10"));
+    QCOMPARE(folded.instructionCount(), 1);
+    for(int status=0x80; status<=0xFF; status++)
+    {
+        const QByteArray message(1, static_cast<char>(status));
+        const bool expected = (status & 0xF0) == 0x90 || ((status & 0xF0) == 0x80 && (status & 0x0F) != 9);
+        QVERIFY2(passes(folded, "10.101.1.7", message) == expected, qPrintable(QString::number(status, 16)));
+    }
+}
+
+void TestRxFilter::rejected_data()
+{
+    QTest::addColumn<QString>("expression");
+
+    QTest::newRow("incomplete") << "status";
+    QTest::newRow("data byte") << "status 7F";
+    QTest::newRow("channel 0") << "channel 0";
+    QTest::newRow("channel 17") << "channel 17";
+    QTest::newRow("reversed") << "channel 3-1";
+    QTest::newRow("note 128") << "note 128";
+    QTest::newRow("type") << "type nonsense";
+    QTest::newRow("address") << "sender 10.0.0.300";
+    QTest::newRow("ipv6") << "sender ::1";
+    QTest::newRow("open") << "(status 90";
+    QTest::newRow("close") << "status 90 )";
+    QTest::newRow("dangling and") << "status 90 and";
+    QTest::newRow("unknown") << "bogus";
+    QTest::newRow("msc cue") << "msc cue 1/2";
+}
+
+void TestRxFilter::rejected()
+{
+    QFETCH(QString, expression);
+
+    // A failed compile leaves the previous filter in place
+    RxFilter filter;
+    QVERIFY(filter.compile("status 90"));
+    QString error;
+    QVERIFY(!filter.compile(expression, &error));
+    QVERIFY(!error.isEmpty());
+    QCOMPARE(filter.instructionCount(), 1);
+}
+
+void TestRxFilter::stackDepth()
+{
+    RxFilter filter;
+    QVERIFY(filter.compile(nested(RxFilter::MAX_STACK_DEPTH)));
+    QVERIFY(passes(filter, "10.101.1.7", QByteArray::fromHex("90 20 7F")));
+
+    QString error;
+    QVERIFY(!filter.compile(nested(RxFilter::MAX_STACK_DEPTH + 1), &error));
+    QVERIFY(!error.isEmpty());
+
+    // Chained terms are combined as they go and stay shallow
+    QString chained("note 1");
+    for(int i=2; i<=100; i++)
+        chained += QString(" or note %1").arg(i);
+    QVERIFY(filter.compile(chained));
+}
+
+void TestRxFilter::benchmarkMatch()
+{
+    RxFilter filter;
+    QVERIFY(filter.compile("sender 10.101.1.0/24 and (type noteon or type noteoff) and not channel 10 and note 36-84"));
+    const quint32 sender = QHostAddress("10.101.1.7").toIPv4Address();
+    const quint8 msg[] = { 0x90, 0x3C, 0x7F };
+
+    int passed = 0;
+    QBENCHMARK
+    {
+        passed += filter.matches(sender, msg, sizeof(msg), Q_NULLPTR);
+    }
+    QVERIFY(passed > 0);
+}
+
+QTEST_APPLESS_MAIN(TestRxFilter)
+
+#include "tst_rxfilter.moc"
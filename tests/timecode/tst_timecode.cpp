@@ -0,0 +1,206 @@
+// Copyright (c) 2015 Electronic Theatre Controls, Inc., http://www.etcconnect.com
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "timecode.h"
+#include "timecodeengine.h"
+#include <QtTest>
+
+class TestTimecode : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void dropFrameNumbers_data();
+    void dropFrameNumbers();
+    void droppedLabels();
+    void roundTrip_data();
+    void roundTrip();
+    void frameTime();
+    void displayLabels();
+    void engineAcrossDrops();
+};
+
+namespace
+{
+    Timecode timecode(int hours, int minutes, int seconds, int frames, Timecode::Rate rate)
+    {
+        Timecode tc;
+        tc.hours = static_cast<quint8>(hours);
+        tc.minutes = static_cast<quint8>(minutes);
+        tc.seconds = static_cast<quint8>(seconds);
+        tc.frames = static_cast<quint8>(frames);
+        tc.rate = rate;
+        return tc;
+    }
+
+    // Quarter frame data bytes for a set starting at tc, as a sender would send them
+    void quarterFrames(const Timecode &tc, quint8 data[8])
+    {
+        data[0] = tc.frames & 0x0F;
+        data[1] = 0x10 | tc.frames >> 4;
+        data[2] = 0x20 | (tc.seconds & 0x0F);
+        data[3] = 0x30 | tc.seconds >> 4;
+        data[4] = 0x40 | (tc.minutes & 0x0F);
+        data[5] = 0x50 | tc.minutes >> 4;
+        data[6] = 0x60 | (tc.hours & 0x0F);
+        data[7] = static_cast<quint8>(0x70 | tc.rate << 1 | tc.hours >> 4);
+    }
+}
+
+void TestTimecode::dropFrameNumbers_data()
+{
+    QTest::addColumn<int>("hours");
+    QTest::addColumn<int>("minutes");
+    QTest::addColumn<int>("seconds");
+    QTest::addColumn<int>("frames");
+    QTest::addColumn<qint64>("number");
+
+    QTest::newRow("start") << 0 << 0 << 0 << 0 << qint64(0);
+    QTest::newRow("before first drop") << 0 << 0 << 59 << 29 << qint64(1799);
+    QTest::newRow("first drop") << 0 << 1 << 0 << 2 << qint64(1800);
+    QTest::newRow("before tenth minute") << 0 << 9 << 59 << 29 << qint64(17981);
+    QTest::newRow("tenth minute") << 0 << 10 << 0 << 0 << qint64(17982);
+    QTest::newRow("tenth minute frame 1") << 0 << 10 << 0 << 1 << qint64(17983);
+    QTest::newRow("after tenth minute") << 0 << 11 << 0 << 2 << qint64(19782);
+    QTest::newRow("hour") << 1 << 0 << 0 << 0 << qint64(107892);
+    QTest::newRow("end of day") << 23 << 59 << 59 << 29 << qint64(2589407);
+}
+
+void TestTimecode::dropFrameNumbers()
+{
+    QFETCH(int, hours);
+    QFETCH(int, minutes);
+    QFETCH(int, seconds);
+    QFETCH(int, frames);
+    QFETCH(qint64, number);
+
+    const Timecode tc = timecode(hours, minutes, seconds, frames, Timecode::RATE_29_97_DF);
+    QCOMPARE(tc.toFrameNumber(), number);
+    QCOMPARE(Timecode::fromFrameNumber(number, Timecode::RATE_29_97_DF).toString(), tc.toString());
+}
+
+void TestTimecode::droppedLabels()
+{
+    // Frames 00 and 01 don't exist in minutes that aren't a multiple of ten;
+    // typed or received anyway, they stand for the 02 that follows
+    for(int minutes=0; minutes<60; minutes++)
+    {
+        const qint64 first = timecode(5, minutes, 0, 2, Timecode::RATE_29_97_DF).toFrameNumber();
+        for(int frames=0; frames<2; frames++)
+        {
+            const Timecode label = timecode(5, minutes, 0, frames, Timecode::RATE_29_97_DF);
+            const qint64 expected = minutes % 10 ? first : first - 2 + frames;
+            QVERIFY2(label.toFrameNumber() == expected, qPrintable(label.toString()));
+        }
+    }
+}
+
+void TestTimecode::roundTrip_data()
+{
+    QTest::addColumn<int>("rate");
+
+    QTest::newRow("24") << int(Timecode::RATE_24);
+    QTest::newRow("25") << int(Timecode::RATE_25);
+    QTest::newRow("29.97 DF") << int(Timecode::RATE_29_97_DF);
+    QTest::newRow("30") << int(Timecode::RATE_30);
+}
+
+void TestTimecode::roundTrip()
+{
+    QFETCH(int, rate);
+
+    // Every frame of a day gets a valid label that converts straight back,
+    // and labels only ever count up
+    const Timecode::Rate r = static_cast<Timecode::Rate>(rate);
+    const qint64 fps = Timecode::nominalFps(r);
+    qint64 previous = -1;
+    for(qint64 n=0; n<Timecode::framesPerDay(r); n++)
+    {
+        const Timecode tc = Timecode::fromFrameNumber(n, r);
+        const qint64 label = ((tc.hours * 60 + tc.minutes) * 60 + tc.seconds) * fps + tc.frames;
+        const bool dropped = r == Timecode::RATE_29_97_DF && tc.seconds == 0 && tc.frames < 2 && tc.minutes % 10;
+        if(tc.toFrameNumber() != n || tc.frames >= fps || tc.hours > 23 || dropped || label <= previous)
+            QFAIL(qPrintable(QString("frame %1 became %2").arg(n).arg(tc.toString())));
+        previous = label;
+    }
+
+    // Positions wrap at midnight both ways
+    const qint64 day = Timecode::framesPerDay(r);
+    QCOMPARE(Timecode::fromFrameNumber(day, r).toFrameNumber(), qint64(0));
+    QCOMPARE(Timecode::fromFrameNumber(-1, r).toFrameNumber(), day - 1);
+}
+
+void TestTimecode::frameTime()
+{
+    // 30000 drop frame frames take exactly 1001 seconds, a day a little under 24 hours
+    QCOMPARE(Timecode::frameTimeNs(30000, Timecode::RATE_29_97_DF), Q_INT64_C(1001000000000));
+    QCOMPARE(Timecode::frameTimeNs(Timecode::framesPerDay(Timecode::RATE_29_97_DF), Timecode::RATE_29_97_DF),
+             Q_INT64_C(86399913600000));
+    QCOMPARE(Timecode::frameTimeNs(Timecode::framesPerDay(Timecode::RATE_25), Timecode::RATE_25),
+             Q_INT64_C(86400000000000));
+}
+
+void TestTimecode::displayLabels()
+{
+    QCOMPARE(timecode(1, 2, 3, 4, Timecode::RATE_29_97_DF).toString(), QString("01:02:03;04"));
+    QCOMPARE(timecode(1, 2, 3, 4, Timecode::RATE_25).toString(), QString("01:02:03:04"));
+}
+
+void TestTimecode::engineAcrossDrops()
+{
+    // Three minutes of quarter frames across the tenth minute, which keeps its
+    // labels, and the eleventh, which drops two
+    const Timecode::Rate rate = Timecode::RATE_29_97_DF;
+    const qint64 start = timecode(0, 9, 58, 0, rate).toFrameNumber();
+    const qint64 frames = 3 * 1800;
+    const qint64 origin = Q_INT64_C(1000000000);
+
+    TimecodeEngine engine;
+    qint64 quarterFrame = 0;
+    for(qint64 set=start; set<start + frames; set+=2)
+    {
+        quint8 data[8];
+        quarterFrames(Timecode::fromFrameNumber(set, rate), data);
+        for(int piece=0; piece<8; piece++, quarterFrame++)
+        {
+            const quint8 msg[] = { 0xF1, data[piece] };
+            QVERIFY(engine.process(msg, sizeof(msg), origin + Timecode::frameTimeNs(quarterFrame, rate) / 4));
+
+            const TimecodeEngine::State state = engine.state();
+            if(!state.locked)
+                continue;
+            const Timecode expected = Timecode::fromFrameNumber(start + quarterFrame / 4, rate);
+            if(state.position.toString() != expected.toString())
+                QFAIL(qPrintable(QString("quarter frame %1 read %2, not %3")
+                                 .arg(quarterFrame).arg(state.position.toString()).arg(expected.toString())));
+        }
+    }
+
+    const TimecodeEngine::State state = engine.state();
+    QVERIFY(state.locked);
+    QCOMPARE(state.direction, TimecodeEngine::DIRECTION_FORWARD);
+    QCOMPARE(state.discontinuities, quint64(0));
+    QVERIFY(qAbs(state.driftNs) < 1000);
+    QVERIFY(qAbs(state.measuredFps - Timecode::fps(rate)) < 0.001);
+}
+
+QTEST_APPLESS_MAIN(TestTimecode)
+
+#include "tst_timecode.moc"